@@ -0,0 +1,164 @@
+#include "bitmap_pool.hpp"
+
+#include <sstream>
+
+#if defined(WIN32)
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#endif
+
+/** \brief Allocate an aligned block of memory.
+ *
+ * Throws an error on failure.
+ *
+ * \param op Size in bytes.
+ * \return Allocated memory.
+ */
+static uint8_t* aligned_alloc_bytes(size_t op)
+{
+#if defined(WIN32)
+  void *ret = _aligned_malloc(op, BitmapPool::ALIGNMENT);
+#else
+  void *ret = NULL;
+  if(0 != posix_memalign(&ret, BitmapPool::ALIGNMENT, op))
+  {
+    ret = NULL;
+  }
+#endif
+
+  if(NULL == ret)
+  {
+    std::ostringstream sstr;
+    sstr << "could not allocate bitmap buffer of " << op << " bytes";
+    BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+  }
+  return static_cast<uint8_t*>(ret);
+}
+
+/** \brief Free a block of memory allocated with aligned_alloc_bytes().
+ *
+ * \param op Memory to free.
+ */
+static void aligned_free_bytes(uint8_t *op)
+{
+#if defined(WIN32)
+  _aligned_free(op);
+#else
+  free(op);
+#endif
+}
+
+BitmapPool::BitmapPool(size_t plimit) :
+  m_limit(plimit),
+  m_allocated(0),
+  m_in_use(0) { }
+
+BitmapPool::~BitmapPool()
+{
+  BOOST_FOREACH(free_container_type::value_type &vv, m_free)
+  {
+    aligned_free_bytes(vv.second);
+  }
+  BOOST_FOREACH(used_container_type::value_type &vv, m_used)
+  {
+    aligned_free_bytes(vv.first);
+  }
+}
+
+uint8_t* BitmapPool::acquire(size_t op)
+{
+  if(0 >= op)
+  {
+    return NULL;
+  }
+
+  size_t capacity = ((op + GRANULARITY - 1) / GRANULARITY) * GRANULARITY;
+  boost::mutex::scoped_lock scope(m_mutex);
+
+  for(;;)
+  {
+    // Best fit from the free buffers.
+    free_container_type::iterator iter = m_free.lower_bound(capacity);
+    if(m_free.end() != iter)
+    {
+      uint8_t *ret = iter->second;
+
+      m_in_use += iter->first;
+      m_used[ret] = iter->first;
+      m_free.erase(iter);
+      return ret;
+    }
+
+    if((m_allocated + capacity <= m_limit) || (0 >= m_in_use))
+    {
+      // Cached buffers are all too small, get rid of them if they're in the way.
+      while((m_allocated + capacity > m_limit) && this->dropFree());
+
+      uint8_t *ret = aligned_alloc_bytes(capacity);
+
+      m_allocated += capacity;
+      m_in_use += capacity;
+      m_used[ret] = capacity;
+      return ret;
+    }
+
+    if(this->dropFree())
+    {
+      continue;
+    }
+
+    m_cond.wait(scope);
+  }
+}
+
+bool BitmapPool::dropFree()
+{
+  if(m_free.empty())
+  {
+    return false;
+  }
+
+  free_container_type::iterator iter = m_free.end();
+  --iter;
+
+  aligned_free_bytes(iter->second);
+  m_allocated -= iter->first;
+  m_free.erase(iter);
+  return true;
+}
+
+void BitmapPool::release(uint8_t *op)
+{
+  if(NULL == op)
+  {
+    return;
+  }
+
+  boost::mutex::scoped_lock scope(m_mutex);
+
+  used_container_type::iterator iter = m_used.find(op);
+  if(m_used.end() == iter)
+  {
+    std::ostringstream sstr;
+    sstr << "trying to release bitmap buffer " << static_cast<void*>(op) << " not acquired from the pool";
+    BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+  }
+
+  m_in_use -= iter->second;
+  m_free.insert(free_container_type::value_type(iter->second, op));
+  m_used.erase(iter);
+
+  m_cond.notify_all();
+}
+
+void BitmapPool::setLimit(size_t op)
+{
+  boost::mutex::scoped_lock scope(m_mutex);
+
+  m_limit = op;
+
+  while((m_allocated > m_limit) && this->dropFree());
+
+  m_cond.notify_all();
+}
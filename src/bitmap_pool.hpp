@@ -0,0 +1,111 @@
+#ifndef BITMAP_POOL_HPP
+#define BITMAP_POOL_HPP
+
+#include "defaults.hpp"
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <map>
+
+/** \brief Pool of recycled precalc bitmap buffers.
+ *
+ * All precalc-size glyph bitmaps are rendered into buffers acquired from here. The pool also acts as the
+ * admission gate into the render -> crunch pipeline: acquiring a buffer blocks until the total amount of
+ * memory held by the pool fits within the configured budget.
+ */
+class BitmapPool : public boost::noncopyable
+{
+  public:
+    /** Alignment of all buffers. */
+    static const size_t ALIGNMENT = 64;
+
+    /** Allocation granularity, buffer capacities are rounded up to this. */
+    static const size_t GRANULARITY = 4096;
+
+  private:
+    /** Convenience typedef. */
+    typedef std::multimap<size_t, uint8_t*> free_container_type;
+
+    /** Convenience typedef. */
+    typedef std::map<uint8_t*, size_t> used_container_type;
+
+  private:
+    /** Free buffers, indexed by capacity. */
+    free_container_type m_free;
+
+    /** Buffers currently in use, mapped to their capacity. */
+    used_container_type m_used;
+
+    /** Cond. */
+    boost::condition_variable m_cond;
+
+    /** Guard. */
+    boost::mutex m_mutex;
+
+    /** Memory budget in bytes. */
+    size_t m_limit;
+
+    /** Total bytes allocated, both free and in use. */
+    size_t m_allocated;
+
+    /** Bytes in use. */
+    size_t m_in_use;
+
+  public:
+    /** \brief Constructor.
+     *
+     * \param plimit Memory budget in bytes.
+     */
+    BitmapPool(size_t plimit);
+
+    /** \brief Destructor.
+     */
+    ~BitmapPool();
+
+  private:
+    /** \brief Release the largest free buffer back to the system.
+     *
+     * Must be called from a locked context.
+     *
+     * \return True if a buffer was released, false if there were no free buffers.
+     */
+    bool dropFree();
+
+  public:
+    /** \brief Acquire a buffer.
+     *
+     * Blocks until the budget allows the allocation. A single buffer is always granted if nothing else is in
+     * use, even if it would exceed the budget on its own.
+     *
+     * Contents of the returned buffer are undefined.
+     *
+     * \param op Minimum size of the buffer in bytes.
+     * \return Buffer, NULL if size was zero.
+     */
+    uint8_t* acquire(size_t op);
+
+    /** \brief Release a buffer back into the pool.
+     *
+     * \param op Buffer previously returned from acquire().
+     */
+    void release(uint8_t *op);
+
+    /** \brief Set the memory budget.
+     *
+     * \param op New memory budget in bytes.
+     */
+    void setLimit(size_t op);
+
+  public:
+    /** \brief Get the memory budget.
+     *
+     * \return Memory budget in bytes.
+     */
+    inline size_t getLimit() const
+    {
+      return m_limit;
+    }
+};
+
+#endif
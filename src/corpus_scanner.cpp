@@ -0,0 +1,341 @@
+#include "corpus_scanner.hpp"
+
+#include "prog/progress.hpp"
+#include "thr/dispatch.hpp"
+
+#include <sstream>
+
+/** \brief Shared no-op bitset cleanup.
+ *
+ * Bitsets are owned by the scanner, not the thread.
+ *
+ * \param op Bitset.
+ */
+static void bitset_cleanup(std::vector<uint32_t> *op)
+{
+  boost::ignore_unused_variable_warning(op);
+}
+
+/** \brief Mark a codepoint in a bitset.
+ *
+ * \param bitset Bitset.
+ * \param op Codepoint.
+ */
+static inline void bitset_mark(uint32_t *bitset, uint32_t op)
+{
+  bitset[op >> 5] |= (1u << (op & 31));
+}
+
+/** \brief Get the length of a UTF-8 sequence from its lead byte.
+ *
+ * \param lead Lead byte.
+ * \return Sequence length in bytes, 0 if not a multibyte lead byte.
+ */
+static inline unsigned get_sequence_length(uint8_t lead)
+{
+  if(lead < 0xC2)
+  {
+    return 0;
+  }
+  if(lead < 0xE0)
+  {
+    return 2;
+  }
+  if(lead < 0xF0)
+  {
+    return 3;
+  }
+  return (lead < 0xF5) ? 4 : 0;
+}
+
+/** \brief Decode one multibyte UTF-8 sequence.
+ *
+ * Rejects overlong encodings, surrogates and codepoints beyond U+10FFFF.
+ *
+ * \param iter Lead byte of the sequence.
+ * \param end End of available data.
+ * \param cp Decoded codepoint.
+ * \return Pointer past the sequence, NULL if the sequence is invalid.
+ */
+static const uint8_t* decode_multibyte(const uint8_t *iter, const uint8_t *end, uint32_t &cp)
+{
+  uint32_t lead = iter[0];
+  unsigned count;
+  uint8_t lower = 0x80,
+          upper = 0xBF;
+
+  if(lead < 0xC2)
+  {
+    return NULL;
+  }
+  else if(lead < 0xE0)
+  {
+    count = 1;
+    cp = lead & 0x1F;
+  }
+  else if(lead < 0xF0)
+  {
+    count = 2;
+    cp = lead & 0x0F;
+    if(0xE0 == lead)
+    {
+      lower = 0xA0;
+    }
+    else if(0xED == lead)
+    {
+      upper = 0x9F;
+    }
+  }
+  else if(lead < 0xF5)
+  {
+    count = 3;
+    cp = lead & 0x07;
+    if(0xF0 == lead)
+    {
+      lower = 0x90;
+    }
+    else if(0xF4 == lead)
+    {
+      upper = 0x8F;
+    }
+  }
+  else
+  {
+    return NULL;
+  }
+
+  if(static_cast<size_t>(end - iter) <= count)
+  {
+    return NULL;
+  }
+
+  // Only the first continuation byte has a narrowed range.
+  if((iter[1] < lower) || (iter[1] > upper))
+  {
+    return NULL;
+  }
+  for(unsigned ii = 1; (ii <= count); ++ii)
+  {
+    uint8_t cc = iter[ii];
+
+    if(0x80 != (cc & 0xC0))
+    {
+      return NULL;
+    }
+    cp = (cp << 6) | (cc & 0x3F);
+  }
+
+  return iter + count + 1;
+}
+
+/** \brief Scan UTF-8 text into a bitset.
+ *
+ * \param iter Start of text, at a character boundary.
+ * \param chunk_end End of text to scan.
+ * \param data_end End of available data, the last character may extend past chunk end.
+ * \param bitset Codepoint bitset.
+ * \return Position of the first invalid sequence, NULL if text was valid.
+ */
+static const uint8_t* scan_utf8(const uint8_t *iter, const uint8_t *chunk_end, const uint8_t *data_end,
+    uint32_t *bitset)
+{
+  while(iter < chunk_end)
+  {
+    uint8_t cc = *iter;
+
+    if(0x80 > cc)
+    {
+      bitset_mark(bitset, cc);
+      ++iter;
+      continue;
+    }
+
+    uint32_t cp;
+    const uint8_t *next = decode_multibyte(iter, data_end, cp);
+    if(NULL == next)
+    {
+      return iter;
+    }
+
+    bitset_mark(bitset, cp);
+    iter = next;
+  }
+
+  return NULL;
+}
+
+CorpusScanner::CorpusScanner() :
+  m_bitset(bitset_cleanup),
+  m_error_file(0),
+  m_error_offset(0) { }
+
+void CorpusScanner::addFile(const std::string &filename)
+{
+  m_files.push_back(MappedFileSptr(new data::MappedFile(filename)));
+  m_filenames.push_back(filename);
+}
+
+CorpusScanner::bitset_type& CorpusScanner::getBitset()
+{
+  bitset_type *ret = m_bitset.get();
+
+  if(NULL == ret)
+  {
+    bitset_sptr bitset(new bitset_type(CODEPOINT_COUNT / 32, 0));
+
+    {
+      boost::mutex::scoped_lock scope(m_mutex);
+
+      m_bitsets.push_back(bitset);
+    }
+
+    ret = bitset.get();
+    m_bitset.reset(ret);
+  }
+
+  return *ret;
+}
+
+unsigned CorpusScanner::getChunkCount() const
+{
+  unsigned ret = 0;
+
+  BOOST_FOREACH(const MappedFileSptr &vv, m_files)
+  {
+    ret += static_cast<unsigned>((vv->getSize() + CHUNK_SIZE - 1) / CHUNK_SIZE);
+  }
+
+  return ret;
+}
+
+GlyphRange CorpusScanner::getRange()
+{
+  boost::mutex::scoped_lock scope(m_mutex);
+
+  if(!m_error.empty())
+  {
+    BOOST_THROW_EXCEPTION(std::runtime_error(m_error));
+  }
+
+  bitset_type combined(CODEPOINT_COUNT / 32, 0);
+
+  BOOST_FOREACH(const bitset_sptr &vv, m_bitsets)
+  {
+    for(unsigned ii = 0; (ii < CODEPOINT_COUNT / 32); ++ii)
+    {
+      combined[ii] |= (*vv)[ii];
+    }
+  }
+
+  // Control characters (C0, DEL and C1) are never rendered, neither is the byte order mark.
+  combined[0] = 0;
+  combined[0x7F >> 5] &= ~(1u << (0x7F & 31));
+  combined[0x80 >> 5] = 0;
+  combined[0xFEFF >> 5] &= ~(1u << (0xFEFF & 31));
+
+  GlyphRange ret;
+  bool in_run = false;
+  unsigned run_start = 0;
+
+  for(unsigned ii = 0; (ii < CODEPOINT_COUNT / 32); ++ii)
+  {
+    uint32_t word = combined[ii];
+
+    // Skip over whole words that can't end or start a run.
+    if((in_run && (0xFFFFFFFFu == word)) || (!in_run && (0 == word)))
+    {
+      continue;
+    }
+
+    for(unsigned jj = 0; (jj < 32); ++jj)
+    {
+      bool set = (0 != (word & (1u << jj)));
+
+      if(set && !in_run)
+      {
+        run_start = ii * 32 + jj;
+        in_run = true;
+      }
+      else if(!set && in_run)
+      {
+        ret.add(run_start, ii * 32 + jj - 1);
+        in_run = false;
+      }
+    }
+  }
+  if(in_run)
+  {
+    ret.add(run_start, CODEPOINT_COUNT - 1);
+  }
+
+  return ret;
+}
+
+void CorpusScanner::queue()
+{
+  for(unsigned ii = 0; (ii < m_files.size()); ++ii)
+  {
+    const data::MappedFile &file = *(m_files[ii]);
+    const uint8_t *data = file.getData();
+    size_t size = file.getSize();
+
+    for(size_t jj = 0; (jj < size); jj += CHUNK_SIZE)
+    {
+      size_t chunk_start = jj;
+      size_t chunk_end = std::min(jj + CHUNK_SIZE, size);
+
+      // Skip continuation bytes of a sequence started in the previous chunk, it will decode past its end. Any
+      // other continuation bytes are left to be reported as invalid.
+      for(size_t kk = 1; ((kk <= 3) && (kk <= jj)); ++kk)
+      {
+        uint8_t cc = data[jj - kk];
+
+        if(0x80 != (cc & 0xC0))
+        {
+          size_t length = get_sequence_length(cc);
+
+          if(length > kk)
+          {
+            chunk_start = std::min(jj - kk + length, chunk_end);
+          }
+          break;
+        }
+      }
+
+      thr::dispatch(scan_task, boost::ref(*this), ii, chunk_start, chunk_end);
+    }
+  }
+}
+
+void CorpusScanner::reportError(unsigned fidx, size_t offset)
+{
+  boost::mutex::scoped_lock scope(m_mutex);
+
+  if(m_error.empty() || (fidx < m_error_file) || ((fidx == m_error_file) && (offset < m_error_offset)))
+  {
+    std::ostringstream sstr;
+    sstr << "invalid UTF-8 in '" << m_filenames[fidx] << "' at byte " << offset;
+    m_error = sstr.str();
+    m_error_file = fidx;
+    m_error_offset = offset;
+  }
+}
+
+void CorpusScanner::scan(unsigned fidx, size_t pstart, size_t pend)
+{
+  const data::MappedFile &file = *(m_files[fidx]);
+  const uint8_t *data = file.getData();
+  const uint8_t *error = scan_utf8(data + pstart, data + pend, data + file.getSize(), &(this->getBitset()[0]));
+
+  if(NULL != error)
+  {
+    this->reportError(fidx, static_cast<size_t>(error - data));
+  }
+
+  prog::item_done();
+}
+
+void CorpusScanner::scan_task(CorpusScanner &scanner, unsigned fidx, size_t pstart, size_t pend)
+{
+  scanner.scan(fidx, pstart, pend);
+}
@@ -0,0 +1,135 @@
+#ifndef CORPUS_SCANNER_HPP
+#define CORPUS_SCANNER_HPP
+
+#include "glyph_range.hpp"
+
+#include "data/mapped_file.hpp"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <vector>
+
+/** \brief Collects the set of codepoints used in UTF-8 text files.
+ *
+ * Files are memory-mapped and split into chunks that are decoded in parallel on the thread pool. Every thread
+ * collects codepoints into its own bitset, the bitsets are OR-reduced into a glyph range at the end.
+ */
+class CorpusScanner : public boost::noncopyable
+{
+  public:
+    /** Size of one chunk of text scanned by one task. */
+    static const size_t CHUNK_SIZE = 1024 * 1024;
+
+    /** Size of the unicode codepoint space. */
+    static const unsigned CODEPOINT_COUNT = 0x110000;
+
+  private:
+    /** Convenience typedef. */
+    typedef boost::shared_ptr<data::MappedFile> MappedFileSptr;
+
+    /** Convenience typedef. */
+    typedef std::vector<uint32_t> bitset_type;
+
+    /** Convenience typedef. */
+    typedef boost::shared_ptr<bitset_type> bitset_sptr;
+
+  private:
+    /** Mapped files. */
+    std::vector<MappedFileSptr> m_files;
+
+    /** File names, for error reporting. */
+    std::vector<std::string> m_filenames;
+
+    /** Per-thread codepoint bitsets. */
+    std::vector<bitset_sptr> m_bitsets;
+
+    /** Codepoint bitset of the current thread. */
+    boost::thread_specific_ptr<bitset_type> m_bitset;
+
+    /** Guard for bitset registration and error reporting. */
+    boost::mutex m_mutex;
+
+    /** First error in the corpus, empty if none. */
+    std::string m_error;
+
+    /** File index of the first error. */
+    unsigned m_error_file;
+
+    /** Byte offset of the first error within its file. */
+    size_t m_error_offset;
+
+  public:
+    /** \brief Constructor.
+     */
+    CorpusScanner();
+
+    /** \brief Destructor.
+     */
+    ~CorpusScanner() { }
+
+  private:
+    /** \brief Get the codepoint bitset of the current thread.
+     *
+     * Registers a new bitset on first call from a thread.
+     *
+     * \return Bitset.
+     */
+    bitset_type& getBitset();
+
+    /** \brief Report an encoding error.
+     *
+     * Only the error first in the corpus is stored, regardless of the order chunks are scanned in.
+     *
+     * \param fidx File index.
+     * \param offset Byte offset of the error within the file.
+     */
+    void reportError(unsigned fidx, size_t offset);
+
+    /** \brief Scan one chunk.
+     *
+     * \param fidx File index.
+     * \param pstart Start offset of the chunk, at a character boundary.
+     * \param pend End offset of the chunk. Last character may extend past it.
+     */
+    void scan(unsigned fidx, size_t pstart, size_t pend);
+
+    /** \brief Task wrapper for scan().
+     *
+     * \param scanner Scanner.
+     * \param fidx File index.
+     * \param pstart Start offset of the chunk.
+     * \param pend End offset of the chunk.
+     */
+    static void scan_task(CorpusScanner &scanner, unsigned fidx, size_t pstart, size_t pend);
+
+  public:
+    /** \brief Add a file.
+     *
+     * Throws an error if the file can't be mapped.
+     *
+     * \param filename File to add.
+     */
+    void addFile(const std::string &filename);
+
+    /** \brief Get the number of chunks queue() will dispatch.
+     *
+     * \return Number of chunks.
+     */
+    unsigned getChunkCount() const;
+
+    /** \brief Get the range of all codepoints found.
+     *
+     * Must be called after all dispatched scans have completed. Control characters and byte order marks are
+     * not included. Throws an error if any of the files was not valid UTF-8.
+     *
+     * \return Glyph range (disabled).
+     */
+    GlyphRange getRange();
+
+    /** \brief Queue scanning of all files.
+     */
+    void queue();
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "data/mapped_file.hpp"
+
+#include <sstream>
+
+#if !defined(WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace data;
+
+MappedFile::MappedFile(const std::string &filename) :
+  m_data(NULL),
+  m_size(0)
+{
+#if defined(WIN32)
+  m_mapping = NULL;
+  m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+      FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if(INVALID_HANDLE_VALUE == m_file)
+  {
+    std::ostringstream sstr;
+    sstr << "could not open '" << filename << '\'';
+    BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+  }
+
+  LARGE_INTEGER size;
+  if(!GetFileSizeEx(m_file, &size))
+  {
+    CloseHandle(m_file);
+    std::ostringstream sstr;
+    sstr << "could not get size of '" << filename << '\'';
+    BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+  }
+  m_size = static_cast<size_t>(size.QuadPart);
+
+  if(0 < m_size)
+  {
+    m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(NULL != m_mapping)
+    {
+      m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if(NULL == m_data)
+    {
+      if(NULL != m_mapping)
+      {
+        CloseHandle(m_mapping);
+      }
+      CloseHandle(m_file);
+      std::ostringstream sstr;
+      sstr << "could not map '" << filename << '\'';
+      BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+    }
+  }
+#else
+  m_fd = open(filename.c_str(), O_RDONLY);
+  if(0 > m_fd)
+  {
+    std::ostringstream sstr;
+    sstr << "could not open '" << filename << '\'';
+    BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+  }
+
+  struct stat st;
+  if(0 != fstat(m_fd, &st))
+  {
+    close(m_fd);
+    std::ostringstream sstr;
+    sstr << "could not get size of '" << filename << '\'';
+    BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+  }
+  m_size = static_cast<size_t>(st.st_size);
+
+  if(0 < m_size)
+  {
+    void *data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if(MAP_FAILED == data)
+    {
+      close(m_fd);
+      std::ostringstream sstr;
+      sstr << "could not map '" << filename << '\'';
+      BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+    }
+    madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const uint8_t*>(data);
+  }
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(WIN32)
+  if(NULL != m_data)
+  {
+    UnmapViewOfFile(m_data);
+  }
+  if(NULL != m_mapping)
+  {
+    CloseHandle(m_mapping);
+  }
+  CloseHandle(m_file);
+#else
+  if(NULL != m_data)
+  {
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+  }
+  close(m_fd);
+#endif
+}
@@ -0,0 +1,68 @@
+#ifndef DATA_MAPPED_FILE_HPP
+#define DATA_MAPPED_FILE_HPP
+
+#include "defaults.hpp"
+
+#include <string>
+
+namespace data
+{
+  /** \brief Read-only memory-mapped file.
+   *
+   * The whole file is mapped on construction and unmapped on destruction.
+   */
+  class MappedFile : public boost::noncopyable
+  {
+    private:
+      /** Mapped data, NULL if the file is empty. */
+      const uint8_t *m_data;
+
+      /** Size of the mapping in bytes. */
+      size_t m_size;
+
+#if defined(WIN32)
+      /** File handle. */
+      HANDLE m_file;
+
+      /** File mapping handle. */
+      HANDLE m_mapping;
+#else
+      /** File descriptor. */
+      int m_fd;
+#endif
+
+    public:
+      /** \brief Constructor.
+       *
+       * Throws an error on failure.
+       *
+       * \param filename File to map.
+       */
+      MappedFile(const std::string &filename);
+
+      /** \brief Destructor.
+       */
+      ~MappedFile();
+
+    public:
+      /** \brief Get mapped data.
+       *
+       * \return Pointer to the beginning of file, NULL if file is empty.
+       */
+      inline const uint8_t* getData() const
+      {
+        return m_data;
+      }
+
+      /** \brief Get file size.
+       *
+       * \return Size in bytes.
+       */
+      inline size_t getSize() const
+      {
+        return m_size;
+      }
+  };
+}
+
+#endif
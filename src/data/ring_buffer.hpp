@@ -0,0 +1,168 @@
+#ifndef DATA_RING_BUFFER_HPP
+#define DATA_RING_BUFFER_HPP
+
+#include "defaults.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+
+namespace data
+{
+  /** \brief Lock-free bounded ring buffer.
+   *
+   * Multiple producers and multiple consumers may access the buffer concurrently without locking. Every cell
+   * carries a sequence number that tells whether it is ready to be written or read for the current lap around
+   * the ring.
+   *
+   * Unlike CircularBuffer, this buffer never grows. Insertion fails if the buffer is full.
+   */
+  template <typename Type> class RingBuffer : public boost::noncopyable
+  {
+    private:
+      /** Size of a cache line, used for padding. */
+      static const size_t CACHE_LINE = 64;
+
+      /** \brief One element in the ring.
+       */
+      class Cell
+      {
+        public:
+          /** Sequence number. */
+          boost::atomic<size_t> m_sequence;
+
+          /** Data. */
+          Type m_data;
+      };
+
+    private:
+      /** Actual array for data. */
+      boost::scoped_array<Cell> m_array;
+
+      /** Size of the array minus one, size is always a power of two. */
+      size_t m_mask;
+
+      /** Padding. */
+      uint8_t m_pad_insert[CACHE_LINE];
+
+      /** Next index to insert to. */
+      boost::atomic<size_t> m_index_insert;
+
+      /** Padding. */
+      uint8_t m_pad_current[CACHE_LINE];
+
+      /** Next index to extract. */
+      boost::atomic<size_t> m_index_current;
+
+      /** Padding. */
+      uint8_t m_pad_end[CACHE_LINE];
+
+    public:
+      /** \brief Constructor.
+       *
+       * \param psize Capacity, rounded up to the next power of two.
+       */
+      RingBuffer(unsigned psize)
+      {
+        size_t size = 2;
+
+        while(size < psize)
+        {
+          size <<= 1;
+        }
+
+        m_array.reset(new Cell[size]);
+        m_mask = size - 1;
+
+        for(size_t ii = 0; (ii < size); ++ii)
+        {
+          m_array[ii].m_sequence.store(ii, boost::memory_order_relaxed);
+        }
+
+        m_index_insert.store(0, boost::memory_order_relaxed);
+        m_index_current.store(0, boost::memory_order_relaxed);
+      }
+
+    public:
+      /** \brief Get the capacity of the buffer.
+       *
+       * \return Capacity.
+       */
+      unsigned capacity() const
+      {
+        return static_cast<unsigned>(m_mask + 1);
+      }
+
+      /** \brief Get an item from the buffer.
+       *
+       * \param op Destination of the extracted item.
+       * \return True if an item was extracted, false if the buffer was empty.
+       */
+      bool get(Type &op)
+      {
+        size_t pos = m_index_current.load(boost::memory_order_relaxed);
+
+        for(;;)
+        {
+          Cell &cell = m_array[pos & m_mask];
+          size_t seq = cell.m_sequence.load(boost::memory_order_acquire);
+          ptrdiff_t diff = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos + 1);
+
+          if(0 == diff)
+          {
+            if(m_index_current.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed))
+            {
+              op = cell.m_data;
+              cell.m_data = Type();
+              cell.m_sequence.store(pos + m_mask + 1, boost::memory_order_release);
+              return true;
+            }
+          }
+          else if(0 > diff)
+          {
+            return false;
+          }
+          else
+          {
+            pos = m_index_current.load(boost::memory_order_relaxed);
+          }
+        }
+      }
+
+      /** \brief Put an item into the buffer.
+       *
+       * \param op Item to insert.
+       * \return True if inserted, false if the buffer was full.
+       */
+      bool put(const Type &op)
+      {
+        size_t pos = m_index_insert.load(boost::memory_order_relaxed);
+
+        for(;;)
+        {
+          Cell &cell = m_array[pos & m_mask];
+          size_t seq = cell.m_sequence.load(boost::memory_order_acquire);
+          ptrdiff_t diff = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos);
+
+          if(0 == diff)
+          {
+            if(m_index_insert.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed))
+            {
+              cell.m_data = op;
+              cell.m_sequence.store(pos + 1, boost::memory_order_release);
+              return true;
+            }
+          }
+          else if(0 > diff)
+          {
+            return false;
+          }
+          else
+          {
+            pos = m_index_insert.load(boost::memory_order_relaxed);
+          }
+        }
+      }
+  };
+}
+
+#endif
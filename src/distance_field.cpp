@@ -0,0 +1,110 @@
+#include "distance_field.hpp"
+
+/** \brief Find the field samples bracketing every position.
+ *
+ * \param field Field coordinates, ascending.
+ * \param positions Positions to bracket.
+ * \param first Index of the field sample at or before every position.
+ * \param second Index of the field sample after every position.
+ * \param weight Weight of the second sample for every position.
+ */
+static void bracket_positions(const std::vector<float> &field, const std::vector<float> &positions,
+    std::vector<unsigned> &first, std::vector<unsigned> &second, std::vector<float> &weight)
+{
+  unsigned last = static_cast<unsigned>(field.size()) - 1;
+
+  first.resize(positions.size());
+  second.resize(positions.size());
+  weight.resize(positions.size());
+
+  for(unsigned ii = 0; (ii < positions.size()); ++ii)
+  {
+    float pos = positions[ii];
+
+    if(pos <= field.front())
+    {
+      first[ii] = second[ii] = 0;
+      weight[ii] = 0.0f;
+      continue;
+    }
+    if(pos >= field.back())
+    {
+      first[ii] = second[ii] = last;
+      weight[ii] = 0.0f;
+      continue;
+    }
+
+    unsigned idx = static_cast<unsigned>(std::upper_bound(field.begin(), field.end(), pos) - field.begin());
+
+    first[ii] = idx - 1;
+    second[ii] = idx;
+    weight[ii] = (pos - field[idx - 1]) / (field[idx] - field[idx - 1]);
+  }
+}
+
+DistanceField::DistanceField() :
+  m_channels(1),
+  m_ink_x1(0),
+  m_ink_y1(0),
+  m_ink_x2(-1),
+  m_ink_y2(-1) { }
+
+void DistanceField::assign(const std::vector<float> &px, const std::vector<float> &py, unsigned pchannels,
+    const float *distances, int x1, int y1, int x2, int y2)
+{
+  m_x = px;
+  m_y = py;
+  m_channels = pchannels;
+  m_distances.assign(distances, distances + px.size() * py.size() * pchannels);
+  m_ink_x1 = x1;
+  m_ink_y1 = y1;
+  m_ink_x2 = x2;
+  m_ink_y2 = y2;
+}
+
+bool DistanceField::getBounds(int &x1, int &y1, int &x2, int &y2) const
+{
+  x1 = m_ink_x1;
+  y1 = m_ink_y1;
+  x2 = m_ink_x2;
+  y2 = m_ink_y2;
+
+  return !m_distances.empty();
+}
+
+void DistanceField::resample(float *dst, const std::vector<float> &px, const std::vector<float> &py) const
+{
+  BOOST_ASSERT(!m_distances.empty());
+
+  std::vector<unsigned> x1;
+  std::vector<unsigned> x2;
+  std::vector<float> wx;
+  std::vector<unsigned> y1;
+  std::vector<unsigned> y2;
+  std::vector<float> wy;
+  bracket_positions(m_x, px, x1, x2, wx);
+  bracket_positions(m_y, py, y1, y2, wy);
+
+  unsigned stride = static_cast<unsigned>(m_x.size()) * m_channels;
+  for(unsigned jj = 0; (jj < py.size()); ++jj)
+  {
+    const float *top = &(m_distances[y1[jj] * stride]);
+    const float *bottom = &(m_distances[y2[jj] * stride]);
+    float weight_y = wy[jj];
+
+    for(unsigned ii = 0; (ii < px.size()); ++ii)
+    {
+      unsigned left = x1[ii] * m_channels;
+      unsigned right = x2[ii] * m_channels;
+      float weight_x = wx[ii];
+
+      for(unsigned kk = 0; (kk < m_channels); ++kk)
+      {
+        float upper = (1.0f - weight_x) * top[left + kk] + weight_x * top[right + kk];
+        float lower = (1.0f - weight_x) * bottom[left + kk] + weight_x * bottom[right + kk];
+
+        *dst++ = (1.0f - weight_y) * upper + weight_y * lower;
+      }
+    }
+  }
+}
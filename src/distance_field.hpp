@@ -0,0 +1,97 @@
+#ifndef DISTANCE_FIELD_HPP
+#define DISTANCE_FIELD_HPP
+
+#include "defaults.hpp"
+
+#include <vector>
+
+/** \brief Unquantized distances of a glyph crunched to one target size.
+ *
+ * Samples lie on a grid in precalc bitmap coordinates. Smaller target sizes of the same precalc bitmap are
+ * interpolated from it instead of searching for distances again.
+ */
+class DistanceField : public boost::noncopyable
+{
+  private:
+    /** Precalc bitmap X coordinate of every column, ascending. */
+    std::vector<float> m_x;
+
+    /** Precalc bitmap Y coordinate of every row, ascending. */
+    std::vector<float> m_y;
+
+    /** Number of distances per sample. */
+    unsigned m_channels;
+
+    /** Distances in precalc pixels, positive inside, channels of every sample interleaved. */
+    std::vector<float> m_distances;
+
+    /** Leftmost ink column. */
+    int m_ink_x1;
+
+    /** Topmost ink row. */
+    int m_ink_y1;
+
+    /** Rightmost ink column. */
+    int m_ink_x2;
+
+    /** Bottommost ink row. */
+    int m_ink_y2;
+
+  public:
+    /** \brief Constructor.
+     *
+     * Field has no ink and no samples until assigned.
+     */
+    DistanceField();
+
+  public:
+    /** \brief Assign sampled distances.
+     *
+     * \param px Precalc bitmap X coordinate of every column.
+     * \param py Precalc bitmap Y coordinate of every row.
+     * \param pchannels Number of distances per sample.
+     * \param distances Distances, channels of every sample interleaved.
+     * \param x1 Leftmost ink column.
+     * \param y1 Topmost ink row.
+     * \param x2 Rightmost ink column.
+     * \param y2 Bottommost ink row.
+     */
+    void assign(const std::vector<float> &px, const std::vector<float> &py, unsigned pchannels,
+        const float *distances, int x1, int y1, int x2, int y2);
+
+    /** \brief Find the bounds of ink the distances were sampled around.
+     *
+     * \param x1 Leftmost ink column.
+     * \param y1 Topmost ink row.
+     * \param x2 Rightmost ink column.
+     * \param y2 Bottommost ink row.
+     * \return True if there was any ink, false otherwise.
+     */
+    bool getBounds(int &x1, int &y1, int &x2, int &y2) const;
+
+    /** \brief Interpolate distances at another grid.
+     *
+     * Distances are interpolated bilinearly. Positions outside the field take the value of the nearest edge,
+     * which is saturated, since the field extends past the search radius from ink.
+     *
+     * \param dst Distance output, channels of every sample interleaved.
+     * \param px Precalc bitmap X coordinate of every column, ascending.
+     * \param py Precalc bitmap Y coordinate of every row, ascending.
+     */
+    void resample(float *dst, const std::vector<float> &px, const std::vector<float> &py) const;
+
+  public:
+    /** \brief Get number of distances per sample.
+     *
+     * \return Channel count.
+     */
+    inline unsigned getChannels() const
+    {
+      return m_channels;
+    }
+};
+
+/** Convenience typedef. */
+typedef boost::shared_ptr<DistanceField> DistanceFieldSptr;
+
+#endif
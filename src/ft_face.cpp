@@ -1,15 +1,105 @@
 #include "ft_face.hpp"
 
+#include "bitmap_pool.hpp"
 #include "ft_glyph.hpp"
 #include "ft_library.hpp"
 #include "math/generic.hpp"
 
+#include <boost/thread/mutex.hpp>
+
 #include <sstream>
 
-FtFace::FtFace(const std::string &filename, unsigned psize, float pdropdown) :
+#include FT_BITMAP_H
+#include FT_OUTLINE_H
+
+/** Guard for spare faces, also for opening them since the shared library may not open faces concurrently. */
+static boost::mutex face_mutex;
+
+/** \brief Get the control box of an outline snapped to full pixels like the smooth renderer would.
+ *
+ * \param outline Outline.
+ * \param cbox Snapped control box.
+ */
+static void get_pixel_cbox(const FT_Outline *outline, FT_BBox &cbox)
+{
+  FT_Outline_Get_CBox(outline, &cbox);
+  cbox.xMin &= ~63;
+  cbox.yMin &= ~63;
+  cbox.xMax = (cbox.xMax + 63) & ~63;
+  cbox.yMax = (cbox.yMax + 63) & ~63;
+}
+
+/** \brief Measure the metrics of a glyph without rendering it.
+ *
+ * \param face Face at precalc size.
+ * \param unicode Unicode glyph number.
+ * \param size Precalc size.
+ * \param dropdown Dropdown.
+ * \param mode Distance measurement mode.
+ * \return Measured glyph if successful, NULL on error.
+ */
+static FtGlyph* measure_glyph(FT_Face face, unsigned unicode, unsigned size, float dropdown, DistanceMode mode)
+{
+  unsigned idx = FT_Get_Char_Index(face, unicode);
+
+  if(0 == idx)
+  {
+    //std::cerr << "could not find character of index " << unicode << std::endl;
+    return NULL;
+  }
+
+  if(FT_Load_Glyph(face, idx, FT_LOAD_DEFAULT))
+  {
+    //std::cerr << "could not load glyph " << unicode << std::endl;
+    return NULL;
+  }
+
+  FT_GlyphSlot glyph = face->glyph;
+  FT_Pos width;
+  FT_Pos rows;
+  FT_Pos left;
+  FT_Pos top;
+
+  if(glyph->format == FT_GLYPH_FORMAT_OUTLINE)
+  {
+    FT_BBox cbox;
+
+    get_pixel_cbox(&glyph->outline, cbox);
+    width = (cbox.xMax - cbox.xMin) >> 6;
+    rows = (cbox.yMax - cbox.yMin) >> 6;
+    left = cbox.xMin >> 6;
+    top = cbox.yMax >> 6;
+  }
+  else
+  {
+    // Glyphs in other formats only know their size once rendered.
+    if((glyph->format != FT_GLYPH_FORMAT_BITMAP) && FT_Render_Glyph(glyph, FT_RENDER_MODE_NORMAL))
+    {
+      //std::cerr << "could not render glyph: " << unicode << std::endl;
+      return NULL;
+    }
+
+    width = static_cast<FT_Pos>(glyph->bitmap.width);
+    rows = static_cast<FT_Pos>(glyph->bitmap.rows);
+    left = glyph->bitmap_left;
+    top = glyph->bitmap_top;
+  }
+
+  return new FtGlyph(unicode, size, dropdown, mode, static_cast<float>(width),
+      static_cast<float>(rows), static_cast<float>(left), static_cast<float>(top),
+      static_cast<float>(glyph->advance.x), static_cast<float>(glyph->advance.y));
+}
+
+FtFace::FtFace(const std::string &filename, unsigned psize, float pdropdown, DistanceMode pmode,
+    DistanceEngine pengine, float ptolerance) :
   m_face(NULL),
   m_size(psize),
-  m_dropdown(pdropdown)
+  m_current_size(psize),
+  m_dropdown(pdropdown),
+  m_distance_mode(pmode),
+  m_distance_engine(pengine),
+  m_adaptive_tolerance(ptolerance),
+  m_filename(filename)
 {
   if(FT_New_Face(FtLibrary::get(), filename.c_str(), 0, &(m_face)))
   {
@@ -27,20 +117,242 @@ FtFace::FtFace(const std::string &filename, unsigned psize, float pdropdown) :
 
 FtFace::~FtFace()
 {
+  BOOST_FOREACH(FT_Face vv, m_spare_faces)
+  {
+    FT_Done_Face(vv);
+  }
   if(NULL != m_face)
   {
     FT_Done_Face(m_face);
   }
 }
 
+FT_Face FtFace::acquireFace()
+{
+  boost::mutex::scoped_lock scope(face_mutex);
+
+  if(!m_spare_faces.empty())
+  {
+    FT_Face ret = m_spare_faces.back();
+    m_spare_faces.pop_back();
+    return ret;
+  }
+
+  FT_Face ret;
+  if(FT_New_Face(FtLibrary::get(), m_filename.c_str(), 0, &ret))
+  {
+    //std::cerr << "could not load font: " << m_filename << std::endl;
+    return NULL;
+  }
+  if(FT_Set_Pixel_Sizes(ret, 0, m_size))
+  {
+    //std::cerr << "could not set font size to " << m_size << std::endl;
+    FT_Done_Face(ret);
+    return NULL;
+  }
+  return ret;
+}
+
+void FtFace::releaseFace(FT_Face op)
+{
+  boost::mutex::scoped_lock scope(face_mutex);
+
+  m_spare_faces.push_back(op);
+}
+
+FtGlyph* FtFace::measureGlyph(unsigned unicode)
+{
+  FT_Face face = this->acquireFace();
+
+  if(NULL == face)
+  {
+    return NULL;
+  }
+
+  FtGlyph *ret = measure_glyph(face, unicode, m_size, m_dropdown, m_distance_mode);
+
+  this->releaseFace(face);
+  return ret;
+}
+
+uint64_t FtFace::estimateCost(unsigned unicode)
+{
+  unsigned idx = FT_Get_Char_Index(m_face, unicode);
+
+  if((0 == idx) || !m_estimated.insert(idx).second)
+  {
+    return 0;
+  }
+
+  if(!this->setCurrentSize(m_size) || FT_Load_Glyph(m_face, idx, FT_LOAD_NO_HINTING))
+  {
+    //std::cerr << "could not load glyph " << unicode << std::endl;
+    return 0;
+  }
+
+  const FT_Glyph_Metrics &metrics = m_face->glyph->metrics;
+  uint64_t search = static_cast<uint64_t>(math::ceil(static_cast<float>(m_size) * m_dropdown));
+  uint64_t width = static_cast<uint64_t>((metrics.width + 63) >> 6) + search * 2;
+  uint64_t rows = static_cast<uint64_t>((metrics.height + 63) >> 6) + search * 2;
+
+  return width * rows;
+}
+
+FtGlyph* FtFace::planGlyph(unsigned unicode, unsigned targetsize, float dropdown, unsigned slack)
+{
+  unsigned idx = FT_Get_Char_Index(m_face, unicode);
+
+  if(0 == idx)
+  {
+    //std::cerr << "could not find character of index " << unicode << std::endl;
+    return NULL;
+  }
+
+  // Faces without outlines only have metrics at their pixel sizes.
+  bool scalable = FT_IS_SCALABLE(m_face);
+  float scale = scalable ? (1.0f / static_cast<float>(m_face->units_per_EM)) :
+    (1.0f / (static_cast<float>(m_size) * 64.0f));
+
+  if((!scalable && !this->setCurrentSize(m_size)) ||
+      FT_Load_Glyph(m_face, idx, scalable ? FT_LOAD_NO_SCALE : FT_LOAD_DEFAULT))
+  {
+    //std::cerr << "could not load glyph " << unicode << std::endl;
+    return NULL;
+  }
+
+  const FT_Glyph_Metrics &metrics = m_face->glyph->metrics;
+  float ftarget = static_cast<float>(targetsize);
+  unsigned width = 0;
+  unsigned rows = 0;
+
+  // Glyphs without ink are not sampled at all. Empty border kept around the trimmed area is about one sample
+  // wider than samples rounded to zero at the search radius.
+  if((0 < metrics.width) && (0 < metrics.height))
+  {
+    width = static_cast<unsigned>(math::ceil((static_cast<float>(metrics.width) * scale + 2.0f * dropdown) *
+          ftarget)) + 1 + slack;
+    rows = static_cast<unsigned>(math::ceil((static_cast<float>(metrics.height) * scale + 2.0f * dropdown) *
+          ftarget)) + 1 + slack;
+  }
+
+  return new FtGlyph(unicode, targetsize, dropdown, m_distance_mode, width, rows);
+}
+
+bool FtFace::findRendered(unsigned unicode, unsigned &rendered)
+{
+  std::map<unsigned, unsigned>::const_iterator iter = m_rendered.find(FT_Get_Char_Index(m_face, unicode));
+
+  if(m_rendered.end() == iter)
+  {
+    return false;
+  }
+
+  rendered = iter->second;
+  return true;
+}
+
 bool FtFace::hasGlyph(unsigned unicode)
 {
   return (FT_Get_Char_Index(m_face, unicode) > 0);
 }
 
-FtGlyph* FtFace::renderGlyph(unsigned unicode, unsigned targetsize)
+void FtFace::markRendered(unsigned unicode)
+{
+  unsigned idx = FT_Get_Char_Index(m_face, unicode);
+
+  if(0 < idx)
+  {
+    m_rendered.insert(std::make_pair(idx, unicode));
+  }
+}
+
+bool FtFace::setCurrentSize(unsigned size)
+{
+  if(size != m_current_size)
+  {
+    if(FT_Set_Pixel_Sizes(m_face, 0, size))
+    {
+      //std::cerr << "could not set font size to " << size << std::endl;
+      return false;
+    }
+    m_current_size = size;
+  }
+
+  return true;
+}
+
+FtGlyph* FtFace::renderSdfGlyph(unsigned idx, unsigned unicode, unsigned targetsize, unsigned size,
+    BitmapPool &pool)
+{
+  // Distance field must spread as far as the dropdown reaches, precalc size is limited by the largest spread.
+  unsigned sdf_size = math::min(size,
+      static_cast<unsigned>(static_cast<float>(FtLibrary::SDF_MAX_SPREAD) / m_dropdown));
+  unsigned spread = static_cast<unsigned>(math::ceil(static_cast<float>(sdf_size) * m_dropdown));
+
+  spread = math::min(math::max(spread, static_cast<unsigned>(FtLibrary::SDF_MIN_SPREAD)),
+      static_cast<unsigned>(FtLibrary::SDF_MAX_SPREAD));
+
+  if(!FtLibrary::setSdfSpread(spread) || !this->setCurrentSize(sdf_size))
+  {
+    return NULL;
+  }
+
+  if(FT_Load_Glyph(m_face, idx, FT_LOAD_DEFAULT))
+  {
+    //std::cerr << "could not load glyph " << unicode << std::endl;
+    return NULL;
+  }
+
+  // Outline glyphs are rendered with the outline renderer, bitmap glyphs with the bitmap renderer. Rendering
+  // outlines into coverage bitmaps first forces the bitmap renderer.
+  FT_GlyphSlot glyph = m_face->glyph;
+  if((ENGINE_FREETYPE_BITMAP == m_distance_engine) && (FT_GLYPH_FORMAT_BITMAP != glyph->format) &&
+      FT_Render_Glyph(glyph, FT_RENDER_MODE_NORMAL))
+  {
+    //std::cerr << "could not render glyph: " << unicode << std::endl;
+    return NULL;
+  }
+#if FT_LIBRARY_SDF
+  if(FT_Render_Glyph(glyph, FT_RENDER_MODE_SDF) || (FT_PIXEL_MODE_GRAY != glyph->bitmap.pixel_mode))
+  {
+    //std::cerr << "could not render distance field: " << unicode << std::endl;
+    return NULL;
+  }
+#else
+  // Not reached, setting the spread fails without distance field support.
+  return NULL;
+#endif
+
+  FT_Bitmap bitmap;
+
+  FT_Bitmap_New(&bitmap);
+  bitmap.num_grays = 256;
+  bitmap.pixel_mode = FT_PIXEL_MODE_GRAY;
+  bitmap.width = glyph->bitmap.width;
+  bitmap.rows = glyph->bitmap.rows;
+  bitmap.pitch = static_cast<int>(bitmap.width);
+  bitmap.buffer = pool.acquire(bitmap.width * bitmap.rows);
+
+  if(NULL != bitmap.buffer)
+  {
+    for(unsigned jj = 0; (jj < bitmap.rows); ++jj)
+    {
+      memcpy(bitmap.buffer + jj * bitmap.width,
+          glyph->bitmap.buffer + static_cast<int>(jj) * glyph->bitmap.pitch, bitmap.width);
+    }
+  }
+
+  FtGlyph *ret = new FtGlyph(unicode, bitmap, pool, sdf_size, targetsize, m_dropdown, m_distance_mode,
+      m_distance_engine, static_cast<float>(glyph->bitmap_left), static_cast<float>(glyph->bitmap_top),
+      static_cast<float>(glyph->advance.x), static_cast<float>(glyph->advance.y));
+  ret->setSpread(spread);
+  return ret;
+}
+
+FtGlyph* FtFace::renderGlyph(unsigned unicode, unsigned targetsize, unsigned size, BitmapPool &pool)
 {
   unsigned idx = FT_Get_Char_Index(m_face, unicode);
+  DistanceEngine engine = m_distance_engine;
 
   if(0 == idx)
   {
@@ -48,6 +360,26 @@ FtGlyph* FtFace::renderGlyph(unsigned unicode, unsigned targetsize)
     return NULL;
   }
 
+  // Glyphs FreeType can not render distance fields for fall back to the default engine.
+  if((ENGINE_FREETYPE == engine) || (ENGINE_FREETYPE_BITMAP == engine))
+  {
+    if(DISTANCE_MSDF != m_distance_mode)
+    {
+      FtGlyph *ret = this->renderSdfGlyph(idx, unicode, targetsize, size, pool);
+
+      if(NULL != ret)
+      {
+        return ret;
+      }
+    }
+    engine = ENGINE_GRID;
+  }
+
+  if(!this->setCurrentSize(size))
+  {
+    return NULL;
+  }
+
   if(FT_Load_Glyph(m_face, idx, FT_LOAD_DEFAULT))
   {
     //std::cerr << "could not load glyph " << unicode << std::endl;
@@ -55,19 +387,146 @@ FtGlyph* FtFace::renderGlyph(unsigned unicode, unsigned targetsize)
   }
 
   FT_GlyphSlot glyph = m_face->glyph;
-  if(glyph->format != FT_GLYPH_FORMAT_BITMAP)
+  FT_Bitmap bitmap;
+  FT_Pos bitmap_left;
+  FT_Pos bitmap_top;
+
+  FT_Bitmap_New(&bitmap);
+  bitmap.num_grays = 256;
+  bitmap.pixel_mode = FT_PIXEL_MODE_GRAY;
+
+  if(glyph->format == FT_GLYPH_FORMAT_OUTLINE)
   {
-    FT_Error err = FT_Render_Glyph(glyph, FT_RENDER_MODE_NORMAL);
+    FT_BBox cbox;
+
+    get_pixel_cbox(&glyph->outline, cbox);
+
+    bitmap.width = static_cast<unsigned>((cbox.xMax - cbox.xMin) >> 6);
+    bitmap.rows = static_cast<unsigned>((cbox.yMax - cbox.yMin) >> 6);
 
-    if(0 != err)
+    // Runs replace the precalc bitmap entirely, only the pixels at or above half coverage are ever needed.
+    if((DISTANCE_BINARY == m_distance_mode) && (ENGINE_RUNS == engine))
     {
-      //std::cerr << "could not render glyph: " << unicode << std::endl;
+      GlyphRunsSptr runs(new GlyphRuns(bitmap.width, bitmap.rows));
+
+      FT_Outline_Translate(&glyph->outline, -cbox.xMin, -cbox.yMin);
+      if(!runs->render(&glyph->outline))
+      {
+        //std::cerr << "could not render glyph: " << unicode << std::endl;
+        return NULL;
+      }
+
+      return new FtGlyph(unicode, runs, size, targetsize, m_dropdown, engine,
+          static_cast<float>(cbox.xMin >> 6), static_cast<float>(cbox.yMax >> 6),
+          static_cast<float>(glyph->advance.x), static_cast<float>(glyph->advance.y));
+    }
+
+    // Multi-channel distances are measured from the outline itself, no bitmap is rendered.
+    if(DISTANCE_MSDF == m_distance_mode)
+    {
+      MsdfShapeSptr shape(new MsdfShape(bitmap.width, bitmap.rows));
+
+      FT_Outline_Translate(&glyph->outline, -cbox.xMin, -cbox.yMin);
+      if(!shape->decompose(&glyph->outline))
+      {
+        //std::cerr << "could not decompose glyph: " << unicode << std::endl;
+        return NULL;
+      }
+
+      return new FtGlyph(unicode, shape, size, targetsize, m_dropdown,
+          static_cast<float>(cbox.xMin >> 6), static_cast<float>(cbox.yMax >> 6),
+          static_cast<float>(glyph->advance.x), static_cast<float>(glyph->advance.y));
+    }
+
+    // Precalc bitmaps too large to allocate at once are rendered one tile at a time while crunching.
+    if((GlyphTiles::MAX_UNTILED_SIZE < bitmap.width) || (GlyphTiles::MAX_UNTILED_SIZE < bitmap.rows))
+    {
+      GlyphTilesSptr tiles(new GlyphTiles(bitmap.width, bitmap.rows));
+
+      FT_Outline_Translate(&glyph->outline, -cbox.xMin, -cbox.yMin);
+      if(!tiles->setOutline(&glyph->outline))
+      {
+        //std::cerr << "could not copy outline: " << unicode << std::endl;
+        return NULL;
+      }
+
+      return new FtGlyph(unicode, tiles, size, targetsize, m_dropdown, m_distance_mode, engine,
+          static_cast<float>(cbox.xMin >> 6), static_cast<float>(cbox.yMax >> 6),
+          static_cast<float>(glyph->advance.x), static_cast<float>(glyph->advance.y));
+    }
+
+    bitmap.pitch = static_cast<int>(bitmap.width);
+    bitmap.buffer = pool.acquire(bitmap.width * bitmap.rows);
+
+    if(NULL != bitmap.buffer)
+    {
+      memset(bitmap.buffer, 0, bitmap.width * bitmap.rows);
+
+      FT_Outline_Translate(&glyph->outline, -cbox.xMin, -cbox.yMin);
+      if(FT_Outline_Get_Bitmap(FtLibrary::get(), &glyph->outline, &bitmap))
+      {
+        //std::cerr << "could not render glyph: " << unicode << std::endl;
+        pool.release(bitmap.buffer);
+        return NULL;
+      }
+    }
+
+    bitmap_left = cbox.xMin >> 6;
+    bitmap_top = cbox.yMax >> 6;
+  }
+  else
+  {
+    if(glyph->format != FT_GLYPH_FORMAT_BITMAP)
+    {
+      FT_Error err = FT_Render_Glyph(glyph, FT_RENDER_MODE_NORMAL);
+
+      if(0 != err)
+      {
+        //std::cerr << "could not render glyph: " << unicode << std::endl;
+        return NULL;
+      }
+    }
+
+    // Bitmaps coming from FreeType may be of any depth, normalize to 8-bit gray in a pooled buffer.
+    FT_Bitmap converted;
+    FT_Bitmap_New(&converted);
+    if(FT_Bitmap_Convert(FtLibrary::get(), &glyph->bitmap, &converted, 1))
+    {
+      //std::cerr << "could not convert glyph: " << unicode << std::endl;
+      FT_Bitmap_Done(FtLibrary::get(), &converted);
       return NULL;
     }
+
+    bitmap.width = converted.width;
+    bitmap.rows = converted.rows;
+    bitmap.pitch = static_cast<int>(bitmap.width);
+    bitmap.buffer = pool.acquire(bitmap.width * bitmap.rows);
+
+    // Negative pitch means rows are stored bottom up, the top row is then the last one in the buffer.
+    const uint8_t *src_top = converted.buffer;
+    if((0 > converted.pitch) && (0 < converted.rows))
+    {
+      src_top -= static_cast<ptrdiff_t>(converted.rows - 1) * converted.pitch;
+    }
+
+    unsigned grays = math::max(static_cast<unsigned>(converted.num_grays), 2u) - 1;
+    for(unsigned jj = 0; (jj < bitmap.rows); ++jj)
+    {
+      const uint8_t *src = src_top + static_cast<ptrdiff_t>(jj) * converted.pitch;
+      uint8_t *dst = bitmap.buffer + jj * bitmap.width;
+
+      for(unsigned ii = 0; (ii < bitmap.width); ++ii)
+      {
+        dst[ii] = static_cast<uint8_t>(math::min(static_cast<unsigned>(src[ii]) * 255u / grays, 255u));
+      }
+    }
+    FT_Bitmap_Done(FtLibrary::get(), &converted);
+
+    bitmap_left = glyph->bitmap_left;
+    bitmap_top = glyph->bitmap_top;
   }
 
-  return new FtGlyph(unicode, &glyph->bitmap, m_size, targetsize, m_dropdown,
-      static_cast<float>(glyph->bitmap_left), static_cast<float>(glyph->bitmap_top),
+  return new FtGlyph(unicode, bitmap, pool, size, targetsize, m_dropdown, m_distance_mode, engine,
+      static_cast<float>(bitmap_left), static_cast<float>(bitmap_top),
       static_cast<float>(glyph->advance.x), static_cast<float>(glyph->advance.y));
 }
-
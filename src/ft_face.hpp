@@ -2,13 +2,18 @@
 #define FT_FACE_HPP
 
 #include "defaults.hpp"
+#include "ft_glyph.hpp"
 
 #include <boost/thread.hpp>
 
+#include <map>
+#include <set>
+#include <vector>
+
 #include "ft2build.h"
 #include FT_FREETYPE_H
 
-class FtGlyph;
+class BitmapPool;
 
 /** \brief Class representing one freetype font.
  */
@@ -18,12 +23,36 @@ class FtFace
     /** Font face associated with this. */
     FT_Face m_face;
 
-    /** Size associated with this face. */
+    /** Size associated with this face, largest precalc size. */
     unsigned m_size;
 
+    /** Size the face is currently set to. */
+    unsigned m_current_size;
+
     /** Dropdown distance as percentage of full glyph size. */
     float m_dropdown;
 
+    /** Distance measurement mode of glyphs rendered. */
+    DistanceMode m_distance_mode;
+
+    /** Distance search engine of glyphs rendered. */
+    DistanceEngine m_distance_engine;
+
+    /** Largest change in crunched output values accepted between precalc sizes, negative if not adaptive. */
+    float m_adaptive_tolerance;
+
+    /** Unicode number rendered for every glyph index, other codepoints mapping to the index are not rendered. */
+    std::map<unsigned, unsigned> m_rendered;
+
+    /** Glyph indices already estimated. */
+    std::set<unsigned> m_estimated;
+
+    /** Font file the face was opened from. */
+    std::string m_filename;
+
+    /** Faces opened from the same file at precalc size for measuring on other threads, not currently in use. */
+    std::vector<FT_Face> m_spare_faces;
+
   public:
     /** \brief Default constructor.
      *
@@ -32,14 +61,93 @@ class FtFace
      * \param filename Font file to open.
      * \param psize Precalc render size.
      * \param pdropdown Precalc dissipation scale.
+     * \param pmode Distance measurement mode.
+     * \param pengine Distance search engine.
+     * \param ptolerance Adaptive precalc size tolerance, negative to always render at precalc size.
      */
-    FtFace(const std::string &filename, unsigned psize, float pdropdown);
+    FtFace(const std::string &filename, unsigned psize, float pdropdown, DistanceMode pmode,
+        DistanceEngine pengine, float ptolerance);
 
     /** \brief Destructor.
      */
     ~FtFace();
 
+  private:
+    /** \brief Take a spare face, opening a new one if none is available.
+     *
+     * \return Face at precalc size or NULL on error.
+     */
+    FT_Face acquireFace();
+
+    /** \brief Return a spare face taken with acquireFace().
+     *
+     * \param op Face.
+     */
+    void releaseFace(FT_Face op);
+
+    /** \brief Set the size the face is rendered at.
+     *
+     * \param size Pixel size.
+     * \return True on success, false on error.
+     */
+    bool setCurrentSize(unsigned size);
+
+    /** \brief Render a glyph as a FreeType distance field.
+     *
+     * Distance field is rendered at the precalc size or smaller, whichever allows the spread to cover the
+     * dropdown.
+     *
+     * \param idx Glyph index.
+     * \param unicode Unicode glyph number.
+     * \param targetsize Target size.
+     * \param size Precalc render size.
+     * \param pool Pool to acquire the bitmap buffer from.
+     * \return Glyph object if successful, NULL if FreeType can not render the glyph as a distance field.
+     */
+    FtGlyph* renderSdfGlyph(unsigned idx, unsigned unicode, unsigned targetsize, unsigned size, BitmapPool &pool);
+
   public:
+    /** \brief Estimate the work of crunching a glyph.
+     *
+     * The glyph is only loaded, not rendered. Estimate is the area of the precalc bitmap grown by the search
+     * radius on all sides. Only the first codepoint of a glyph index is estimated, the others will be aliases.
+     *
+     * \param unicode Unicode glyph number.
+     * \return Estimated cost, 0 if not in this face or already estimated.
+     */
+    uint64_t estimateCost(unsigned unicode);
+
+    /** \brief Measure the metrics of a glyph without rendering it.
+     *
+     * Glyph is loaded at precalc size. Metrics are the same a rendered glyph would have.
+     *
+     * May be called concurrently from any thread, glyphs are loaded into spare faces opened from the same file.
+     *
+     * \param unicode Unicode glyph number.
+     * \return Measured glyph if successful, NULL on error.
+     */
+    FtGlyph* measureGlyph(unsigned unicode);
+
+    /** \brief Predict the crunched size of a glyph without rendering it.
+     *
+     * Glyph is loaded unscaled. Crunched size is predicted from the metrics grown by the dropdown on all sides.
+     *
+     * \param unicode Unicode glyph number.
+     * \param targetsize Target size.
+     * \param dropdown Dropdown.
+     * \param slack Samples added to predicted width and height.
+     * \return Planned glyph if successful, NULL on error.
+     */
+    FtGlyph* planGlyph(unsigned unicode, unsigned targetsize, float dropdown, unsigned slack);
+
+    /** \brief Find a glyph already rendered from the same glyph index.
+     *
+     * \param unicode Unicode glyph number.
+     * \param rendered Unicode number of the glyph rendered, set if found.
+     * \return True if found, false if not.
+     */
+    bool findRendered(unsigned unicode, unsigned &rendered);
+
     /** \brief Tell if this has a glyph.
      *
      * \param unicode Unicode glyph number.
@@ -47,13 +155,45 @@ class FtFace
      */
     bool hasGlyph(unsigned unicode);
 
+    /** \brief Remember a glyph has been rendered.
+     *
+     * Only the first unicode number rendered from a glyph index is remembered.
+     *
+     * \param unicode Unicode glyph number.
+     */
+    void markRendered(unsigned unicode);
+
     /** \brief Loads a glyph.
+     *
+     * The precalc bitmap is rendered directly into a buffer acquired from the pool. Acquiring the buffer may
+     * block until enough memory has been released by glyphs in flight.
      *
      * \param unicode Unicode glyph number.
      * \param targetsize
+     * \param size Precalc render size, at most the size of this face.
+     * \param pool Pool to acquire the bitmap buffer from.
      * \return Glyph object if successful, false on error.
      */
-    FtGlyph* renderGlyph(unsigned unicode, unsigned targetsize);
+    FtGlyph* renderGlyph(unsigned unicode, unsigned targetsize, unsigned size, BitmapPool &pool);
+
+  public:
+    /** \brief Get adaptive precalc size tolerance.
+     *
+     * \return Largest change in crunched output values accepted between precalc sizes, negative if not adaptive.
+     */
+    inline float getAdaptiveTolerance() const
+    {
+      return m_adaptive_tolerance;
+    }
+
+    /** \brief Get precalc size.
+     *
+     * \return Largest precalc size.
+     */
+    inline unsigned getSize() const
+    {
+      return m_size;
+    }
 };
 
 /** Convenience typedef. */
@@ -1,130 +1,1269 @@
 #include "ft_glyph.hpp"
 
-#include "ft_library.hpp"
+#include "bitmap_pool.hpp"
+#include "msdf_shape.hpp"
 #include "math/generic.hpp"
+#include "math/scan.hpp"
+#include "thr/parallel_for.hpp"
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <sstream>
 
 /** Use manhattan distance instead of actual distance. */
 #define USE_MANHATTAN 1
 
-/** \brief Distance between two coordinates.
+/** \brief Distance between two coordinates in half pixels.
  *
  * \param x1 First X coordinate.
  * \param y1 First Y coordinate.
  * \param x2 Second X coordinate.
  * \param y2 Second Y coordinate.
- * \return Distance as integer.
+ * \return Distance in half pixels, exact with manhattan distance and rounded otherwise.
  */
-static float fdist(int x1, int y1, int x2, int y2)
+static int idist(int x1, int y1, int x2, int y2)
 {
   int dx = x2 - x1,
       dy = y2 - y1;
 #if defined(USE_MANHATTAN)
-  return static_cast<float>(std::abs(dx) + std::abs(dy));
+  return 2 * (std::abs(dx) + std::abs(dy));
+#else
+  return math::lround(2.0f * sqrtf(static_cast<float>(dx * dx + dy * dy)));
+#endif
+}
+
+/** \brief Length of a vector, measured like idist().
+ *
+ * \param dx X component.
+ * \param dy Y component.
+ * \return Length.
+ */
+static float flength(float dx, float dy)
+{
+#if defined(USE_MANHATTAN)
+  return fabsf(dx) + fabsf(dy);
 #else
-  return sqrtf(static_cast<float>(dx * dx + dy * dy));
+  return sqrtf(dx * dx + dy * dy);
 #endif
 }
 
-/** \brief Return the value at a given location in a freetype glyph.
- *
- * Will return 0 if the point is 'outside' the bitmap.
+/** \brief Return the value at a given location in a freetype glyph.
+ *
+ * Will return 0 if the point is 'outside' the bitmap.
+ *
+ * \param glyph Glyph to examine.
+ * \param px X coordinate.
+ * \param py Y coordinate.
+ * \param size Big size.
+ * \return Value found.
+ */
+static bool get_ftbitmap_value(const FT_Bitmap *bitmap, int px, int py)
+{
+  if((px < 0) || (py < 0))
+  {
+    return 0;
+  }
+
+  unsigned ux = static_cast<unsigned>(px);
+  unsigned uy = static_cast<unsigned>(py);
+
+  if((ux >= bitmap->width) || (uy >= bitmap->rows))
+  {
+    return 0;
+  }
+
+  return (127 < bitmap->buffer[uy * bitmap->width + ux]);
+}
+
+/** \brief Return the value at a given location in glyph runs.
+ *
+ * \param runs Runs to examine.
+ * \param px X coordinate.
+ * \param py Y coordinate.
+ * \return Value found.
+ */
+static bool get_ftbitmap_value(const GlyphRuns *runs, int px, int py)
+{
+  return runs->isSet(px, py);
+}
+
+/** \brief Return the coverage at a given location in a freetype glyph.
+ *
+ * Will return 0 if the point is 'outside' the bitmap.
+ *
+ * \param bitmap Bitmap to examine.
+ * \param px X coordinate.
+ * \param py Y coordinate.
+ * \return Coverage [0, 1].
+ */
+static float get_ftbitmap_coverage(const FT_Bitmap *bitmap, int px, int py)
+{
+  if((px < 0) || (py < 0))
+  {
+    return 0.0f;
+  }
+
+  unsigned ux = static_cast<unsigned>(px);
+  unsigned uy = static_cast<unsigned>(py);
+
+  if((ux >= bitmap->width) || (uy >= bitmap->rows))
+  {
+    return 0.0f;
+  }
+
+  return static_cast<float>(bitmap->buffer[uy * bitmap->width + ux]) * (1.0f / 255.0f);
+}
+
+/** \brief Return the coverage gradient at a given location in a freetype glyph.
+ *
+ * \param bitmap Bitmap to examine.
+ * \param px X coordinate.
+ * \param py Y coordinate.
+ * \param gx Gradient X component.
+ * \param gy Gradient Y component.
+ */
+static void get_ftbitmap_gradient(const FT_Bitmap *bitmap, int px, int py, float &gx, float &gy)
+{
+  const float SQRT2 = 1.4142136f;
+  float ul = get_ftbitmap_coverage(bitmap, px - 1, py - 1);
+  float ur = get_ftbitmap_coverage(bitmap, px + 1, py - 1);
+  float ll = get_ftbitmap_coverage(bitmap, px - 1, py + 1);
+  float lr = get_ftbitmap_coverage(bitmap, px + 1, py + 1);
+
+  gx = ur + lr - ul - ll + SQRT2 * (get_ftbitmap_coverage(bitmap, px + 1, py) -
+      get_ftbitmap_coverage(bitmap, px - 1, py));
+  gy = ll + lr - ul - ur + SQRT2 * (get_ftbitmap_coverage(bitmap, px, py + 1) -
+      get_ftbitmap_coverage(bitmap, px, py - 1));
+}
+
+/** \brief Estimate the distance from the center of a pixel to the edge crossing it.
+ *
+ * The edge is modeled as a straight line perpendicular to the given direction, placed so that the area of the
+ * pixel on the inside matches the coverage (Gustavson & Strand, anti-aliased Euclidean distance transform).
+ *
+ * \param gx Direction X component.
+ * \param gy Direction Y component.
+ * \param coverage Pixel coverage.
+ * \return Distance from pixel center to edge, positive if the center is outside.
+ */
+static float get_edge_offset(float gx, float gy, float coverage)
+{
+  if((0.0f == gx) || (0.0f == gy))
+  {
+    return 0.5f - coverage;
+  }
+
+  float glength = sqrtf(gx * gx + gy * gy);
+  float nx = fabsf(gx) / glength;
+  float ny = fabsf(gy) / glength;
+
+  if(nx < ny)
+  {
+    std::swap(nx, ny);
+  }
+
+  float a1 = 0.5f * ny / nx;
+
+  if(coverage < a1)
+  {
+    return 0.5f * (nx + ny) - sqrtf(2.0f * nx * ny * coverage);
+  }
+  if(coverage < 1.0f - a1)
+  {
+    return (0.5f - coverage) * nx;
+  }
+  return -0.5f * (nx + ny) + sqrtf(2.0f * nx * ny * (1.0f - coverage));
+}
+
+/** \brief Find the first pixel on a bitmap row at or above half coverage, or below it.
+ *
+ * \param row Bitmap row.
+ * \param x0 First X coordinate to examine.
+ * \param x1 X coordinate to stop at.
+ * \param set True to look for a pixel at or above half coverage, false to look for one below it.
+ * \return X coordinate of the first such pixel, x1 if none.
+ */
+static int find_row_pixel_forward(const uint8_t *row, int x0, int x1, bool set)
+{
+  if(x0 >= x1)
+  {
+    return x1;
+  }
+
+  return x0 + static_cast<int>(math::find_msb_forward(row + x0, static_cast<unsigned>(x1 - x0), set));
+}
+
+/** \brief Find the last pixel on a bitmap row at or above half coverage, or below it.
+ *
+ * \param row Bitmap row.
+ * \param x0 Lowest X coordinate to examine.
+ * \param x1 X coordinate to start from, exclusive.
+ * \param set True to look for a pixel at or above half coverage, false to look for one below it.
+ * \return X coordinate of the last such pixel, x0 - 1 if none.
+ */
+static int find_row_pixel_backward(const uint8_t *row, int x0, int x1, bool set)
+{
+  if(x0 >= x1)
+  {
+    return x0 - 1;
+  }
+
+  unsigned count = static_cast<unsigned>(x1 - x0);
+  unsigned ret = math::find_msb_backward(row + x0, count, set);
+
+  return (ret < count) ? (x0 + static_cast<int>(ret)) : (x0 - 1);
+}
+
+/** \brief Find the horizontal distance to the closest pixel of opposite value on a bitmap row.
+ *
+ * Everything outside the bitmap is empty.
+ *
+ * \param bitmap Bitmap to examine.
+ * \param px X coordinate.
+ * \param py Y coordinate of the row.
+ * \param limit Horizontal distance to stop searching at.
+ * \param inside Value of the pixel searched from.
+ * \return Horizontal distance, limit if nothing closer was found.
+ */
+static int get_ftbitmap_row_distance(const FT_Bitmap *bitmap, int px, int py, int limit, bool inside)
+{
+  int width = static_cast<int>(bitmap->width);
+
+  // Pixel searched from is inside the bitmap if it's inside, so is everything outside of the bitmap.
+  if((0 > py) || (static_cast<int>(bitmap->rows) <= py))
+  {
+    return inside ? 0 : limit;
+  }
+
+  const uint8_t *row = bitmap->buffer + py * width;
+  int ret = limit;
+
+  {
+    int x1 = std::min(px + limit, width);
+    int found = find_row_pixel_forward(row, std::max(px, 0), x1, !inside);
+
+    if(found < x1)
+    {
+      ret = std::min(ret, found - px);
+    }
+    else if(inside)
+    {
+      ret = std::min(ret, width - px);
+    }
+  }
+  {
+    int x0 = std::max(px - limit + 1, 0);
+    int found = find_row_pixel_backward(row, x0, std::min(px + 1, width), !inside);
+
+    if(found >= x0)
+    {
+      ret = std::min(ret, px - found);
+    }
+    else if(inside)
+    {
+      ret = std::min(ret, px + 1);
+    }
+  }
+
+  return ret;
+}
+
+/** \brief Find the horizontal distance to the closest pixel of opposite value on a row of glyph runs.
+ *
+ * \param runs Runs to examine.
+ * \param px X coordinate.
+ * \param py Y coordinate of the row.
+ * \param limit Horizontal distance to stop searching at.
+ * \param inside Value of the pixel searched from.
+ * \return Horizontal distance, limit if nothing closer was found.
+ */
+static int get_ftbitmap_row_distance(const GlyphRuns *runs, int px, int py, int limit, bool inside)
+{
+  return runs->getRowDistance(px, py, limit, inside);
+}
+
+/** \brief Return the unscaled distance to the closest edge from a coordinate in half pixels.
+ *
+ * Pixels are thresholded, distance is measured to the far side of the closest pixel of opposite value.
+ *
+ * Rows are visited in order of increasing vertical distance, and searched outwards from the coordinate. Search
+ * ends at the first row that can't be closer than the closest pixel already found.
+ *
+ * Works on both bitmaps and glyph runs.
+ *
+ * \param bitmap Bitmap or runs to examine.
+ * \param px X coordinate.
+ * \param py Y coordinate.
+ * \param search Search radius, distance is clamped to it.
+ * \return Distance in half pixels, positive inside the glyph and negative outside.
+ */
+template <typename T> static int get_ftbitmap_distance(const T *bitmap, int px, int py, int search)
+{
+  int closest = 2 * search;
+  bool inside = get_ftbitmap_value(bitmap, px, py);
+
+  for(int ii = 0; (2 * ii < closest); ++ii)
+  {
+#if defined(USE_MANHATTAN)
+    int limit = closest / 2 - ii;
+#else
+    int limit = (closest + 1) / 2;
+#endif
+
+    for(int jj = ((0 < ii) ? -1 : 1); (jj <= 1); jj += 2)
+    {
+      int row = py + ii * jj;
+      int dx = get_ftbitmap_row_distance(bitmap, px, row, limit, inside);
+
+      if(dx < limit)
+      {
+        closest = std::min(closest, idist(px + dx, row, px, py));
+      }
+    }
+  }
+
+  return inside ? (closest + 1) : -(closest + 1);
+}
+
+/** Edge may be at most half a pixel diagonal closer than the pixel center. */
+static const float MAX_EDGE_OFFSET = 0.71f;
+
+/** \brief Find the first pixel on a bitmap row with coverage other than a given value.
+ *
+ * Runs of the value are skipped eight pixels at a time.
+ *
+ * \param row Bitmap row.
+ * \param x0 First X coordinate to examine.
+ * \param x1 X coordinate to stop at.
+ * \param value Coverage value to skip.
+ * \return X coordinate of the first such pixel, x1 if none.
+ */
+static int find_row_coverage_other(const uint8_t *row, int x0, int x1, uint8_t value)
+{
+  uint64_t run = 0x0101010101010101ull * value;
+
+  for(; (x0 + 8 <= x1); x0 += 8)
+  {
+    uint64_t block;
+
+    memcpy(&block, row + x0, sizeof(block));
+    if(block != run)
+    {
+      break;
+    }
+  }
+  for(; (x0 < x1); ++x0)
+  {
+    if(row[x0] != value)
+    {
+      return x0;
+    }
+  }
+  return x1;
+}
+
+/** \brief Update the closest edge distances from a point with the edge within one pixel.
+ *
+ * \param bitmap Bitmap to examine.
+ * \param px X coordinate of the point.
+ * \param py Y coordinate of the point.
+ * \param ii X coordinate of the pixel.
+ * \param jj Y coordinate of the pixel.
+ * \param closest_outside Closest edge from outside.
+ * \param closest_inside Closest edge from inside.
+ */
+static void update_coverage_distance(const FT_Bitmap *bitmap, float px, float py, int ii, int jj,
+    float &closest_outside, float &closest_inside)
+{
+  float gx = px - static_cast<float>(ii) - 0.5f;
+  float gy = py - static_cast<float>(jj) - 0.5f;
+  float dist = flength(gx, gy);
+  float reach = dist - MAX_EDGE_OFFSET;
+
+  if((reach >= closest_outside) && (reach >= closest_inside))
+  {
+    return;
+  }
+
+  float coverage = get_ftbitmap_coverage(bitmap, ii, jj);
+
+  if((0.0f < coverage) && (reach < closest_outside))
+  {
+    closest_outside = std::min(closest_outside, dist + get_edge_offset(gx, gy, coverage));
+  }
+  if((1.0f > coverage) && (reach < closest_inside))
+  {
+    closest_inside = std::min(closest_inside, dist + get_edge_offset(gx, gy, 1.0f - coverage));
+  }
+}
+
+/** \brief Get the half width of the span of a row within reach of a point.
+ *
+ * \param gy Vertical distance from the point to the row.
+ * \param closest Closest edge found so far.
+ * \return Half width, negative if no pixel on the row is within reach.
+ */
+static float get_coverage_span(float gy, float closest)
+{
+  float reach = closest + MAX_EDGE_OFFSET;
+  float span = reach * reach - gy * gy;
+
+  return (0.0f < span) ? sqrtf(span) : -1.0f;
+}
+
+/** \brief Return the unscaled distance to the closest edge from a point, using coverage.
+ *
+ * Every covered pixel is a candidate for the distance from outside and every pixel not fully covered for the
+ * distance from inside. The edge is located within candidates by their coverage. Within the pixel containing
+ * the point, the edge is oriented along the coverage gradient.
+ *
+ * Rows are visited in order of increasing vertical distance and only the span still within reach of the closest
+ * edges found is examined. Search ends at the first rows out of reach on both sides. Runs of pixels that can't be
+ * candidates are skipped.
+ *
+ * \param bitmap Bitmap to examine.
+ * \param px X coordinate, pixel edges are at integer coordinates.
+ * \param py Y coordinate, pixel edges are at integer coordinates.
+ * \param search Search radius, distance is clamped to it.
+ * \return Distance, positive inside the glyph and negative outside.
+ */
+static float get_ftbitmap_coverage_distance(const FT_Bitmap *bitmap, float px, float py, int search)
+{
+  int width = static_cast<int>(bitmap->width);
+  int rows = static_cast<int>(bitmap->rows);
+  int cx = math::floor(px);
+  int cy = math::floor(py);
+  float closest_outside = static_cast<float>(search);
+  float closest_inside = static_cast<float>(search);
+  bool oriented = false;
+
+  {
+    float coverage = get_ftbitmap_coverage(bitmap, cx, cy);
+
+    if((0.0f < coverage) && (1.0f > coverage))
+    {
+      float gx;
+      float gy;
+
+      get_ftbitmap_gradient(bitmap, cx, cy, gx, gy);
+
+      if((0.0f != gx) || (0.0f != gy))
+      {
+        float glength = sqrtf(gx * gx + gy * gy);
+        float edge = get_edge_offset(gx, gy, coverage) -
+          (gx * (px - static_cast<float>(cx) - 0.5f) + gy * (py - static_cast<float>(cy) - 0.5f)) / glength;
+
+        closest_outside = std::max(edge, 0.0f);
+        closest_inside = std::max(-edge, 0.0f);
+        oriented = true;
+      }
+    }
+  }
+
+  for(int ii = 0; (ii <= search + 1); ++ii)
+  {
+    bool reached = false;
+
+    for(int jj = ((0 < ii) ? -1 : 1); (jj <= 1); jj += 2)
+    {
+      int row = cy + ii * jj;
+      float gy = py - static_cast<float>(row) - 0.5f;
+      float span_outside = get_coverage_span(gy, closest_outside);
+      float span_inside = get_coverage_span(gy, closest_inside);
+
+      if((0.0f > span_outside) && (0.0f > span_inside))
+      {
+        continue;
+      }
+      reached = true;
+
+      // Pixels are examined one more than the span reaches on both sides, the exact test is done per pixel.
+      float center = px - 0.5f;
+      int outside_x1 = std::max(math::floor(center - span_outside), cx - search - 1);
+      int outside_x2 = std::min(math::ceil(center + span_outside), cx + search + 1);
+      int inside_x1 = std::max(math::floor(center - span_inside), cx - search - 1);
+      int inside_x2 = std::min(math::ceil(center + span_inside), cx + search + 1);
+      bool in_bitmap = (0 <= row) && (rows > row);
+
+      // Only pixels with some coverage may be closer from outside, they are all in the bitmap.
+      if(in_bitmap && (0.0f <= span_outside))
+      {
+        const uint8_t *data = bitmap->buffer + row * width;
+        int x1 = std::max(outside_x1, 0);
+        int x2 = std::min(outside_x2 + 1, width);
+
+        for(int kk = find_row_coverage_other(data, x1, x2, 0); (kk < x2);
+            kk = find_row_coverage_other(data, kk + 1, x2, 0))
+        {
+          if(!oriented || (kk != cx) || (row != cy))
+          {
+            update_coverage_distance(bitmap, px, py, kk, row, closest_outside, closest_inside);
+          }
+        }
+      }
+
+      // Only pixels not fully covered may be closer from inside, everything outside the bitmap is empty.
+      if(0.0f <= span_inside)
+      {
+        const uint8_t *data = in_bitmap ? (bitmap->buffer + row * width) : NULL;
+
+        for(int kk = inside_x1; (kk <= inside_x2); ++kk)
+        {
+          if(in_bitmap && (0 <= kk) && (width > kk))
+          {
+            kk = find_row_coverage_other(data, kk, std::min(inside_x2 + 1, width), 255);
+            if(kk > inside_x2)
+            {
+              break;
+            }
+          }
+
+          if(!oriented || (kk != cx) || (row != cy))
+          {
+            update_coverage_distance(bitmap, px, py, kk, row, closest_outside, closest_inside);
+          }
+        }
+      }
+    }
+
+    if(!reached)
+    {
+      break;
+    }
+  }
+
+  return std::max(closest_inside, 0.0f) - std::max(closest_outside, 0.0f);
+}
+
+/** \brief Get the distance to the edge from a FreeType distance field bitmap.
+ *
+ * Distance field values are at pixel centers and interpolated bilinearly. Everything outside the bitmap is
+ * saturated outside.
+ *
+ * \param bitmap Distance field bitmap.
+ * \param px X coordinate, pixel edges are at integer coordinates.
+ * \param py Y coordinate, pixel edges are at integer coordinates.
+ * \param spread Spread of the distance field in pixels.
+ * \return Distance, positive inside the glyph and negative outside.
+ */
+static float get_ftbitmap_sdf_distance(const FT_Bitmap *bitmap, float px, float py, unsigned spread)
+{
+  float fx = px - 0.5f;
+  float fy = py - 0.5f;
+  int x0 = math::floor(fx);
+  int y0 = math::floor(fy);
+  float wx = fx - static_cast<float>(x0);
+  float wy = fy - static_cast<float>(y0);
+  float top = (1.0f - wx) * get_ftbitmap_coverage(bitmap, x0, y0) + wx * get_ftbitmap_coverage(bitmap, x0 + 1, y0);
+  float bottom = (1.0f - wx) * get_ftbitmap_coverage(bitmap, x0, y0 + 1) +
+    wx * get_ftbitmap_coverage(bitmap, x0 + 1, y0 + 1);
+
+  // Value 128 of 255 is at the edge, 0 and 255 at the spread.
+  return ((1.0f - wy) * top + wy * bottom - (128.0f / 255.0f)) * (255.0f / 128.0f) * static_cast<float>(spread);
+}
+
+/** \brief Quantize an unscaled distance into a distance field value.
+ *
+ * Distances clamped to a search radius larger than dropdown produce the same value as unclamped ones, since
+ * both saturate.
+ *
+ * \param distance Distance to the edge, positive inside.
+ * \param dist_scale Scale for distances in bitmap.
+ * \return Depth field value.
+ */
+static uint8_t quantize_distance(float distance, float dist_scale)
+{
+  float ret = std::min(std::max(0.5f + distance * dist_scale, 0.0f), 1.0f);
+
+  return static_cast<uint8_t>(math::lround(ret * 255.0f));
+}
+
+/** \brief Quantize a rectangle of unscaled distances into distance field values.
+ *
+ * Distances in half pixels are quantized through a table built with quantize_distance(), so they produce the same
+ * values as they would as floats.
+ *
+ * \param dst Destination.
+ * \param distances Distances, empty if given in half pixels.
+ * \param half_distances Distances in half pixels, empty if given as floats.
+ * \param dist_scale Scale for distances in bitmap.
+ * \param search Search radius distances were clamped to.
+ */
+static void quantize_distances(uint8_t *dst, const std::vector<float> &distances,
+    const std::vector<int> &half_distances, float dist_scale, int search)
+{
+  for(unsigned ii = 0; (ii < distances.size()); ++ii)
+  {
+    dst[ii] = quantize_distance(distances[ii], dist_scale);
+  }
+
+  if(!half_distances.empty())
+  {
+    int offset = 2 * search + 1;
+    std::vector<uint8_t> table(static_cast<unsigned>(2 * offset + 1));
+
+    for(int ii = -offset; (ii <= offset); ++ii)
+    {
+      table[static_cast<unsigned>(ii + offset)] = quantize_distance(0.5f * static_cast<float>(ii), dist_scale);
+    }
+
+    const uint8_t *center = &(table[static_cast<unsigned>(offset)]);
+    const int *src = &(half_distances[0]);
+    for(unsigned ii = 0, ee = static_cast<unsigned>(half_distances.size()); (ii < ee); ++ii)
+    {
+      dst[ii] = center[src[ii]];
+    }
+  }
+}
+
+/** \brief Find the bounds of the pixels above a coverage threshold in a freetype bitmap.
+ *
+ * \param bitmap Bitmap to examine.
+ * \param threshold Coverage threshold.
+ * \param x1 Leftmost set column.
+ * \param y1 Topmost set row.
+ * \param x2 Rightmost set column.
+ * \param y2 Bottommost set row.
+ * \return True if any pixel was set, false otherwise.
+ */
+static bool get_ftbitmap_bounds(const FT_Bitmap *bitmap, uint8_t threshold, int &x1, int &y1, int &x2, int &y2)
+{
+  int width = static_cast<int>(bitmap->width);
+  int rows = static_cast<int>(bitmap->rows);
+
+  x1 = width;
+  y1 = rows;
+  x2 = -1;
+  y2 = -1;
+
+  for(int jj = 0; (jj < rows); ++jj)
+  {
+    for(int ii = 0; (ii < width); ++ii)
+    {
+      if(threshold < bitmap->buffer[jj * width + ii])
+      {
+        x1 = std::min(x1, ii);
+        y1 = std::min(y1, jj);
+        x2 = std::max(x2, ii);
+        y2 = std::max(y2, jj);
+      }
+    }
+  }
+
+  return (0 <= x2);
+}
+
+/** \brief Get the bitmap coordinate of a crunched bitmap sample.
+ *
+ * Sample positions are exact fractions of the precalc size, rounded half away from zero.
+ *
+ * \param op Sample index relative to the sample at bitmap origin.
+ * \param origin Bitmap coordinate of the sample at bitmap origin.
+ * \param size Precalc size.
+ * \param target Target size.
+ * \return Bitmap coordinate.
+ */
+static int get_sample_coordinate(int op, int origin, unsigned size, unsigned target)
+{
+  uint64_t scaled = static_cast<uint64_t>(std::abs(op)) * size * 2 + target;
+  int ret = static_cast<int>(scaled / (static_cast<uint64_t>(target) * 2));
+
+  return ((0 > op) ? -ret : ret) + origin;
+}
+
+/** \brief Find the first crunched bitmap sample past a bitmap coordinate.
+ *
+ * \param limit Bitmap coordinate.
+ * \param origin Bitmap coordinate of the sample at bitmap origin.
+ * \param size Precalc size.
+ * \param target Target size.
+ * \return Lowest sample index relative to the sample at bitmap origin with coordinate greater than limit.
+ */
+static int get_first_sample_above(int limit, int origin, unsigned size, unsigned target)
+{
+  int ret = static_cast<int>(static_cast<int64_t>(limit - origin) * static_cast<int64_t>(target) /
+      static_cast<int64_t>(size));
+
+  while(get_sample_coordinate(ret, origin, size, target) > limit)
+  {
+    --ret;
+  }
+  while(get_sample_coordinate(ret, origin, size, target) <= limit)
+  {
+    ++ret;
+  }
+
+  return ret;
+}
+
+/** \brief Boundary pixels of a thresholded bitmap bucketed into a uniform grid.
+ *
+ * The closest pixel of opposite value to any coordinate is always next to a pixel of the same value, so only
+ * pixels next to a pixel of opposite value need to be searched. Empty pixels just outside the bitmap are
+ * included. Cells are a fraction of the search radius, so cells close to a coordinate can be searched first.
+ */
+class EdgeGrid
+{
+  public:
+    /** Number of cells across the search radius. */
+    static const int CELLS_PER_SEARCH = 4;
+
+    /** Minimum cell size, smaller cells cost more to visit than they save. */
+    static const int MIN_CELL_SIZE = 8;
+
+  private:
+    /** Cell size. */
+    int m_cell;
+
+    /** Bitmap X coordinate of the left edge of the grid. */
+    int m_x0;
+
+    /** Bitmap Y coordinate of the top edge of the grid. */
+    int m_y0;
+
+    /** Grid width in cells. */
+    int m_cells_w;
+
+    /** Grid height in cells. */
+    int m_cells_h;
+
+    /** Index of the first boundary pixel of every cell and one past the last cell, empty and set pixels. */
+    std::vector<unsigned> m_first[2];
+
+    /** Interleaved X and Y coordinates of boundary pixels in cell order, empty and set pixels. */
+    std::vector<int> m_coords[2];
+
+  public:
+    /** \brief Constructor.
+     *
+     * \param bitmap Bitmap to examine.
+     * \param x1 Leftmost set column.
+     * \param y1 Topmost set row.
+     * \param x2 Rightmost set column.
+     * \param y2 Bottommost set row.
+     * \param search Search radius.
+     */
+    EdgeGrid(const FT_Bitmap *bitmap, int x1, int y1, int x2, int y2, int search) :
+      m_cell((search / CELLS_PER_SEARCH > MIN_CELL_SIZE) ? (search / CELLS_PER_SEARCH) : MIN_CELL_SIZE),
+      m_x0(x1 - 1),
+      m_y0(y1 - 1),
+      m_cells_w((x2 - x1 + 2) / m_cell + 1),
+      m_cells_h((y2 - y1 + 2) / m_cell + 1)
+    {
+      unsigned cell_count = static_cast<unsigned>(m_cells_w * m_cells_h);
+      std::vector<unsigned> cells[2];
+
+      // Everything outside the set area but next to it is empty, so the area extended by one pixel covers every
+      // boundary pixel. It's thresholded with one more pixel of padding to compare against.
+      int area_w = x2 - x1 + 5;
+      int area_h = y2 - y1 + 5;
+      std::vector<uint8_t> area(static_cast<unsigned>(area_w * area_h), 0);
+      std::vector<uint8_t> boundary(static_cast<unsigned>(area_w), 0);
+      for(int jj = y1; (jj <= y2); ++jj)
+      {
+        const uint8_t *src = bitmap->buffer + jj * static_cast<int>(bitmap->width);
+        uint8_t *dst = &(area[static_cast<unsigned>((jj - y1 + 2) * area_w + 2)]);
+
+        for(int ii = x1; (ii <= x2); ++ii)
+        {
+          dst[ii - x1] = (127 < src[ii]) ? 1 : 0;
+        }
+      }
+
+      for(int jj = 1; (jj < area_h - 1); ++jj)
+      {
+        const uint8_t *row = &(area[static_cast<unsigned>(jj * area_w)]);
+        const uint8_t *above = row - area_w;
+        const uint8_t *below = row + area_w;
+
+        // Top bit marks pixels with a neighbor of opposite value.
+        for(int ii = 1; (ii < area_w - 1); ++ii)
+        {
+          uint8_t value = row[ii];
+
+          boundary[static_cast<unsigned>(ii)] = static_cast<uint8_t>(((value ^ row[ii - 1]) | (value ^ row[ii + 1]) |
+                (value ^ above[ii]) | (value ^ below[ii])) << 7);
+        }
+
+        int py = y1 - 2 + jj;
+        unsigned count = static_cast<unsigned>(area_w);
+        for(unsigned ii = math::find_msb_forward(&(boundary[0]), count, true); (ii < count);
+            ii += 1 + math::find_msb_forward(&(boundary[ii + 1]), count - ii - 1, true))
+        {
+          int px = x1 - 2 + static_cast<int>(ii);
+          unsigned type = row[ii];
+
+          cells[type].push_back(static_cast<unsigned>(((py - m_y0) / m_cell) * m_cells_w + (px - m_x0) / m_cell));
+          m_coords[type].push_back(px);
+          m_coords[type].push_back(py);
+        }
+      }
+
+      // Counting sort into cells.
+      for(unsigned ii = 0; (ii < 2); ++ii)
+      {
+        std::vector<unsigned> &first = m_first[ii];
+        std::vector<int> coords(m_coords[ii].size());
+
+        first.assign(cell_count + 1, 0);
+        BOOST_FOREACH(unsigned vv, cells[ii])
+        {
+          ++first[vv + 1];
+        }
+        for(unsigned jj = 0; (jj < cell_count); ++jj)
+        {
+          first[jj + 1] += first[jj];
+        }
+
+        std::vector<unsigned> next(first.begin(), first.end() - 1);
+        for(unsigned jj = 0; (jj < cells[ii].size()); ++jj)
+        {
+          unsigned dst = next[cells[ii][jj]]++;
+
+          coords[dst * 2] = m_coords[ii][jj * 2];
+          coords[dst * 2 + 1] = m_coords[ii][jj * 2 + 1];
+        }
+        m_coords[ii].swap(coords);
+      }
+    }
+
+  private:
+    /** \brief Get the cell containing a coordinate.
+     *
+     * \param op Bitmap coordinate.
+     * \param origin Bitmap coordinate of the grid edge.
+     * \return Cell index, may be outside the grid.
+     */
+    int getCell(int op, int origin) const
+    {
+      int offset = op - origin;
+
+      // Floor division, coordinates may be on either side of the grid.
+      return ((0 > offset) ? (offset - m_cell + 1) : offset) / m_cell;
+    }
+
+    /** \brief Search boundary pixels of one cell.
+     *
+     * \param type Boundary pixel type.
+     * \param cx Cell X index.
+     * \param cy Cell Y index.
+     * \param px X coordinate.
+     * \param py Y coordinate.
+     * \param closest Closest distance found so far in half pixels, updated.
+     */
+    void searchCell(unsigned type, int cx, int cy, int px, int py, int &closest) const
+    {
+      if((0 > cx) || (m_cells_w <= cx) || (0 > cy) || (m_cells_h <= cy))
+      {
+        return;
+      }
+
+      int left = m_x0 + cx * m_cell;
+      int top = m_y0 + cy * m_cell;
+      int dx = std::max(std::max(left - px, px - (left + m_cell - 1)), 0);
+      int dy = std::max(std::max(top - py, py - (top + m_cell - 1)), 0);
+
+      // Skip cells that can't have anything closer.
+      if(idist(0, 0, dx, dy) >= closest)
+      {
+        return;
+      }
+
+      unsigned cell = static_cast<unsigned>(cy * m_cells_w + cx);
+      const int *coords = &(m_coords[type][0]);
+      for(unsigned ii = m_first[type][cell], ee = m_first[type][cell + 1]; (ii < ee); ++ii)
+      {
+        closest = std::min(closest, idist(coords[ii * 2], coords[ii * 2 + 1], px, py));
+      }
+    }
+
+  public:
+    /** \brief Return the unscaled distance to the closest edge from a coordinate in half pixels.
+     *
+     * Cells are searched in rings around the cell of the coordinate until no ring can have anything closer.
+     * Equal to get_ftbitmap_distance().
+     *
+     * \param bitmap Bitmap the grid was built from.
+     * \param px X coordinate.
+     * \param py Y coordinate.
+     * \param search Search radius, distance is clamped to it.
+     * \return Distance in half pixels, positive inside the glyph and negative outside.
+     */
+    int getDistance(const FT_Bitmap *bitmap, int px, int py, int search) const
+    {
+      int closest = 2 * search;
+      bool inside = get_ftbitmap_value(bitmap, px, py);
+      unsigned type = inside ? 0u : 1u;
+
+      if(!m_coords[type].empty())
+      {
+        int cx = getCell(px, m_x0);
+        int cy = getCell(py, m_y0);
+
+        this->searchCell(type, cx, cy, px, py, closest);
+
+        // Everything on ring ii is at least the width of the rings inside it away.
+        for(int ii = 1; (idist(0, 0, (ii - 1) * m_cell + 1, 0) < closest); ++ii)
+        {
+          for(int jj = -ii; (jj <= ii); ++jj)
+          {
+            this->searchCell(type, cx + jj, cy - ii, px, py, closest);
+            this->searchCell(type, cx + jj, cy + ii, px, py, closest);
+          }
+          for(int jj = 1 - ii; (jj < ii); ++jj)
+          {
+            this->searchCell(type, cx - ii, cy + jj, px, py, closest);
+            this->searchCell(type, cx + ii, cy + jj, px, py, closest);
+          }
+        }
+      }
+
+      return inside ? (closest + 1) : -(closest + 1);
+    }
+};
+
+/** \brief Return a crunched output value.
+ *
+ * \param crunched Crunched data, may be NULL if there is no crunched area.
+ * \param width Crunched width.
+ * \param height Crunched height.
+ * \param channels Number of channels.
+ * \param channel Channel.
+ * \param px X coordinate.
+ * \param py Y coordinate.
+ * \return Value, 0 outside the crunched area.
+ */
+static int get_crunched_value(const uint8_t *crunched, unsigned width, unsigned height, unsigned channels,
+    unsigned channel, int px, int py)
+{
+  if((0 > px) || (0 > py) || (static_cast<int>(width) <= px) || (static_cast<int>(height) <= py))
+  {
+    return 0;
+  }
+
+  return static_cast<int>(crunched[(static_cast<unsigned>(py) * width + static_cast<unsigned>(px)) * channels +
+      channel]);
+}
+
+/** \brief Samples unscaled distances over a rectangle of the crunched bitmap.
+ *
+ * Rows are independent of each other, so they may be computed in any order by any thread.
+ */
+class RectSampler
+{
+  private:
+    /** Bitmap to examine. */
+    const FT_Bitmap *m_bitmap;
+
+    /** Distance output, one per sample for coverage mode or one per channel for multi-channel mode. */
+    float *m_dst;
+
+    /** Distance output in half pixels, one per sample, for binary mode. */
+    int *m_half_dst;
+
+    /** Bitmap X coordinate of every column. */
+    const int *m_coord_x;
+
+    /** Bitmap Y coordinate of every row. */
+    const int *m_coord_y;
+
+    /** Exact bitmap X coordinate of every column, for coverage mode. */
+    const float *m_exact_x;
+
+    /** Exact bitmap Y coordinate of every row, for coverage mode. */
+    const float *m_exact_y;
+
+    /** Number of columns. */
+    unsigned m_width;
+
+    /** Number of columns in the distance output. */
+    unsigned m_stride;
+
+    /** Search radius. */
+    int m_search;
+
+    /** Distance measurement mode. */
+    DistanceMode m_mode;
+
+    /** Boundary pixel grid to search in binary mode, NULL to scan the bitmap. */
+    const EdgeGrid *m_grid;
+
+    /** Runs to search in binary mode instead of the bitmap, NULL to use the bitmap. */
+    const GlyphRuns *m_runs;
+
+    /** Outline to measure every channel from, NULL to use the bitmap. */
+    const MsdfShape *m_shape;
+
+    /** Spread of the FreeType distance field in the bitmap, 0 if the bitmap holds coverage. */
+    unsigned m_spread;
+
+  public:
+    /** \brief Constructor.
+     *
+     * \param pbitmap Bitmap to examine.
+     * \param pdst Distance output, for coverage mode.
+     * \param phalf_dst Distance output in half pixels, for binary mode.
+     * \param pcoord_x Bitmap X coordinate of every column.
+     * \param pcoord_y Bitmap Y coordinate of every row.
+     * \param pexact_x Exact bitmap X coordinate of every column.
+     * \param pexact_y Exact bitmap Y coordinate of every row.
+     * \param pwidth Number of columns.
+     * \param pstride Number of columns in the distance output.
+     * \param psearch Search radius.
+     * \param pmode Distance measurement mode.
+     * \param pgrid Boundary pixel grid or NULL.
+     * \param pruns Runs or NULL.
+     * \param pshape Outline or NULL.
+     * \param pspread Distance field spread or 0.
+     */
+    RectSampler(const FT_Bitmap *pbitmap, float *pdst, int *phalf_dst, const int *pcoord_x,
+        const int *pcoord_y, const float *pexact_x, const float *pexact_y, unsigned pwidth, unsigned pstride,
+        int psearch, DistanceMode pmode, const EdgeGrid *pgrid, const GlyphRuns *pruns, const MsdfShape *pshape,
+        unsigned pspread) :
+      m_bitmap(pbitmap),
+      m_dst(pdst),
+      m_half_dst(phalf_dst),
+      m_coord_x(pcoord_x),
+      m_coord_y(pcoord_y),
+      m_exact_x(pexact_x),
+      m_exact_y(pexact_y),
+      m_width(pwidth),
+      m_stride(pstride),
+      m_search(psearch),
+      m_mode(pmode),
+      m_grid(pgrid),
+      m_runs(pruns),
+      m_shape(pshape),
+      m_spread(pspread) { }
+
+  public:
+    /** \brief Sample one row.
+     *
+     * \param op Row index.
+     */
+    void operator()(unsigned op) const
+    {
+      if(NULL != m_shape)
+      {
+        float *dst = m_dst + op * m_stride * MsdfShape::CHANNELS;
+        float py = m_exact_y[op];
+
+        for(unsigned ii = 0; (ii < m_width); ++ii)
+        {
+          m_shape->getDistance(m_exact_x[ii], py, dst + ii * MsdfShape::CHANNELS);
+        }
+        return;
+      }
+
+      if(0 < m_spread)
+      {
+        float *dst = m_dst + op * m_stride;
+        float py = m_exact_y[op];
+
+        for(unsigned ii = 0; (ii < m_width); ++ii)
+        {
+          dst[ii] = get_ftbitmap_sdf_distance(m_bitmap, m_exact_x[ii], py, m_spread);
+        }
+        return;
+      }
+
+      if(DISTANCE_BINARY != m_mode)
+      {
+        float *dst = m_dst + op * m_stride;
+        float py = m_exact_y[op];
+
+        for(unsigned ii = 0; (ii < m_width); ++ii)
+        {
+          dst[ii] = get_ftbitmap_coverage_distance(m_bitmap, m_exact_x[ii], py, m_search);
+        }
+        return;
+      }
+
+      int *dst = m_half_dst + op * m_stride;
+      int py = m_coord_y[op];
+
+      if(NULL != m_grid)
+      {
+        for(unsigned ii = 0; (ii < m_width); ++ii)
+        {
+          dst[ii] = m_grid->getDistance(m_bitmap, m_coord_x[ii], py, m_search);
+        }
+        return;
+      }
+
+      if(NULL != m_runs)
+      {
+        for(unsigned ii = 0; (ii < m_width); ++ii)
+        {
+          dst[ii] = get_ftbitmap_distance(m_runs, m_coord_x[ii], py, m_search);
+        }
+        return;
+      }
+
+      for(unsigned ii = 0; (ii < m_width); ++ii)
+      {
+        dst[ii] = get_ftbitmap_distance(m_bitmap, m_coord_x[ii], py, m_search);
+      }
+    }
+};
+
+/** \brief Sample a rectangle of distances.
  *
- * \param glyph Glyph to examine.
- * \param px X coordinate.
- * \param py Y coordinate.
- * \param size Big size.
- * \return Value found.
+ * \param sampler Rectangle sampler.
+ * \param rows Number of rows.
+ * \param parallel Spread the rows over worker threads.
  */
-static bool get_ftbitmap_value(const FT_Bitmap *bitmap, int px, int py)
+static void sample_rect(const RectSampler &sampler, unsigned rows, bool parallel)
 {
-  if((px < 0) || (py < 0))
+  if(parallel)
   {
-    return 0;
+    thr::parallel_for(rows, sampler);
+    return;
   }
 
-  unsigned ux = static_cast<unsigned>(px);
-  unsigned uy = static_cast<unsigned>(py);
-
-  if((ux >= bitmap->width) || (uy >= bitmap->rows))
+  for(unsigned ii = 0; (ii < rows); ++ii)
   {
-    return 0;
+    sampler(ii);
   }
-
-  return (127 < bitmap->buffer[uy * bitmap->width + ux]);
 }
 
-/** \brief Return the distance field value of a coordinate.
+/** \brief Sample a rectangle of distances from tiles of the precalc bitmap rendered one at a time.
  *
- * Ineffective. Don't care.
+ * Every tile covers the pixels of a block of samples and everything within the search radius of them, so the
+ * distances are exactly those sampled from the whole bitmap. Tiles start at non-negative bitmap coordinates,
+ * translating exact coordinates into them is then exact as well.
  *
- * \param glyph Glyph to examine.
- * \param px X coordinate.
- * \param py Y coordinate.
- * \param dist_scale Scale for distances in bitmap.
- * \return Depth field value.
+ * \param tiles Outline to render tiles from.
+ * \param dst Distance output, for coverage mode.
+ * \param half_dst Distance output in half pixels, for binary mode.
+ * \param coord_x Bitmap X coordinate of every column.
+ * \param coord_y Bitmap Y coordinate of every row.
+ * \param exact_x Exact bitmap X coordinate of every column.
+ * \param exact_y Exact bitmap Y coordinate of every row.
+ * \param block Number of samples per tile on either axis.
+ * \param search Search radius.
+ * \param mode Distance measurement mode.
+ * \param engine Distance search engine.
+ * \param parallel Spread the rows of every tile over worker threads.
+ * \return True on success, false if a tile could not be rendered.
  */
-static uint8_t get_ftbitmap_dfield_value(const FT_Bitmap *bitmap, int px, int py, int search, float dist_scale)
+static bool sample_tiles(const GlyphTiles &tiles, float *dst, int *half_dst, const std::vector<int> &coord_x,
+    const std::vector<int> &coord_y, const std::vector<float> &exact_x, const std::vector<float> &exact_y,
+    unsigned block, int search, DistanceMode mode, DistanceEngine engine, bool parallel)
 {
-  float closest = FLT_MAX;
-  float ret;
-
-  if(get_ftbitmap_value(bitmap, px, py))
+  unsigned width = static_cast<unsigned>(coord_x.size());
+  unsigned height = static_cast<unsigned>(coord_y.size());
+  bool coverage = (DISTANCE_BINARY != mode);
+  // Coverage gradients and edge offsets reach past the search radius by less than two pixels.
+  int halo = search + 3;
+  // Tiles are allocated by the crunching worker itself, not from the bitmap pool. Blocking on the pool here could
+  // wait on buffers held by glyphs queued behind this one.
+  std::vector<uint8_t> buffer;
+
+  for(unsigned y0 = 0; (y0 < height); y0 += block)
   {
-    for(int ii = px - search; (ii <= px + search); ++ii)
+    unsigned rows = std::min(block, height - y0);
+
+    for(unsigned x0 = 0; (x0 < width); x0 += block)
     {
-      for(int jj = py - search; (jj <= py + search); ++jj)
+      unsigned columns = std::min(block, width - x0);
+      unsigned offset = y0 * width + x0;
+      // Everything outside the size is empty, tiles are clipped to it.
+      int tile_x1 = std::max((coverage ? math::floor(exact_x[x0]) : coord_x[x0]) - halo, 0);
+      int tile_y1 = std::max((coverage ? math::floor(exact_y[y0]) : coord_y[y0]) - halo, 0);
+      int tile_x2 = std::min((coverage ? math::floor(exact_x[x0 + columns - 1]) : coord_x[x0 + columns - 1]) +
+          halo, static_cast<int>(tiles.getWidth()) - 1);
+      int tile_y2 = std::min((coverage ? math::floor(exact_y[y0 + rows - 1]) : coord_y[y0 + rows - 1]) + halo,
+          static_cast<int>(tiles.getRows()) - 1);
+      FT_Bitmap tile;
+
+      FT_Bitmap_New(&tile);
+      tile.num_grays = 256;
+      tile.pixel_mode = FT_PIXEL_MODE_GRAY;
+      tile.width = static_cast<unsigned>(std::max(tile_x2 - tile_x1 + 1, 1));
+      tile.rows = static_cast<unsigned>(std::max(tile_y2 - tile_y1 + 1, 1));
+      tile.pitch = static_cast<int>(tile.width);
+      buffer.assign(tile.width * tile.rows, 0);
+      tile.buffer = &(buffer[0]);
+
+      if(!tiles.render(&tile, tile_x1, tile_y1))
       {
-        float dist = fdist(ii, jj, px, py);
-        if(dist < closest)
-        {
-          if(!get_ftbitmap_value(bitmap, ii, jj))
-          {
-            closest = dist;
-          }
-        }
+        //std::cerr << "could not render tile at " << tile_x1 << ", " << tile_y1 << std::endl;
+        return false;
       }
-    }
-    ret = std::min(0.5f + (closest + 0.5f) * dist_scale, 1.0f);
-  }
-  else
-  {
-    for(int ii = px - search; (ii <= px + search); ++ii)
-    {
-      for(int jj = py - search; (jj <= py + search); ++jj)
+
+      std::vector<int> tile_coord_x(columns);
+      std::vector<int> tile_coord_y(rows);
+      std::vector<float> tile_exact_x(columns);
+      std::vector<float> tile_exact_y(rows);
+      for(unsigned ii = 0; (ii < columns); ++ii)
+      {
+        tile_coord_x[ii] = coord_x[x0 + ii] - tile_x1;
+        tile_exact_x[ii] = exact_x[x0 + ii] - static_cast<float>(tile_x1);
+      }
+      for(unsigned ii = 0; (ii < rows); ++ii)
+      {
+        tile_coord_y[ii] = coord_y[y0 + ii] - tile_y1;
+        tile_exact_y[ii] = exact_y[y0 + ii] - static_cast<float>(tile_y1);
+      }
+
+      boost::scoped_ptr<EdgeGrid> grid;
+      if(!coverage)
       {
-        float dist = fdist(ii, jj, px, py);
-        if(dist < closest)
+        int ink_x1;
+        int ink_y1;
+        int ink_x2;
+        int ink_y2;
+
+        // Nothing set within the search radius of any sample, distances saturate outside.
+        if(!get_ftbitmap_bounds(&tile, 127, ink_x1, ink_y1, ink_x2, ink_y2))
         {
-          if(get_ftbitmap_value(bitmap, ii, jj))
+          for(unsigned jj = 0; (jj < rows); ++jj)
           {
-            closest = dist;
+            int *row = half_dst + offset + jj * width;
+
+            std::fill(row, row + columns, -(2 * search + 1));
           }
+          continue;
+        }
+
+        if(ENGINE_GRID == engine)
+        {
+          grid.reset(new EdgeGrid(&tile, ink_x1, ink_y1, ink_x2, ink_y2, search));
         }
       }
+
+      sample_rect(RectSampler(&tile, coverage ? (dst + offset) : NULL, coverage ? NULL : (half_dst + offset),
+            &(tile_coord_x[0]), &(tile_coord_y[0]), &(tile_exact_x[0]), &(tile_exact_y[0]), columns, width,
+            search, mode, grid.get(), NULL, NULL, 0), rows, parallel);
     }
-    ret = std::max(0.5f - (closest + 0.5f) * dist_scale, 0.0f);
   }
 
-  return static_cast<uint8_t>(math::lround(ret * 255.0f));
+  return true;
 }
 
-FtGlyph::FtGlyph(unsigned pcode, FT_Bitmap *bitmap, unsigned psize, unsigned ptarget, float pdropdown,
-    float pleft, float ptop, float pax, float pay) :
+FtGlyph::FtGlyph(unsigned pcode, unsigned psize, unsigned ptarget, float pdropdown, DistanceMode pmode,
+    DistanceEngine pengine, float pwidth, float pheight, float pleft, float ptop, float pax, float pay) :
   m_unicode(pcode),
   m_crunched(NULL),
   m_size(psize),
   m_target_size(ptarget),
   m_dropdown(pdropdown),
-  m_width(static_cast<float>(bitmap->width)),
-  m_height(static_cast<float>(bitmap->rows)),
+  m_distance_mode(pmode),
+  m_distance_engine(pengine),
+  m_origin_aligned(false),
+  m_spread(0),
+  m_width(pwidth),
+  m_height(pheight),
   m_left(pleft),
   m_top(ptop),
   m_advance_x(pax),
   m_advance_y(pay),
-  m_bitmap_w(ptarget * 2 + 1),
-  m_bitmap_h(ptarget * 2 + 1),
+  m_bitmap_w(0),
+  m_bitmap_h(0),
+  m_sample_x(0),
+  m_sample_y(0),
   m_x1(0.0f),
   m_y1(0.0f),
   m_x2(0.0f),
@@ -132,174 +1271,135 @@ FtGlyph::FtGlyph(unsigned pcode, FT_Bitmap *bitmap, unsigned psize, unsigned pta
   m_s1(0.0f),
   m_t1(0.0f),
   m_s2(0.0f),
-  m_t2(0.0f)
+  m_t2(0.0f),
+  m_page(0)
 {
+  // Bitmap is empty until the delegating constructor takes one or sets its size.
   FT_Bitmap_New(&m_bitmap);
-  
-  FT_Error err = FT_Bitmap_Copy(FtLibrary::get(), bitmap, &m_bitmap);
-  if(0 != err)
-  {
-    std::ostringstream sstr;
-    sstr << "could not copy rendered FreeType bitmap for character " << m_unicode;
-    BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
-  }
 }
 
-FtGlyph::~FtGlyph()
+FtGlyph::FtGlyph(unsigned pcode, const FT_Bitmap &bitmap, BitmapPool &ppool, unsigned psize, unsigned ptarget,
+    float pdropdown, DistanceMode pmode, DistanceEngine pengine, float pleft, float ptop, float pax,
+    float pay) :
+  FtGlyph(pcode, psize, ptarget, pdropdown, pmode, pengine, static_cast<float>(bitmap.width),
+      static_cast<float>(bitmap.rows), pleft, ptop, pax, pay)
 {
-  // May have to destroy the large bitmap.
-  if(NULL == m_crunched)
-  {
-    FT_Bitmap_Done(FtLibrary::get(), &m_bitmap);
-  }
-  delete[] m_crunched;
+  m_bitmap = bitmap;
+  m_buffer.reset(bitmap.buffer, boost::bind(&BitmapPool::release, &ppool, _1));
 }
 
-unsigned FtGlyph::contractDown()
+FtGlyph::FtGlyph(unsigned pcode, const GlyphRunsSptr &pruns, unsigned psize, unsigned ptarget, float pdropdown,
+    DistanceEngine pengine, float pleft, float ptop, float pax, float pay) :
+  FtGlyph(pcode, psize, ptarget, pdropdown, DISTANCE_BINARY, pengine, static_cast<float>(pruns->getWidth()),
+      static_cast<float>(pruns->getRows()), pleft, ptop, pax, pay)
 {
-  unsigned empty_rows = 0;
-
-  for(unsigned ii = 0; (ii < m_bitmap_h); ++ii)
-  {
-    if(!this->isEmptyRow(m_bitmap_h - ii - 1))
-    {
-      break;
-    }
-    ++empty_rows;
-  }
-
-  if(empty_rows >= m_bitmap_h)
-  {
-    delete[] m_crunched;
+  m_runs = pruns;
 
-    this->m_bitmap_w = this->m_bitmap_h = 0;
-    this->m_crunched = NULL;
-
-    return empty_rows;
-  }
-
-  if(1 < empty_rows)
-  {
-    this->subCrunched(0, 0, m_bitmap_w, m_bitmap_h - empty_rows + 1);
-
-    return empty_rows - 1;
-  }
-  return 0;
+  // Bitmap only carries the size, there is no buffer.
+  m_bitmap.width = pruns->getWidth();
+  m_bitmap.rows = pruns->getRows();
 }
 
-unsigned FtGlyph::contractLeft()
+FtGlyph::FtGlyph(unsigned pcode, const MsdfShapeSptr &pshape, unsigned psize, unsigned ptarget, float pdropdown,
+    float pleft, float ptop, float pax, float pay) :
+  FtGlyph(pcode, psize, ptarget, pdropdown, DISTANCE_MSDF, ENGINE_SCAN, static_cast<float>(pshape->getWidth()),
+      static_cast<float>(pshape->getRows()), pleft, ptop, pax, pay)
 {
-  unsigned empty_columns = 0;
-
-  for(unsigned ii = 0; (ii < m_bitmap_w); ++ii)
-  {
-    if(!this->isEmptyColumn(ii))
-    {
-      break;
-    }
-    ++empty_columns;
-  }
-
-  if(empty_columns >= m_bitmap_w)
-  {
-    delete[] m_crunched;
+  m_shape = pshape;
 
-    this->m_bitmap_w = this->m_bitmap_h = 0;
-    this->m_crunched = NULL;
-
-    return empty_columns;
-  }
-
-  if(1 < empty_columns)
-  {
-    this->subCrunched(empty_columns - 1, 0, m_bitmap_w - empty_columns + 1, m_bitmap_h);
-
-    return empty_columns - 1;
-  }
-  return 0;
+  // Bitmap only carries the size, there is no buffer.
+  m_bitmap.width = pshape->getWidth();
+  m_bitmap.rows = pshape->getRows();
 }
 
-unsigned FtGlyph::contractRight()
+FtGlyph::FtGlyph(unsigned pcode, const GlyphTilesSptr &ptiles, unsigned psize, unsigned ptarget,
+    float pdropdown, DistanceMode pmode, DistanceEngine pengine, float pleft, float ptop, float pax, float pay) :
+  FtGlyph(pcode, psize, ptarget, pdropdown, pmode, pengine, static_cast<float>(ptiles->getWidth()),
+      static_cast<float>(ptiles->getRows()), pleft, ptop, pax, pay)
 {
-  unsigned empty_columns = 0;
-
-  for(unsigned ii = 0; (ii < m_bitmap_w); ++ii)
-  {
-    if(!this->isEmptyColumn(m_bitmap_w - ii - 1))
-    {
-      break;
-    }
-    ++empty_columns;
-  }
-
-  if(empty_columns >= m_bitmap_w)
-  {
-    delete[] m_crunched;
-
-    this->m_bitmap_w = this->m_bitmap_h = 0;
-    this->m_crunched = NULL;
+  m_tiles = ptiles;
 
-    return empty_columns;
-  }
+  // Bitmap only carries the size, there is no buffer.
+  m_bitmap.width = ptiles->getWidth();
+  m_bitmap.rows = ptiles->getRows();
+}
 
-  if(1 < empty_columns)
-  {
-    this->subCrunched(0, 0, m_bitmap_w - empty_columns + 1, m_bitmap_h);
+FtGlyph::FtGlyph(unsigned pcode, unsigned ptarget, float pdropdown, DistanceMode pmode, unsigned bw, unsigned bh) :
+  FtGlyph(pcode, ptarget, ptarget, pdropdown, pmode, ENGINE_SCAN, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f)
+{
+  // There is no precalc bitmap at all, only the predicted crunched size.
+  m_bitmap_w = bw;
+  m_bitmap_h = bh;
+}
 
-    return empty_columns - 1;
-  }
-  return 0;
+FtGlyph::FtGlyph(unsigned pcode, unsigned psize, float pdropdown, DistanceMode pmode, float pwidth, float pheight,
+    float pleft, float ptop, float pax, float pay) :
+  FtGlyph(pcode, psize, psize, pdropdown, pmode, ENGINE_SCAN, pwidth, pheight, pleft, ptop, pax, pay)
+{
+  // There is no precalc bitmap at all, metrics are final without crunching.
+  this->finish(0.0f, 0.0f);
 }
 
-unsigned FtGlyph::contractUp()
+FtGlyph::FtGlyph(const FtGlyph &src, unsigned ptarget) :
+  FtGlyph(src.m_unicode, src.m_size, ptarget, src.m_dropdown, src.m_distance_mode, src.m_distance_engine,
+      src.m_width, src.m_height, src.m_left, src.m_top, src.m_advance_x, src.m_advance_y)
 {
-  unsigned empty_rows = 0;
+  m_bitmap = src.m_bitmap;
+  m_buffer = src.m_buffer;
+  m_runs = src.m_runs;
+  m_shape = src.m_shape;
+  m_tiles = src.m_tiles;
+  m_field = src.m_field;
+  m_origin_aligned = src.m_origin_aligned;
+  m_spread = src.m_spread;
+}
 
-  for(unsigned ii = 0; (ii < m_bitmap_h); ++ii)
-  {
-    if(!this->isEmptyRow(ii))
-    {
-      break;
-    }
-    ++empty_rows;
-  }
+FtGlyph::~FtGlyph()
+{
+  // May have to release the large bitmap.
+  this->releaseBitmap();
+  delete[] m_crunched;
+}
 
-  if(empty_rows >= m_bitmap_h)
-  {
-    delete[] m_crunched;
+FtGlyph* FtGlyph::clone(unsigned ptarget) const
+{
+  BOOST_ASSERT(NULL == m_crunched);
 
-    this->m_bitmap_w = this->m_bitmap_h = 0;
-    this->m_crunched = NULL;
+  return new FtGlyph(*this, ptarget);
+}
 
-    return empty_rows;
-  }
+void FtGlyph::setField(const DistanceFieldSptr &pfield)
+{
+  unsigned width = m_bitmap.width;
+  unsigned rows = m_bitmap.rows;
 
-  if(1 < empty_rows)
-  {
-    this->subCrunched(0, empty_rows - 1, m_bitmap_w, m_bitmap_h - empty_rows + 1);
+  this->releaseBitmap();
 
-    return empty_rows - 1;
-  }
-  return 0;
+  // Sample grid is still placed relative to the precalc bitmap size.
+  m_bitmap.width = width;
+  m_bitmap.rows = rows;
+  m_field = pfield;
 }
 
 void FtGlyph::copy(uint8_t *tgt, unsigned tw, unsigned th, unsigned idx)
 {
-  unsigned div = tw / m_bitmap_w,
+  unsigned channels = this->getChannels(),
+           div = tw / m_bitmap_w,
            row = idx / div,
            col = idx % div,
-           linesize = m_bitmap_w * sizeof(uint8_t);
+           linesize = m_bitmap_w * channels * sizeof(uint8_t);
 
   // Image in memory is in OpenGL row order.
-  tgt += (th - 1 - row * m_bitmap_h) * tw + col * m_bitmap_w;
+  tgt += ((th - 1 - row * m_bitmap_h) * tw + col * m_bitmap_w) * channels;
 
   for(unsigned ii = 0; (ii < m_bitmap_h); ++ii)
   {
-    memcpy(tgt - ii * tw, m_crunched + ii * m_bitmap_w, linesize);
+    memcpy(tgt - ii * tw * channels, m_crunched + ii * m_bitmap_w * channels, linesize);
   }
 }
 
-void FtGlyph::crunch()
+bool FtGlyph::crunch(std::vector<FtGlyph*> &variants, const std::vector<float> &dropdowns, bool parallel,
+    DistanceField *field)
 {
   if(NULL == m_crunched)
   {
@@ -307,233 +1407,318 @@ void FtGlyph::crunch()
     float ftarget = static_cast<float>(m_target_size);
     float dist_scale(0.5f / (fsize * m_dropdown));
     float step = fsize / ftarget;
-    float pixel_scale = 1.0f / ftarget;
     int search = static_cast<int>(math::ceil(fsize * m_dropdown));
-    int ox = m_bitmap.width / 2;
-    int oy = m_bitmap.rows / 2;
-    unsigned bitmap_down = 0;
-    unsigned bitmap_left = 0;
-    unsigned bitmap_right = 0;
-    unsigned bitmap_scope_horiz = 1;
-    unsigned bitmap_scope_vert = 1;
-    unsigned bitmap_up = 0;
-    unsigned horiz_expand = static_cast<unsigned>(math::ceil(static_cast<float>(ox) / step));
-    unsigned vert_expand = static_cast<unsigned>(math::ceil(static_cast<float>(oy) / step));
-    float left = (m_left + static_cast<float>(ox)) / fsize - (static_cast<float>(m_bitmap_w) * 0.5f) / ftarget;
-    float top = (m_top - static_cast<float>(oy)) / fsize + (static_cast<float>(m_bitmap_h) * 0.5f) / ftarget;
-    bool down_done = false;
-    bool left_done = false;
-    bool right_done = false;
-    bool up_done = false;
-    bool done = false;
-    
-    // reserve 'enough' space for the crunched bitmap, then initialize the central point
-    m_crunched = new uint8_t[m_bitmap_w * m_bitmap_h];
-    memset(m_crunched, 0, m_bitmap_w * m_bitmap_h);
+    int ox = m_origin_aligned ? -static_cast<int>(m_left) : static_cast<int>(m_bitmap.width / 2);
+    int oy = m_origin_aligned ? static_cast<int>(m_top) : static_cast<int>(m_bitmap.rows / 2);
+    int ink_x1;
+    int ink_y1;
+    int ink_x2;
+    int ink_y2;
+
+    // Unscaled distances are kept for deriving variants. Binary mode distances are kept exactly in half pixels.
+    std::vector<float> distances;
+    std::vector<int> half_distances;
+
+    // Binary mode samples around the center of the precalc bitmap unless aligned to glyph origin. Other modes
+    // sample exact positions on a grid aligned to glyph origin, so the result does not depend on how the precalc
+    // bitmap was snapped to pixels. Multi-channel glyphs without an outline are measured with coverage. FreeType
+    // distance fields are interpolated at exact positions in every mode.
+    bool coverage = (DISTANCE_BINARY != m_distance_mode) || (0 < m_spread);
+    unsigned channels = this->getChannels();
+    float origin_x = coverage ? -m_left : static_cast<float>(ox);
+    float origin_y = coverage ? m_top : static_cast<float>(oy);
+    float left = (m_left + origin_x) / fsize;
+    float top = (m_top - origin_y) / fsize;
+
+    // Glyphs without ink (whitespace) are not sampled at all. Any coverage is ink when measuring with coverage.
+    // Distance field pixels less than a pixel outside the edge are ink.
+    uint8_t threshold = static_cast<uint8_t>((0 < m_spread) ? (127 - (128 + m_spread - 1) / m_spread) :
+        (coverage ? 0 : 127));
+    bool ink = m_field ? m_field->getBounds(ink_x1, ink_y1, ink_x2, ink_y2) :
+      (m_shape ? m_shape->getBounds(ink_x1, ink_y1, ink_x2, ink_y2) :
+       (m_runs ? m_runs->getBounds(ink_x1, ink_y1, ink_x2, ink_y2) :
+        (m_tiles ? m_tiles->getBounds(threshold, ink_x1, ink_y1, ink_x2, ink_y2) :
+         get_ftbitmap_bounds(&m_bitmap, threshold, ink_x1, ink_y1, ink_x2, ink_y2))));
+    if(ink)
     {
-      uint8_t dfval = get_ftbitmap_dfield_value(&m_bitmap, ox, oy, search, dist_scale);
-      m_crunched[m_target_size * m_bitmap_w + m_target_size] = dfval;
-    }
+      int sample_x1;
+      int sample_y1;
+      int sample_x2;
+      int sample_y2;
+
+      // Distances saturate at the search radius, so only samples closer than that to ink may be nonzero. Sampled
+      // area has one more sample on every side, trimming keeps it as a border.
+      if(coverage)
+      {
+        // Edges within ink pixels may reach further by less than a pixel.
+        float reach = static_cast<float>(search + 1);
 
-    // Expansion.
-    for(unsigned expansion = 0; ((expansion < horiz_expand) || (expansion < vert_expand) || !done); ++expansion)
-    {
-      done = true;
+        sample_x1 = math::floor((static_cast<float>(ink_x1) - reach - origin_x) / step);
+        sample_y1 = math::floor((static_cast<float>(ink_y1) - reach - origin_y) / step);
+        sample_x2 = math::ceil((static_cast<float>(ink_x2 + 1) + reach - origin_x) / step);
+        sample_y2 = math::ceil((static_cast<float>(ink_y2 + 1) + reach - origin_y) / step);
+      }
+      else
+      {
+        sample_x1 = get_first_sample_above(ink_x1 - search, ox, m_size, m_target_size) - 1;
+        sample_y1 = get_first_sample_above(ink_y1 - search, oy, m_size, m_target_size) - 1;
+        sample_x2 = get_first_sample_above(ink_x2 + search - 1, ox, m_size, m_target_size);
+        sample_y2 = get_first_sample_above(ink_y2 + search - 1, oy, m_size, m_target_size);
+      }
 
-      if(!down_done || (expansion < vert_expand))
+      m_bitmap_w = static_cast<unsigned>(sample_x2 - sample_x1 + 1);
+      m_bitmap_h = static_cast<unsigned>(sample_y2 - sample_y1 + 1);
+      m_sample_x = sample_x1;
+      m_sample_y = sample_y1;
+      left += (static_cast<float>(sample_x1) - 0.5f) / ftarget;
+      top -= (static_cast<float>(sample_y1) - 0.5f) / ftarget;
+
+      // Binary mode samples the pixels nearest to sample positions, coverage mode samples them exactly.
+      std::vector<int> coord_x(m_bitmap_w);
+      std::vector<int> coord_y(m_bitmap_h);
+      std::vector<float> exact_x(m_bitmap_w);
+      std::vector<float> exact_y(m_bitmap_h);
+      for(unsigned ii = 0; (ii < m_bitmap_w); ++ii)
       {
-        down_done = true;
+        int sample = sample_x1 + static_cast<int>(ii);
 
-        ++bitmap_down;
-        ++bitmap_scope_vert;
+        coord_x[ii] = get_sample_coordinate(sample, ox, m_size, m_target_size);
+        exact_x[ii] = static_cast<float>(sample) * step + origin_x;
+      }
+      for(unsigned ii = 0; (ii < m_bitmap_h); ++ii)
+      {
+        int sample = sample_y1 + static_cast<int>(ii);
 
-        uint8_t *iter = m_crunched + (m_target_size + bitmap_down) * m_bitmap_w + m_target_size - bitmap_left;
+        coord_y[ii] = get_sample_coordinate(sample, oy, m_size, m_target_size);
+        exact_y[ii] = static_cast<float>(sample) * step + origin_y;
+      }
 
-        for(unsigned ii = 0; (ii < bitmap_scope_horiz); ++ii)
+      // Outlines with colored edges are measured once per channel.
+      unsigned sampled_channels = m_field ? m_field->getChannels() : (m_shape ? MsdfShape::CHANNELS : 1);
+      if(coverage || m_field)
+      {
+        distances.resize(m_bitmap_w * m_bitmap_h * sampled_channels);
+      }
+      else
+      {
+        half_distances.resize(m_bitmap_w * m_bitmap_h);
+      }
+      if(m_field)
+      {
+        if(coverage)
         {
-          uint8_t dfval = get_ftbitmap_dfield_value(&m_bitmap,
-              math::lround(static_cast<float>(ii - bitmap_left) * step) + ox,
-              math::lround(static_cast<float>(bitmap_down) * step) + oy,
-              search, dist_scale);
-
-          if(0 < dfval)
+          m_field->resample(&(distances[0]), exact_x, exact_y);
+        }
+        else
+        {
+          // Binary mode distances are interpolated between sampled pixels and rounded back to half pixels.
+          m_field->resample(&(distances[0]), std::vector<float>(coord_x.begin(), coord_x.end()),
+              std::vector<float>(coord_y.begin(), coord_y.end()));
+          half_distances.resize(distances.size());
+          for(unsigned ii = 0; (ii < distances.size()); ++ii)
           {
-            if(0 >= ii)
-            {
-              left_done = false;
-            }
-            else if(bitmap_scope_horiz - 1 <= ii)
-            {
-              right_done = false;
-            }
-            down_done = false;
-            done = false;
+            half_distances[ii] = math::lround(distances[ii] * 2.0f);
           }
-
-          *iter = dfval;
-          ++iter;
+          distances.clear();
         }
       }
-      if(!left_done || (expansion < horiz_expand))
+      else if(m_tiles)
       {
-        left_done = true;
-
-        ++bitmap_left;
-        ++bitmap_scope_horiz;
+        // Tiles cover blocks of samples spanning a fixed number of precalc pixels.
+        unsigned block = std::max(static_cast<unsigned>(GlyphTiles::TILE_SIZE) * m_target_size / m_size, 1u);
 
-        uint8_t *iter = m_crunched + (m_target_size - bitmap_up) * m_bitmap_w + m_target_size - bitmap_left;
-
-        for(unsigned ii = 0; (ii < bitmap_scope_vert); ++ii)
+        if(!sample_tiles(*m_tiles, coverage ? &(distances[0]) : NULL, coverage ? NULL : &(half_distances[0]),
+              coord_x, coord_y, exact_x, exact_y, block, search, m_distance_mode, m_distance_engine, parallel))
         {
-          uint8_t dfval = get_ftbitmap_dfield_value(&m_bitmap,
-              math::lround(static_cast<float>(-static_cast<int>(bitmap_left)) * step) + ox,
-              math::lround(static_cast<float>(ii - bitmap_up) * step) + oy,
-              search, dist_scale);
-
-          if(0 < dfval)
-          {
-            if(0 >= ii)
-            {
-              up_done = false;
-            }
-            else if(bitmap_scope_vert - 1 <= ii)
-            {
-              down_done = false;
-            }
-            left_done = false;
-            done = false;
-          }
-
-          *iter = dfval;
-          iter += m_bitmap_w;
+          //std::cerr << "could not crunch glyph: " << m_unicode << std::endl;
+          m_bitmap_w = m_bitmap_h = 0;
+          this->releaseBitmap();
+          return false;
         }
       }
-      if(!right_done || (expansion < horiz_expand))
+      else
       {
-        right_done = true;
-
-        ++bitmap_right;
-        ++bitmap_scope_horiz;
-
-        uint8_t *iter = m_crunched + (m_target_size - bitmap_up) * m_bitmap_w + m_target_size + bitmap_right;
-
-        for(unsigned ii = 0; (ii < bitmap_scope_vert); ++ii)
+        // Boundary pixel grid is only searched in binary mode.
+        boost::scoped_ptr<EdgeGrid> grid;
+        if(!coverage && !m_runs && (ENGINE_GRID == m_distance_engine))
         {
-          uint8_t dfval = get_ftbitmap_dfield_value(&m_bitmap,
-              math::lround(static_cast<float>(bitmap_right) * step) + ox,
-              math::lround(static_cast<float>(ii - bitmap_up) * step) + oy,
-              search, dist_scale);
-
-          if(0 < dfval)
-          {
-            if(0 >= ii)
-            {
-              up_done = false;
-            }
-            else if(bitmap_scope_vert - 1 <= ii)
-            {
-              down_done = false;
-            }
-            right_done = false;
-            done = false;
-          }
-
-          *iter = dfval;
-          iter += m_bitmap_w;
+          grid.reset(new EdgeGrid(&m_bitmap, ink_x1, ink_y1, ink_x2, ink_y2, search));
         }
+
+        sample_rect(RectSampler(&m_bitmap, coverage ? &(distances[0]) : NULL,
+              coverage ? NULL : &(half_distances[0]), &(coord_x[0]), &(coord_y[0]), &(exact_x[0]),
+              &(exact_y[0]), m_bitmap_w, m_bitmap_w, search, m_distance_mode, grid.get(), m_runs.get(),
+              m_shape.get(), m_spread), m_bitmap_h, parallel);
       }
-      if(!up_done || (expansion < vert_expand))
-      {
-        up_done = true;
 
-        ++bitmap_up;
-        ++bitmap_scope_vert;
+      if(1 < sampled_channels)
+      {
+        // Distance may change by up to one sample step between neighbors.
+        msdf_correct_clashes(&(distances[0]), m_bitmap_w, m_bitmap_h, 1.001f * step);
+      }
 
-        uint8_t *iter = m_crunched + (m_target_size - bitmap_up) * m_bitmap_w + m_target_size - bitmap_left;
+      if((NULL != field) && coverage)
+      {
+        field->assign(exact_x, exact_y, sampled_channels, &(distances[0]), ink_x1, ink_y1, ink_x2, ink_y2);
+      }
+      else if(NULL != field)
+      {
+        std::vector<float> half_pixels(half_distances.size());
 
-        for(unsigned ii = 0; (ii < bitmap_scope_horiz); ++ii)
+        for(unsigned ii = 0; (ii < half_distances.size()); ++ii)
         {
-          uint8_t dfval = get_ftbitmap_dfield_value(&m_bitmap,
-              math::lround(static_cast<float>(ii - bitmap_left) * step) + ox,
-              math::lround(static_cast<float>(-static_cast<int>(bitmap_up)) * step) + oy,
-              search, dist_scale);
+          half_pixels[ii] = 0.5f * static_cast<float>(half_distances[ii]);
+        }
+        field->assign(std::vector<float>(coord_x.begin(), coord_x.end()),
+            std::vector<float>(coord_y.begin(), coord_y.end()), 1, &(half_pixels[0]), ink_x1, ink_y1, ink_x2,
+            ink_y2);
+      }
 
-          if(0 < dfval)
-          {
-            if(0 >= ii)
-            {
-              left_done = false;
-            }
-            else if(bitmap_scope_horiz - 1 <= ii)
-            {
-              right_done = false;
-            }
-            up_done = false;
-            done = false;
-          }
+      if(sampled_channels < channels)
+      {
+        std::vector<float> replicated(distances.size() * channels);
 
-          *iter = dfval;
-          ++iter;
+        for(unsigned ii = 0; (ii < replicated.size()); ++ii)
+        {
+          replicated[ii] = distances[ii / channels];
         }
+        distances.swap(replicated);
       }
-    }
 
-    // Represent glyph absolute metrics in units of font size.
-    m_width /= fsize;
-    m_height /= fsize;
-    m_left /= fsize;
-    m_top /= fsize;
+      m_crunched = new uint8_t[m_bitmap_w * m_bitmap_h * channels];
+      quantize_distances(m_crunched, distances, half_distances, dist_scale, search);
+    }
 
-    // The divisions by 64 are due to the advance values being expressed as 1/64ths of a pixel.
-    m_advance_x /= fsize * 64.0f;
-    m_advance_y /= fsize * 64.0f;
+    // Variants quantize the same distances before this glyph is trimmed. Smaller dropdowns only ever cover a
+    // subset of the area sampled for the largest one.
+    BOOST_FOREACH(float vv, dropdowns)
+    {
+      if(vv >= m_dropdown)
+      {
+        continue;
+      }
 
-    // Actual glyph quad coordinates.
-    left += static_cast<float>(this->contractLeft()) * pixel_scale;
-    top -= static_cast<float>(this->contractUp()) * pixel_scale;
+      FtGlyph *variant = new FtGlyph(*this, m_target_size);
+      float variant_scale = 0.5f / (fsize * vv);
 
-    this->contractRight();
-    this->contractDown();
+      variant->releaseBitmap();
+      variant->m_dropdown = vv;
+      if(NULL != m_crunched)
+      {
+        variant->m_bitmap_w = m_bitmap_w;
+        variant->m_bitmap_h = m_bitmap_h;
+        variant->m_sample_x = m_sample_x;
+        variant->m_sample_y = m_sample_y;
+        variant->m_crunched = new uint8_t[m_bitmap_w * m_bitmap_h * channels];
+        quantize_distances(variant->m_crunched, distances, half_distances, variant_scale, search);
+      }
+      variant->finish(left, top);
 
-    float fwidth = static_cast<float>(m_bitmap_w) / static_cast<float>(m_target_size);
-    float fheight = static_cast<float>(m_bitmap_h) / static_cast<float>(m_target_size);
+      variants.push_back(variant);
+    }
 
-    m_x1 = left;
-    m_y1 = top - fheight;
-    m_x2 = left + fwidth;
-    m_y2 = top;
+    this->finish(left, top);
 
     // Large bitmap no longer needed.
-    FT_Bitmap_Done(FtLibrary::get(), &m_bitmap);
+    this->releaseBitmap();
   }
+
+  return true;
 }
 
-bool FtGlyph::isEmptyColumn(unsigned op)
+void FtGlyph::finish(float left, float top)
 {
-  BOOST_ASSERT(op < m_bitmap_w);
-
-  for(unsigned ii = 0; (ii < m_bitmap_h); ++ii)
+  float fsize = static_cast<float>(m_size);
+  float pixel_scale = 1.0f / static_cast<float>(m_target_size);
+  float pad = static_cast<float>(m_spread);
+
+  // FreeType distance fields are padded by the spread on every side, metrics are those of the glyph.
+  m_width -= 2.0f * pad;
+  m_height -= 2.0f * pad;
+  m_left += pad;
+  m_top -= pad;
+
+  // Represent glyph absolute metrics in units of font size.
+  m_width /= fsize;
+  m_height /= fsize;
+  m_left /= fsize;
+  m_top /= fsize;
+
+  // The divisions by 64 are due to the advance values being expressed as 1/64ths of a pixel.
+  m_advance_x /= fsize * 64.0f;
+  m_advance_y /= fsize * 64.0f;
+
+  // Find the nonzero area in one pass.
+  unsigned channels = this->getChannels();
+  unsigned x1 = m_bitmap_w;
+  unsigned y1 = m_bitmap_h;
+  unsigned x2 = 0;
+  unsigned y2 = 0;
+  for(unsigned jj = 0; (jj < m_bitmap_h); ++jj)
   {
-    if(0 < m_crunched[ii * m_bitmap_w + op])
+    for(unsigned ii = 0; (ii < m_bitmap_w); ++ii)
     {
-      return false;
+      const uint8_t *sample = m_crunched + (jj * m_bitmap_w + ii) * channels;
+
+      if(0 < *std::max_element(sample, sample + channels))
+      {
+        x1 = std::min(x1, ii);
+        y1 = std::min(y1, jj);
+        x2 = std::max(x2, ii);
+        y2 = std::max(y2, jj);
+      }
     }
   }
-  return true;
-}
 
-bool FtGlyph::isEmptyRow(unsigned op)
-{
-  BOOST_ASSERT(op < m_bitmap_h);
+  // Nothing left to draw, quad collapses to the top left corner of the glyph.
+  if(x1 >= m_bitmap_w)
+  {
+    delete[] m_crunched;
+
+    m_crunched = NULL;
+    m_bitmap_w = m_bitmap_h = 0;
+    m_x1 = m_x2 = m_left;
+    m_y1 = m_y2 = m_top;
+    return;
+  }
+
+  // Keep one empty row or column around the nonzero area where there is one.
+  x1 = std::max(x1, 1u) - 1;
+  y1 = std::max(y1, 1u) - 1;
+  x2 = std::min(x2 + 1, m_bitmap_w - 1);
+  y2 = std::min(y2 + 1, m_bitmap_h - 1);
 
-  for(unsigned ii = 0; (ii < m_bitmap_w); ++ii)
+  if((0 < x1) || (0 < y1) || (m_bitmap_w - 1 > x2) || (m_bitmap_h - 1 > y2))
   {
-    if(0 < m_crunched[op * m_bitmap_w + ii])
-    {
-      return false;
-    }
+    this->subCrunched(x1, y1, x2 - x1 + 1, y2 - y1 + 1);
   }
-  return true;
+
+  m_sample_x += static_cast<int>(x1);
+  m_sample_y += static_cast<int>(y1);
+
+  // Actual glyph quad coordinates.
+  left += static_cast<float>(x1) * pixel_scale;
+  top -= static_cast<float>(y1) * pixel_scale;
+
+  float fwidth = static_cast<float>(m_bitmap_w) / static_cast<float>(m_target_size);
+  float fheight = static_cast<float>(m_bitmap_h) / static_cast<float>(m_target_size);
+
+  m_x1 = left;
+  m_y1 = top - fheight;
+  m_x2 = left + fwidth;
+  m_y2 = top;
+}
+
+void FtGlyph::releaseBitmap()
+{
+  m_buffer.reset();
+  m_runs.reset();
+  m_shape.reset();
+  m_tiles.reset();
+  m_field.reset();
+  m_bitmap.buffer = NULL;
+  m_bitmap.width = 0;
+  m_bitmap.rows = 0;
 }
 
 void FtGlyph::subCrunched(unsigned px, unsigned py, unsigned pw, unsigned ph)
@@ -543,14 +1728,13 @@ void FtGlyph::subCrunched(unsigned px, unsigned py, unsigned pw, unsigned ph)
   BOOST_ASSERT(px + pw <= m_bitmap_w);
   BOOST_ASSERT(py + ph <= m_bitmap_h);
 
-  uint8_t *new_crunched = new uint8_t[pw * ph];
+  unsigned channels = this->getChannels();
+  uint8_t *new_crunched = new uint8_t[pw * ph * channels];
 
   for(unsigned jj = 0; (jj < ph); ++jj)
   {
-    for(unsigned ii = 0; (ii < pw); ++ii)
-    {
-      new_crunched[jj * pw + ii] = m_crunched[(jj + py) * m_bitmap_w + ii + px];
-    }
+    memcpy(new_crunched + jj * pw * channels, m_crunched + ((jj + py) * m_bitmap_w + px) * channels,
+        pw * channels);
   }
 
   delete[] m_crunched;
@@ -560,12 +1744,60 @@ void FtGlyph::subCrunched(unsigned px, unsigned py, unsigned pw, unsigned ph)
   m_crunched = new_crunched;
 }
 
+unsigned FtGlyph::getMaxDifference(const FtGlyph &op, uint64_t *sum, uint64_t *count) const
+{
+  BOOST_ASSERT(m_target_size == op.m_target_size);
+
+  unsigned channels = this->getChannels();
+
+  // Compare over the union of both crunched areas, in sample coordinates.
+  int x1 = std::min(m_sample_x, op.m_sample_x);
+  int y1 = std::min(m_sample_y, op.m_sample_y);
+  int x2 = std::max(m_sample_x + static_cast<int>(m_bitmap_w), op.m_sample_x + static_cast<int>(op.m_bitmap_w));
+  int y2 = std::max(m_sample_y + static_cast<int>(m_bitmap_h), op.m_sample_y + static_cast<int>(op.m_bitmap_h));
+  uint64_t difference_sum = 0;
+  unsigned ret = 0;
+
+  for(int jj = y1; (jj < y2); ++jj)
+  {
+    for(int ii = x1; (ii < x2); ++ii)
+    {
+      for(unsigned kk = 0; (kk < channels); ++kk)
+      {
+        int lhs = get_crunched_value(m_crunched, m_bitmap_w, m_bitmap_h, channels, kk, ii - m_sample_x,
+            jj - m_sample_y);
+        int rhs = get_crunched_value(op.m_crunched, op.m_bitmap_w, op.m_bitmap_h, channels, kk,
+            ii - op.m_sample_x, jj - op.m_sample_y);
+        unsigned difference = static_cast<unsigned>(abs(lhs - rhs));
+
+        difference_sum += difference;
+        ret = std::max(ret, difference);
+      }
+    }
+  }
+
+  if(NULL != sum)
+  {
+    *sum += difference_sum;
+  }
+  if(NULL != count)
+  {
+    *count += static_cast<uint64_t>(x2 - x1) * static_cast<uint64_t>(y2 - y1) * channels;
+  }
+  return ret;
+}
+
 void FtGlyph::write(FILE *fptr, bool glst)
+{
+  this->write(fptr, glst, m_unicode);
+}
+
+void FtGlyph::write(FILE *fptr, bool glst, unsigned code)
 {
   std::stringstream sstream;
 
   sstream << "\t<glyph>\n" <<
-    "\t\t<code>" << m_unicode << "</code>\n" <<
+    "\t\t<code>" << code << "</code>\n" <<
     "\t\t<width>" << m_width << "</width>\n" <<
     "\t\t<height>" << m_height << "</height>\n" <<
     "\t\t<left>" << m_left << "</left>\n" <<
@@ -592,7 +1824,15 @@ std::ostream& operator<<(std::ostream &lhs, const FtGlyph &rhs)
   {
     for(unsigned ii = 0; (ii < rhs.m_bitmap_w); ++ii)
     {
-      int input = static_cast<int>(rhs.m_crunched[jj * rhs.m_bitmap_w + ii]);
+      // Multi-channel glyphs are drawn by the median of their channels.
+      unsigned channels = rhs.getChannels();
+      const uint8_t *sample = rhs.m_crunched + (jj * rhs.m_bitmap_w + ii) * channels;
+      int input = static_cast<int>(sample[0]);
+      if(3 <= channels)
+      {
+        input = static_cast<int>(std::max(std::min(sample[0], sample[1]),
+              std::min(std::max(sample[0], sample[1]), sample[2])));
+      }
       char cc = ' ';
 
       if(0 < input)
@@ -2,11 +2,55 @@
 #define FT_GLYPH_HPP
 
 #include "defaults.hpp"
+#include "distance_field.hpp"
+#include "glyph_runs.hpp"
+#include "glyph_tiles.hpp"
+#include "msdf_shape.hpp"
 
 #include "ft2build.h"
 #include FT_FREETYPE_H
 #include FT_BITMAP_H
 
+#include <vector>
+
+class BitmapPool;
+
+/** \brief Ways to measure distances in the precalc bitmap.
+ */
+enum DistanceMode
+{
+  /** Pixels are either inside or outside, thresholded at half coverage. */
+  DISTANCE_BINARY,
+
+  /** Anti-aliased coverage of edge pixels locates the edge within the pixel. */
+  DISTANCE_COVERAGE,
+
+  /** Distances to differently colored outline edges on three channels, the median keeps corners sharp. */
+  DISTANCE_MSDF
+};
+
+/** \brief Ways to search for the closest edge in binary mode.
+ */
+enum DistanceEngine
+{
+  /** Bitmap rows are scanned outwards from every sample. */
+  ENGINE_SCAN,
+
+  /** Boundary pixels are extracted once and bucketed into a grid, cost scales with perimeter of the glyph. */
+  ENGINE_GRID,
+
+  /** Outline glyphs are rendered as runs of set pixels on every row instead of a precalc bitmap, runs on rows are
+   * searched outwards from every sample. */
+  ENGINE_RUNS,
+
+  /** FreeType renders a signed distance field from the outline as the precalc bitmap, samples interpolate it. */
+  ENGINE_FREETYPE,
+
+  /** FreeType renders a signed distance field from a coverage bitmap as the precalc bitmap, samples interpolate
+   * it. */
+  ENGINE_FREETYPE_BITMAP
+};
+
 /** \brief Represents one rendered glyph.
  */
 class FtGlyph
@@ -15,10 +59,27 @@ class FtGlyph
     /** Unicode number. */
     unsigned m_unicode;
 
-    /** FreeType bitmap. */
+    /** FreeType bitmap, buffer owned by the pool. */
     FT_Bitmap m_bitmap;
 
-    /** Bitmap data. */
+    /** Precalc bitmap buffer, shared by all target sizes of the glyph and released into the pool by the last. */
+    boost::shared_ptr<uint8_t> m_buffer;
+
+    /** Runs of set pixels, replacing the precalc bitmap buffer when present, shared like it. */
+    GlyphRunsSptr m_runs;
+
+    /** Outline with colored edges, replacing the precalc bitmap buffer when present, shared like it. */
+    MsdfShapeSptr m_shape;
+
+    /** Outline rendered one tile at a time while crunching, replacing the precalc bitmap buffer when present,
+     * shared like it. */
+    GlyphTilesSptr m_tiles;
+
+    /** Distances of a larger target size of the same precalc bitmap, replacing the precalc bitmap when present.
+     * Sampled by interpolation instead of searching. */
+    DistanceFieldSptr m_field;
+
+    /** Bitmap data, channels of every pixel interleaved. */
     uint8_t *m_crunched;
 
     /** Bitmap size. */
@@ -27,9 +88,21 @@ class FtGlyph
     /** Target size. */
     unsigned m_target_size;
 
-    /** Dropdown distance as percentage of full glyph size. */
+    /** Dropdown distance as percentage of full glyph size, also the distance search radius. */
     float m_dropdown;
 
+    /** Distance measurement mode. */
+    DistanceMode m_distance_mode;
+
+    /** Distance search engine. */
+    DistanceEngine m_distance_engine;
+
+    /** Sample grid is aligned to glyph origin in binary mode as well, not only in coverage mode. */
+    bool m_origin_aligned;
+
+    /** Spread of the FreeType distance field in the precalc bitmap in pixels, 0 if it holds coverage. */
+    unsigned m_spread;
+
     /** Freetype glyph data. */
     float m_width;
 
@@ -54,6 +127,12 @@ class FtGlyph
     /** Bitmap height. */
     unsigned m_bitmap_h;
 
+    /** Sample index of the first crunched column, relative to the sample grid origin. */
+    int m_sample_x;
+
+    /** Sample index of the first crunched row, relative to the sample grid origin. */
+    int m_sample_y;
+
     /** OpenGL data. */
     float m_x1;
 
@@ -83,10 +162,17 @@ class FtGlyph
 
   public:
     /** \brief Constructor.
+     *
+     * Takes ownership of the bitmap buffer, it will be released back into the pool once no longer needed.
      *
      * \param pcode Unicode number.
-     * \param bitmap Bitmap to copy.
+     * \param bitmap Bitmap to take.
+     * \param ppool Pool the bitmap buffer was acquired from.
      * \param psize Bitmap render size.
+     * \param ptarget Target size.
+     * \param pdropdown Dropdown.
+     * \param pmode Distance measurement mode.
+     * \param pengine Distance search engine.
      * \param pw Width.
      * \param ph Height.
      * \param pleft Left.
@@ -97,51 +183,150 @@ class FtGlyph
      * \param bh Bitmap height.
      * \param bdata Bitmap data.
      */
-    FtGlyph(unsigned pcode, FT_Bitmap *bitmap, unsigned psize, unsigned ptarget, float pdropdown, float pleft,
-        float ptop, float pax, float pay);
+    FtGlyph(unsigned pcode, const FT_Bitmap &bitmap, BitmapPool &ppool, unsigned psize, unsigned ptarget,
+        float pdropdown, DistanceMode pmode, DistanceEngine pengine, float pleft, float ptop, float pax,
+        float pay);
 
-    /** \brief Destructor.
+    /** \brief Constructor.
+     *
+     * Glyph is rendered as runs of set pixels, there is no precalc bitmap buffer.
+     *
+     * \param pcode Unicode number.
+     * \param pruns Runs of set pixels.
+     * \param psize Bitmap render size.
+     * \param ptarget Target size.
+     * \param pdropdown Dropdown.
+     * \param pengine Distance search engine.
+     * \param pleft Left.
+     * \param ptop Top.
+     * \param pax Advance x.
+     * \param pay Advance y.
      */
-    ~FtGlyph();
+    FtGlyph(unsigned pcode, const GlyphRunsSptr &pruns, unsigned psize, unsigned ptarget, float pdropdown,
+        DistanceEngine pengine, float pleft, float ptop, float pax, float pay);
 
-  private:
-    /** \brief Contract the crunched from down.
+    /** \brief Constructor.
+     *
+     * Glyph is measured from an outline on multiple channels, there is no precalc bitmap buffer.
      *
-     * \return Pixels contracted.
+     * \param pcode Unicode number.
+     * \param pshape Outline with colored edges.
+     * \param psize Bitmap render size.
+     * \param ptarget Target size.
+     * \param pdropdown Dropdown.
+     * \param pleft Left.
+     * \param ptop Top.
+     * \param pax Advance x.
+     * \param pay Advance y.
      */
-    unsigned contractDown();
+    FtGlyph(unsigned pcode, const MsdfShapeSptr &pshape, unsigned psize, unsigned ptarget, float pdropdown,
+        float pleft, float ptop, float pax, float pay);
 
-    /** \brief Contract the crunched from left.
+    /** \brief Constructor.
      *
-     * \return Pixels contracted.
+     * Precalc bitmap is rendered one tile at a time while crunching, there is no precalc bitmap buffer.
+     *
+     * \param pcode Unicode number.
+     * \param ptiles Outline to render tiles from.
+     * \param psize Bitmap render size.
+     * \param ptarget Target size.
+     * \param pdropdown Dropdown.
+     * \param pmode Distance measurement mode.
+     * \param pengine Distance search engine.
+     * \param pleft Left.
+     * \param ptop Top.
+     * \param pax Advance x.
+     * \param pay Advance y.
      */
-    unsigned contractLeft();
+    FtGlyph(unsigned pcode, const GlyphTilesSptr &ptiles, unsigned psize, unsigned ptarget, float pdropdown,
+        DistanceMode pmode, DistanceEngine pengine, float pleft, float ptop, float pax, float pay);
 
-    /** \brief Contract the crunched from right.
+    /** \brief Constructor.
+     *
+     * Glyph is only planned, nothing is rendered or crunched. Crunched size is a prediction.
      *
-     * \return Pixels contracted.
+     * \param pcode Unicode number.
+     * \param ptarget Target size.
+     * \param pdropdown Dropdown.
+     * \param pmode Distance measurement mode.
+     * \param bw Predicted crunched width.
+     * \param bh Predicted crunched height.
      */
-    unsigned contractRight();
+    FtGlyph(unsigned pcode, unsigned ptarget, float pdropdown, DistanceMode pmode, unsigned bw, unsigned bh);
 
-    /** \brief Contract the crunched from up.
+    /** \brief Constructor.
      *
-     * \return Pixels contracted.
+     * Glyph is only measured, nothing is rendered or crunched. Quad collapses to the top left corner of the glyph
+     * (left, top) and texture coordinates are zero.
+     *
+     * \param pcode Unicode number.
+     * \param psize Size metrics are measured at.
+     * \param pdropdown Dropdown.
+     * \param pmode Distance measurement mode.
+     * \param pwidth Width.
+     * \param pheight Height.
+     * \param pleft Left.
+     * \param ptop Top.
+     * \param pax Advance x.
+     * \param pay Advance y.
      */
-    unsigned contractUp();
+    FtGlyph(unsigned pcode, unsigned psize, float pdropdown, DistanceMode pmode, float pwidth, float pheight,
+        float pleft, float ptop, float pax, float pay);
 
-    /** \brief Tell if a column is empty.
+    /** \brief Destructor.
+     */
+    ~FtGlyph();
+
+  private:
+    /** \brief Constructor.
+     *
+     * Initializes every member, other constructors delegate here and only set what they own. Bitmap is empty.
      *
-     * \param op Column index.
-     * \return True if yes.
+     * \param pcode Unicode number.
+     * \param psize Bitmap render size.
+     * \param ptarget Target size.
+     * \param pdropdown Dropdown.
+     * \param pmode Distance measurement mode.
+     * \param pengine Distance search engine.
+     * \param pwidth Width.
+     * \param pheight Height.
+     * \param pleft Left.
+     * \param ptop Top.
+     * \param pax Advance x.
+     * \param pay Advance y.
+     */
+    FtGlyph(unsigned pcode, unsigned psize, unsigned ptarget, float pdropdown, DistanceMode pmode,
+        DistanceEngine pengine, float pwidth, float pheight, float pleft, float ptop, float pax, float pay);
+
+    /** \brief Copy constructor.
+     *
+     * Shares the precalc bitmap with the source glyph. Crunched data is not copied.
+     *
+     * \param src Source glyph, metrics must not have been finalized.
+     * \param ptarget Target size.
      */
-    bool isEmptyColumn(unsigned op);
+    FtGlyph(const FtGlyph &src, unsigned ptarget);
 
-    /** \brief Tell if a row is empty.
+    /** \brief Assignment operator (deleted).
      *
-     * \param op Row index.
-     * \return True if yes.
+     * \param src Source glyph.
+     * \return This object.
      */
-    bool isEmptyRow(unsigned op);
+    FtGlyph& operator=(const FtGlyph &src);
+
+  private:
+    /** \brief Release the precalc bitmap back into the pool, or whatever replaces it.
+     */
+    void releaseBitmap();
+
+    /** \brief Finalize metrics and trim the crunched bitmap.
+     *
+     * Trims everything but a border of one empty row or column around the nonzero area.
+     *
+     * \param left Left edge of the untrimmed crunched bitmap in units of font size.
+     * \param top Top edge of the untrimmed crunched bitmap in units of font size.
+     */
+    void finish(float left, float top);
 
     /** \brief Regenerate the crunched area as a subset of what it was.
      *
@@ -153,6 +338,23 @@ class FtGlyph
     void subCrunched(unsigned px, unsigned py, unsigned pw, unsigned ph);
 
   public:
+    /** \brief Create a copy of this glyph to be crunched at another target size.
+     *
+     * The precalc bitmap is shared, not rendered again. Must be called before crunching.
+     *
+     * \param ptarget Target size.
+     * \return New glyph.
+     */
+    FtGlyph* clone(unsigned ptarget) const;
+
+    /** \brief Crunch from the distances of a larger target size instead of the precalc bitmap.
+     *
+     * The precalc bitmap is released, the field must be assigned before crunching.
+     *
+     * \param pfield Distances of a larger target size.
+     */
+    void setField(const DistanceFieldSptr &pfield);
+
     /** \brief Copy this into a larger bitmap.
      *
      * \param tgt Target bitmap.
@@ -163,8 +365,33 @@ class FtGlyph
     void copy(uint8_t *tgt, unsigned tw, unsigned th, unsigned idx);
 
     /** \brief Crunch this bitmap.
+     *
+     * Distances are searched for once, within the dropdown radius of this glyph. Only the area within the
+     * dropdown radius from the bounding box of the glyph is sampled, glyphs with no ink are not sampled at all.
+     * Variants are quantized from the same distances for every given dropdown smaller than it. Glyphs given the
+     * distances of a larger target size interpolate them instead of searching.
+     *
+     * \param variants Crunched variant glyphs are appended here, ownership is passed to the caller.
+     * \param dropdowns Dropdowns to derive variants for.
+     * \param parallel Spread the distance search over worker threads row by row.
+     * \param field If not NULL, searched distances are assigned here for resampling to smaller target sizes.
+     * \return True on success, false if the glyph could not be crunched.
      */
-    void crunch();
+    bool crunch(std::vector<FtGlyph*> &variants, const std::vector<float> &dropdowns = std::vector<float>(),
+        bool parallel = false, DistanceField *field = NULL);
+
+    /** \brief Find the largest difference in crunched output values to another crunched glyph.
+     *
+     * Both glyphs must have been crunched to the same target size and dropdown with sample grids aligned to
+     * glyph origin. Samples outside the crunched area of either glyph are zero. Output values compared are
+     * those of every channel of every sample within the crunched area of either glyph.
+     *
+     * \param op Glyph to compare to.
+     * \param sum If not NULL, absolute differences of all output values compared are added here.
+     * \param count If not NULL, number of output values compared is added here.
+     * \return Largest absolute difference of output values.
+     */
+    unsigned getMaxDifference(const FtGlyph &op, uint64_t *sum = NULL, uint64_t *count = NULL) const;
 
     /** \brief Write the current glyph info into a file.
      *
@@ -173,6 +400,14 @@ class FtGlyph
      */
     void write(FILE *fptr, bool glst = true);
 
+    /** \brief Write the current glyph info into a file under another unicode number.
+     *
+     * \param fptr FILE pointer.
+     * \param glst Use OpenGL texture cooredinates (as opposed to DirectX).
+     * \param code Unicode number to write.
+     */
+    void write(FILE *fptr, bool glst, unsigned code);
+
   public:
     /** \brief Get crunched data.
      *
@@ -185,6 +420,15 @@ class FtGlyph
       return m_crunched;
     }
 
+    /** \brief Get number of channels in crunched data.
+     *
+     * \return Channels per pixel.
+     */
+    inline unsigned getChannels() const
+    {
+      return (DISTANCE_MSDF == m_distance_mode) ? MsdfShape::CHANNELS : 1;
+    }
+
     /** \brief Get crunched bitmap width.
      *
      * \return Bitmap width.
@@ -203,6 +447,33 @@ class FtGlyph
       return m_bitmap_h;
     }
 
+    /** \brief Get dropdown the glyph is quantized with.
+     *
+     * \return Dropdown.
+     */
+    inline float getDropdown() const
+    {
+      return m_dropdown;
+    }
+
+    /** \brief Get page the glyph is on.
+     *
+     * \return Page index.
+     */
+    inline unsigned getPage() const
+    {
+      return m_page;
+    }
+
+    /** \brief Get target size the glyph is crunched to.
+     *
+     * \return Target size.
+     */
+    inline unsigned getTargetSize() const
+    {
+      return m_target_size;
+    }
+
     /** \brief Get unicode number of the glyph.
      *
      * \return Glyph unicode id.
@@ -212,6 +483,25 @@ class FtGlyph
       return m_unicode;
     }
 
+    /** \brief Align the sample grid to glyph origin in binary mode too.
+     *
+     * Crunched results from different precalc sizes are only comparable sample by sample if the grid is aligned
+     * to glyph origin. Must be called before cloning and crunching.
+     */
+    inline void setOriginAligned()
+    {
+      m_origin_aligned = true;
+    }
+
+    /** \brief Tell the precalc bitmap holds a FreeType distance field.
+     *
+     * \param op Spread of the distance field in pixels.
+     */
+    inline void setSpread(unsigned op)
+    {
+      m_spread = op;
+    }
+
     /** \brief Set the page number.
      *
      * \param op Page number.
@@ -237,6 +527,21 @@ class FtGlyph
       m_t2 = t2;
     }
 
+    /** \brief Take texture coordinates and page from another glyph.
+     *
+     * Glyphs with identical crunched bitmaps share one texture rectangle.
+     *
+     * \param op Glyph inserted into a page.
+     */
+    inline void setTexture(const FtGlyph &op)
+    {
+      m_s1 = op.m_s1;
+      m_t1 = op.m_t1;
+      m_s2 = op.m_s2;
+      m_t2 = op.m_t2;
+      m_page = op.m_page;
+    }
+
   public:
     /** \cond */
     friend std::ostream& operator<<(std::ostream &lhs, const FtGlyph &rhs);
@@ -31,3 +31,16 @@ FtLibrary::~FtLibrary()
     BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
   }
 }
+
+bool FtLibrary::setSdfSpread(unsigned op)
+{
+#if FT_LIBRARY_SDF
+  FT_Int spread = static_cast<FT_Int>(op);
+
+  return !FT_Property_Set(ftlib.m_library_reference, "sdf", "spread", &spread) &&
+    !FT_Property_Set(ftlib.m_library_reference, "bsdf", "spread", &spread);
+#else
+  boost::ignore_unused_variable_warning(op);
+  return false;
+#endif
+}
@@ -4,10 +4,24 @@
 #include "ft2build.h"
 #include FT_FREETYPE_H
 
+/** FreeType 2.11 and newer render signed distance fields. */
+#if (2 < FREETYPE_MAJOR) || ((2 == FREETYPE_MAJOR) && (11 <= FREETYPE_MINOR))
+#define FT_LIBRARY_SDF 1
+#else
+#define FT_LIBRARY_SDF 0
+#endif
+
 /** FreeType library abstraction.
  */
 class FtLibrary
 {
+  public:
+    /** Largest distance field spread FreeType accepts, in pixels. */
+    static const unsigned SDF_MAX_SPREAD = 32;
+
+    /** Smallest distance field spread FreeType accepts, in pixels. */
+    static const unsigned SDF_MIN_SPREAD = 2;
+
   private:
     /** Class instance. */
     static FtLibrary ftlib;
@@ -23,6 +37,16 @@ class FtLibrary
     /** Destructor. */
     ~FtLibrary();
 
+  public:
+    /** \brief Set the spread of signed distance fields rendered.
+     *
+     * Sets the spread of both outline and bitmap distance field renderers.
+     *
+     * \param op Spread in pixels, between SDF_MIN_SPREAD and SDF_MAX_SPREAD.
+     * \return True on success, false if FreeType does not render signed distance fields.
+     */
+    static bool setSdfSpread(unsigned op);
+
   public:
     /** \brief Accessor.
      *
@@ -0,0 +1,112 @@
+#include "glyph_layout.hpp"
+
+#include "glyph_storage.hpp"
+
+/** \brief Tell if a crunched glyph fits a location.
+ *
+ * Glyphs crunched empty fit any location.
+ *
+ * \param op Glyph.
+ * \param loc Location.
+ * \return True if yes, false if no.
+ */
+static bool fits_location(const FtGlyph &op, const SkyLineLocation &loc)
+{
+  return (0 >= op.getCrunchedWidth()) || (0 >= op.getCrunchedHeight()) ||
+    ((op.getCrunchedWidth() <= loc.getWidth()) && (op.getCrunchedHeight() <= loc.getHeight()));
+}
+
+bool GlyphLayout::addPage(unsigned pw, unsigned ph, GlyphStorage &glyphs)
+{
+  SkyLineSptr page(new SkyLine(pw, ph));
+  std::vector<SkyLineLocation> locations;
+  unsigned count = page->reserveAll(glyphs, locations);
+
+  if(0 >= count)
+  {
+    return false;
+  }
+
+  // Glyphs reserved are always the first ones.
+  GlyphStorage::iterator iter = glyphs.begin();
+  for(unsigned ii = 0; (ii < count); ++ii, ++iter)
+  {
+    unsigned unicode = (*iter)->getUnicode();
+
+    m_locations.insert(std::make_pair(unicode, std::make_pair(this->getPageCount(), locations[ii])));
+    *iter = FtGlyphSptr();
+  }
+  glyphs.trim();
+
+  m_pages.push_back(page);
+  m_page_glyphs.push_back(count);
+  return true;
+}
+
+bool GlyphLayout::isPlaced(const FtGlyph &op) const
+{
+  return this->accepts(op) && (m_placed.end() != m_placed.find(op.getUnicode()));
+}
+
+void GlyphLayout::insert(unsigned page, const SkyLineLocation &loc, FtGlyph &op)
+{
+  m_pages[page]->insert(SkyLineLocation(loc.getX(), loc.getY(), op.getCrunchedWidth(), op.getCrunchedHeight()),
+      op);
+  op.setPage(page);
+  m_placed.insert(std::make_pair(op.getUnicode(), std::make_pair(page, loc)));
+}
+
+bool GlyphLayout::place(FtGlyph &op)
+{
+  std::map<unsigned, std::pair<unsigned, SkyLineLocation> >::const_iterator iter =
+    m_locations.find(op.getUnicode());
+
+  if((m_locations.end() != iter) && fits_location(op, iter->second.second))
+  {
+    boost::mutex::scoped_lock scope(m_mutex);
+
+    this->insert(iter->second.first, iter->second.second, op);
+    return true;
+  }
+
+  boost::mutex::scoped_lock scope(m_mutex);
+  std::vector<std::pair<unsigned, SkyLineLocation> >::iterator best = m_released.end();
+
+  for(std::vector<std::pair<unsigned, SkyLineLocation> >::iterator ii = m_released.begin();
+      (m_released.end() != ii); ++ii)
+  {
+    if(fits_location(op, ii->second) && ((m_released.end() == best) ||
+          (ii->second.getWidth() * ii->second.getHeight() < best->second.getWidth() * best->second.getHeight())))
+    {
+      best = ii;
+    }
+  }
+
+  if(m_released.end() == best)
+  {
+    return false;
+  }
+
+  std::pair<unsigned, SkyLineLocation> released = *best;
+  m_released.erase(best);
+  this->insert(released.first, released.second, op);
+  return true;
+}
+
+void GlyphLayout::release(const FtGlyph &op)
+{
+  boost::mutex::scoped_lock scope(m_mutex);
+  std::map<unsigned, std::pair<unsigned, SkyLineLocation> >::iterator iter = m_placed.find(op.getUnicode());
+
+  if(!this->accepts(op) || (m_placed.end() == iter))
+  {
+    return;
+  }
+
+  const SkyLineLocation &loc = iter->second.second;
+
+  m_pages[iter->second.first]->erase(SkyLineLocation(loc.getX(), loc.getY(), op.getCrunchedWidth(),
+        op.getCrunchedHeight()));
+  m_released.push_back(iter->second);
+  m_placed.erase(iter);
+}
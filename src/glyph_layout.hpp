@@ -0,0 +1,169 @@
+#ifndef GLYPH_LAYOUT_HPP
+#define GLYPH_LAYOUT_HPP
+
+#include "ft_glyph.hpp"
+#include "sky_line.hpp"
+
+#include <boost/thread/mutex.hpp>
+
+#include <map>
+
+// Forward declaration.
+class GlyphStorage;
+
+/** \brief Pages laid out from predicted glyph sizes before crunching.
+ *
+ * Every planned glyph has a location reserved for it. Crunched glyphs are copied into their pages as soon as they
+ * are finished, so fitting does not have to wait for crunching to end. Glyphs crunched larger than their location
+ * are left for the regular fitting afterwards.
+ */
+class GlyphLayout : public boost::noncopyable
+{
+  private:
+    /** Target size of glyphs laid out. */
+    unsigned m_target_size;
+
+    /** Dropdown of glyphs laid out. */
+    float m_dropdown;
+
+    /** Pages. */
+    std::vector<SkyLineSptr> m_pages;
+
+    /** Number of glyphs reserved on every page. */
+    std::vector<unsigned> m_page_glyphs;
+
+    /** Page index and reserved location by unicode number. */
+    std::map<unsigned, std::pair<unsigned, SkyLineLocation> > m_locations;
+
+    /** Page index and location of glyphs copied into their pages, by unicode number. */
+    std::map<unsigned, std::pair<unsigned, SkyLineLocation> > m_placed;
+
+    /** Page index and location of every location released by a glyph no longer using it. */
+    std::vector<std::pair<unsigned, SkyLineLocation> > m_released;
+
+    /** Guard for copying into pages. */
+    boost::mutex m_mutex;
+
+  public:
+    /** \brief Constructor.
+     *
+     * \param ptarget Target size of glyphs laid out.
+     * \param pdropdown Dropdown of glyphs laid out.
+     */
+    GlyphLayout(unsigned ptarget, float pdropdown) :
+      m_target_size(ptarget),
+      m_dropdown(pdropdown) { }
+
+  private:
+    /** \brief Copy a crunched glyph into a location.
+     *
+     * Must be called with the guard locked.
+     *
+     * \param page Page index.
+     * \param loc Location, at least the size of the crunched glyph.
+     * \param op Glyph.
+     */
+    void insert(unsigned page, const SkyLineLocation &loc, FtGlyph &op);
+
+  public:
+    /** \brief Add a page.
+     *
+     * Reserves locations for as many of the planned glyphs as fit. Glyphs reserved are removed from the storage.
+     *
+     * \param pw Page width.
+     * \param ph Page height.
+     * \param glyphs Planned glyphs, sorted.
+     * \return True if any glyph was reserved, false if not.
+     */
+    bool addPage(unsigned pw, unsigned ph, GlyphStorage &glyphs);
+
+    /** \brief Tell if a glyph has been copied into its page.
+     *
+     * Must not be called while glyphs are still being placed.
+     *
+     * \param op Glyph.
+     * \return True if yes, false if no.
+     */
+    bool isPlaced(const FtGlyph &op) const;
+
+    /** \brief Copy a crunched glyph into the location reserved for it.
+     *
+     * Glyphs that have no location or do not fit it take the smallest released location they fit, if any.
+     * Texture coordinates and page are written into the glyph.
+     *
+     * \param op Glyph.
+     * \return True if placed, false if glyph fits neither its own nor a released location.
+     */
+    bool place(FtGlyph &op);
+
+    /** \brief Release the location of a glyph copied into its page.
+     *
+     * Glyph is cleared from its page and no longer placed. Location may be taken by another glyph.
+     *
+     * \param op Glyph.
+     */
+    void release(const FtGlyph &op);
+
+  public:
+    /** \brief Tell if a glyph belongs to this layout.
+     *
+     * \param op Glyph.
+     * \return True if yes, false if no.
+     */
+    inline bool accepts(const FtGlyph &op) const
+    {
+      return (op.getTargetSize() == m_target_size) && (op.getDropdown() == m_dropdown);
+    }
+
+    /** \brief Get dropdown.
+     *
+     * \return Dropdown of glyphs laid out.
+     */
+    inline float getDropdown() const
+    {
+      return m_dropdown;
+    }
+
+    /** \brief Get a page.
+     *
+     * \param idx Page index.
+     * \return Page.
+     */
+    inline SkyLine& getPage(unsigned idx)
+    {
+      return *(m_pages[idx]);
+    }
+
+    /** \brief Get the number of pages.
+     *
+     * \return Page count.
+     */
+    inline unsigned getPageCount() const
+    {
+      return static_cast<unsigned>(m_pages.size());
+    }
+
+    /** \brief Get the number of glyphs reserved on a page.
+     *
+     * \param idx Page index.
+     * \return Glyph count.
+     */
+    inline unsigned getPageGlyphs(unsigned idx) const
+    {
+      return m_page_glyphs[idx];
+    }
+
+    /** \brief Get target size.
+     *
+     * \return Target size of glyphs laid out.
+     */
+    inline unsigned getTargetSize() const
+    {
+      return m_target_size;
+    }
+};
+
+/** Convenience typedef. */
+typedef boost::shared_ptr<GlyphLayout> GlyphLayoutSptr;
+
+#endif
@@ -3,20 +3,449 @@
 #include "ft_glyph.hpp"
 #include "glyph_storage.hpp"
 
+#include "prog/progress.hpp"
 #include "thr/dispatch.hpp"
 
-/** Crunch one glyph.
+#include <boost/atomic.hpp>
+
+#include <deque>
+
+/** Smallest adaptive precalc size relative to the largest target size. */
+static const unsigned ADAPTIVE_MIN_SCALE = 4;
+
+/** Number of glyphs dispatched for crunching and not yet crunched. */
+static boost::atomic<unsigned> crunches_pending(0);
+
+/** \brief Glyph crunched at increasing precalc sizes until consecutive results agree.
+ *
+ * Every precalc size is rendered once and crunched to all target sizes. The last crunch to finish compares the
+ * results to those of the previous precalc size.
+ */
+class AdaptiveGlyph : public boost::noncopyable
+{
+  public:
+    /** Unicode number. */
+    unsigned m_unicode;
+
+    /** Face the glyph is rendered from. */
+    FtFaceSptr m_face;
+
+    /** Current precalc size. */
+    unsigned m_size;
+
+    /** Estimated cost of crunching to one target size at the largest precalc size. */
+    uint64_t m_cost;
+
+    /** Crunched glyphs of the previous precalc size, one per target size. */
+    std::vector<FtGlyph*> m_previous;
+
+    /** Dropdown variants of the previous precalc size. */
+    std::vector<FtGlyph*> m_previous_variants;
+
+    /** Glyphs of the current precalc size, one per target size. */
+    std::vector<FtGlyph*> m_current;
+
+    /** Dropdown variants of the current precalc size, per target size. */
+    std::vector<std::vector<FtGlyph*> > m_variants;
+
+  public:
+    /** \brief Constructor.
+     *
+     * \param punicode Unicode number.
+     * \param pface Face to render from.
+     * \param psize Initial precalc size.
+     * \param pcost Estimated cost of crunching to one target size at the largest precalc size.
+     */
+    AdaptiveGlyph(unsigned punicode, const FtFaceSptr &pface, unsigned psize, uint64_t pcost) :
+      m_unicode(punicode),
+      m_face(pface),
+      m_size(psize),
+      m_cost(pcost) { }
+
+    /** \brief Destructor.
+     *
+     * Deletes all glyphs not yet given away.
+     */
+    ~AdaptiveGlyph()
+    {
+      this->clearPrevious();
+      this->clearCurrent();
+    }
+
+  private:
+    /** \brief Delete glyphs of the previous precalc size.
+     */
+    void clearPrevious()
+    {
+      BOOST_FOREACH(FtGlyph *vv, m_previous)
+      {
+        delete vv;
+      }
+      BOOST_FOREACH(FtGlyph *vv, m_previous_variants)
+      {
+        delete vv;
+      }
+      m_previous.clear();
+      m_previous_variants.clear();
+    }
+
+    /** \brief Delete glyphs of the current precalc size.
+     */
+    void clearCurrent()
+    {
+      BOOST_FOREACH(FtGlyph *vv, m_current)
+      {
+        delete vv;
+      }
+      for(unsigned ii = 0; (ii < m_variants.size()); ++ii)
+      {
+        BOOST_FOREACH(FtGlyph *vv, m_variants[ii])
+        {
+          delete vv;
+        }
+      }
+      m_current.clear();
+      m_variants.clear();
+    }
+
+  public:
+    /** \brief Move crunched glyphs of either the current or the previous precalc size into storage.
+     *
+     * \param storage Glyph storage.
+     * \param previous True to store glyphs of the previous precalc size, false for the current.
+     */
+    void accept(GlyphStorage &storage, bool previous)
+    {
+      if(previous)
+      {
+        this->clearCurrent();
+        m_current.swap(m_previous);
+        m_variants.push_back(std::vector<FtGlyph*>());
+        m_variants.back().swap(m_previous_variants);
+      }
+
+      BOOST_FOREACH(FtGlyph *vv, m_current)
+      {
+        storage.add(vv);
+      }
+      for(unsigned ii = 0; (ii < m_variants.size()); ++ii)
+      {
+        BOOST_FOREACH(FtGlyph *vv, m_variants[ii])
+        {
+          storage.add(vv);
+        }
+      }
+      m_current.clear();
+      m_variants.clear();
+    }
+
+    /** \brief Tell if crunched glyphs of the current precalc size are good enough.
+     *
+     * \return True if precalc size is at maximum or the results are within tolerance of the previous ones.
+     */
+    bool isConverged() const
+    {
+      if(m_size >= m_face->getSize())
+      {
+        return true;
+      }
+      if(m_previous.empty())
+      {
+        return false;
+      }
+
+      unsigned difference = 0;
+      for(unsigned ii = 0; (ii < m_current.size()); ++ii)
+      {
+        difference = std::max(difference, m_current[ii]->getMaxDifference(*(m_previous[ii])));
+      }
+      return (static_cast<float>(difference) <= m_face->getAdaptiveTolerance());
+    }
+
+    /** \brief Get the estimated cost of crunching to one target size at the current precalc size.
+     *
+     * \return Estimated cost.
+     */
+    uint64_t getCurrentCost() const
+    {
+      uint64_t size = m_face->getSize();
+
+      return m_cost * m_size * m_size / (size * size);
+    }
+
+    /** \brief Move on to the next precalc size.
+     *
+     * Glyphs of the current precalc size become the previous ones.
+     */
+    void advance()
+    {
+      this->clearPrevious();
+      m_previous.swap(m_current);
+      for(unsigned ii = 0; (ii < m_variants.size()); ++ii)
+      {
+        m_previous_variants.insert(m_previous_variants.end(), m_variants[ii].begin(), m_variants[ii].end());
+      }
+      m_variants.clear();
+      m_size = std::min(m_size * 2, m_face->getSize());
+    }
+};
+
+/** Adaptive glyphs waiting to be rendered at the next precalc size. */
+static std::deque<AdaptiveGlyph*> refine_queue;
+
+/** Number of adaptive glyphs not yet stored. */
+static unsigned adaptive_active = 0;
+
+/** Guard for adaptive glyph state. */
+static boost::mutex refine_mutex;
+
+/** Signaled when an adaptive glyph is queued for refinement or finished. */
+static boost::condition_variable refine_cond;
+
+/** \brief Crunch glyphs sharing one precalc bitmap to their target sizes.
+ *
+ * Only the glyph of the largest target size searches for distances. Smaller target sizes interpolate its
+ * distances, which costs next to nothing in comparison.
+ *
+ * \param glyphs Glyphs, one per target size.
+ * \param variants Variants of every glyph.
+ * \param dropdowns Dropdowns to derive variants for.
+ * \param parallel Spread the distance search over worker threads row by row.
+ * \return True on success, false if the glyphs could not be crunched.
+ */
+static bool crunch_sizes(const std::vector<FtGlyph*> &glyphs, std::vector<std::vector<FtGlyph*> > &variants,
+    const std::vector<float> &dropdowns, bool parallel)
+{
+  unsigned largest = 0;
+  for(unsigned ii = 1; (ii < glyphs.size()); ++ii)
+  {
+    if(glyphs[ii]->getTargetSize() > glyphs[largest]->getTargetSize())
+    {
+      largest = ii;
+    }
+  }
+
+  variants.resize(glyphs.size());
+  if(1 >= glyphs.size())
+  {
+    return glyphs[largest]->crunch(variants[largest], dropdowns, parallel);
+  }
+
+  DistanceFieldSptr field(new DistanceField());
+  if(!glyphs[largest]->crunch(variants[largest], dropdowns, parallel, field.get()))
+  {
+    return false;
+  }
+
+  for(unsigned ii = 0; (ii < glyphs.size()); ++ii)
+  {
+    if(ii != largest)
+    {
+      glyphs[ii]->setField(field);
+      if(!glyphs[ii]->crunch(variants[ii], dropdowns))
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/** Crunch one glyph to every target size.
+ *
+ * When there are fewer glyphs pending than there are workers, the glyph is split over idle workers instead.
  *
  * \param storage Glyph storage.
- * \param gly Glyph to crunch.
+ * \param glyphs Glyphs to crunch, one per target size.
+ * \param dropdowns Dropdowns to derive variants for.
+ * \param cost Estimated cost of crunching to one target size, reported as work done for every target size.
  */
-static void crunch_glyph(GlyphStorage &storage, FtGlyph* gly)
+static void crunch_glyph(GlyphStorage &storage, const std::vector<FtGlyph*> &glyphs,
+    const std::vector<float> &dropdowns, uint64_t cost)
 {
-  gly->crunch();
+  bool parallel = (crunches_pending.load(boost::memory_order_relaxed) < thr::hardware_concurrency());
+  std::vector<std::vector<FtGlyph*> > variants;
+  bool crunched = crunch_sizes(glyphs, variants, dropdowns, parallel);
+
+  crunches_pending.fetch_sub(1, boost::memory_order_relaxed);
+  prog::work_done(cost * glyphs.size());
+
+  for(unsigned ii = 0; (ii < glyphs.size()); ++ii)
+  {
+    // Glyph is missing from this target size, variants were never made or are discarded.
+    if(!crunched)
+    {
+      storage.missing(glyphs[ii]->getUnicode());
+      for(size_t jj = 1; (jj < dropdowns.size()); ++jj)
+      {
+        prog::item_skipped();
+      }
+      BOOST_FOREACH(FtGlyph *vv, variants[ii])
+      {
+        delete vv;
+      }
+      delete glyphs[ii];
+      continue;
+    }
+
+    storage.add(glyphs[ii]);
+    BOOST_FOREACH(FtGlyph *vv, variants[ii])
+    {
+      storage.add(vv);
+    }
+  }
+}
+
+/** \brief Measure a glyph and add it to the storage.
+ *
+ * \param storage Glyph storage.
+ * \param face Face to measure the glyph from.
+ * \param unicode Unicode number.
+ */
+static void measure_glyph(GlyphStorage &storage, FtFace &face, unsigned unicode)
+{
+  FtGlyph *gly = face.measureGlyph(unicode);
+
+  if(NULL == gly)
+  {
+    storage.missing(unicode);
+    return;
+  }
 
   storage.add(gly);
 }
 
+/** \brief Mark an adaptive glyph finished.
+ *
+ * \param adaptive Adaptive glyph, will be deleted.
+ */
+static void finish_adaptive(AdaptiveGlyph *adaptive)
+{
+  delete adaptive;
+
+  boost::lock_guard<boost::mutex> lock(refine_mutex);
+  --adaptive_active;
+  refine_cond.notify_all();
+}
+
+/** \brief Crunch the glyphs of an adaptive glyph at its current precalc size.
+ *
+ * Either stores the glyphs or queues the adaptive glyph for refinement.
+ *
+ * \param storage Glyph storage.
+ * \param adaptive Adaptive glyph.
+ * \param dropdowns Dropdowns to derive variants for.
+ */
+static void crunch_adaptive(GlyphStorage &storage, AdaptiveGlyph *adaptive, const std::vector<float> &dropdowns)
+{
+  bool parallel = (crunches_pending.load(boost::memory_order_relaxed) < thr::hardware_concurrency());
+  bool crunched = crunch_sizes(adaptive->m_current, adaptive->m_variants, dropdowns, parallel);
+
+  crunches_pending.fetch_sub(1, boost::memory_order_relaxed);
+
+  // Glyphs of a smaller precalc size are kept if a larger one fails, like when rendering fails.
+  if(!crunched)
+  {
+    prog::work_done(adaptive->m_cost * adaptive->m_current.size());
+    if(adaptive->m_previous.empty())
+    {
+      storage.missing(adaptive->m_unicode);
+      for(size_t ii = 1; (ii < adaptive->m_current.size() * dropdowns.size()); ++ii)
+      {
+        prog::item_skipped();
+      }
+    }
+    else
+    {
+      adaptive->accept(storage, true);
+    }
+    finish_adaptive(adaptive);
+    return;
+  }
+
+  if(adaptive->isConverged())
+  {
+    prog::work_done(adaptive->m_cost * adaptive->m_current.size());
+    adaptive->accept(storage, false);
+    finish_adaptive(adaptive);
+    return;
+  }
+
+  adaptive->advance();
+
+  boost::lock_guard<boost::mutex> lock(refine_mutex);
+  refine_queue.push_back(adaptive);
+  refine_cond.notify_all();
+}
+
+/** \brief Render an adaptive glyph at its current precalc size and dispatch crunching.
+ *
+ * \param storage Glyph storage.
+ * \param adaptive Adaptive glyph.
+ * \param target_sizes Target sizes, glyph is rendered once and crunched to each.
+ * \param dropdowns Dropdowns to derive variants for.
+ * \return True if rendered, false on error.
+ */
+static bool render_adaptive(GlyphStorage &storage, AdaptiveGlyph *adaptive,
+    const std::vector<unsigned> &target_sizes, const std::vector<float> &dropdowns)
+{
+  FtGlyph *gly = adaptive->m_face->renderGlyph(adaptive->m_unicode, target_sizes.front(), adaptive->m_size,
+      storage.getBitmapPool());
+  if(NULL == gly)
+  {
+    return false;
+  }
+
+  // Results of different precalc sizes are compared sample by sample.
+  gly->setOriginAligned();
+
+  adaptive->m_current.push_back(gly);
+  for(unsigned ii = 1; (ii < target_sizes.size()); ++ii)
+  {
+    adaptive->m_current.push_back(gly->clone(target_sizes[ii]));
+  }
+  adaptive->m_variants.resize(target_sizes.size());
+
+  crunches_pending.fetch_add(1, boost::memory_order_relaxed);
+  thr::dispatch_ordered(adaptive->getCurrentCost(), crunch_adaptive, boost::ref(storage), adaptive,
+      boost::cref(dropdowns));
+  return true;
+}
+
+/** \brief Get the precalc size adaptive glyphs start from.
+ *
+ * Halves the precalc size for as long as it stays large enough for the largest target size.
+ *
+ * \param size Largest precalc size.
+ * \param target_sizes Target sizes.
+ * \return Initial precalc size.
+ */
+static unsigned get_adaptive_start_size(unsigned size, const std::vector<unsigned> &target_sizes)
+{
+  unsigned min_size = *std::max_element(target_sizes.begin(), target_sizes.end()) * ADAPTIVE_MIN_SCALE;
+
+  while((size % 2 == 0) && (size / 2 >= min_size))
+  {
+    size /= 2;
+  }
+  return size;
+}
+
+/** \brief Compare glyph estimates, most expensive first.
+ *
+ * \param lhs Left-hand-side operand.
+ * \param rhs Right-hand-side operand.
+ * \return True if lhs should be queued before rhs.
+ */
+static bool estimate_before(const GlyphEstimate &lhs, const GlyphEstimate &rhs)
+{
+  if(lhs.first != rhs.first)
+  {
+    return (lhs.first > rhs.first);
+  }
+  return (lhs.second < rhs.second);
+}
+
 GlyphRange::GlyphRange(unsigned ps, unsigned pe) :
   m_enabled(false)
 {
@@ -30,23 +459,36 @@ void GlyphRange::add(unsigned ps, unsigned pe)
     std::swap(ps, pe);
   }
 
-  for(unsigned ii = ps; (ii <= pe); ++ii)
+  // Merge with a preceding interval that overlaps or touches the start.
+  container_type::iterator ii = m_range.upper_bound(ps);
+  if(m_range.begin() != ii)
+  {
+    container_type::iterator prev = ii;
+    --prev;
+
+    if((prev->second >= ps) || (prev->second + 1 == ps))
+    {
+      ps = prev->first;
+      pe = std::max(pe, prev->second);
+      ii = prev;
+    }
+  }
+
+  // Absorb all following intervals that overlap or touch the end.
+  while((m_range.end() != ii) && ((ii->first <= pe) || (ii->first - 1 == pe)))
   {
-    m_range.push_back(ii);
+    pe = std::max(pe, ii->second);
+    m_range.erase(ii++);
   }
 
-  this->sort();
+  m_range.insert(ii, container_type::value_type(ps, pe));
 }
 
-void GlyphRange::remove(unsigned op)
+void GlyphRange::add(const GlyphRange &op)
 {
-  for(std::vector<unsigned>::iterator ii = m_range.begin(), ee = m_range.end(); (ii != ee); ++ii)
+  BOOST_FOREACH(const container_type::value_type &vv, op.m_range)
   {
-    if((*ii) == op)
-    {
-      m_range.erase(ii);
-      return;
-    }
+    this->add(vv.first, vv.second);
   }
 }
 
@@ -57,67 +499,285 @@ void GlyphRange::remove(unsigned ps, unsigned pe)
     std::swap(ps, pe);
   }
 
-  for(std::vector<unsigned>::iterator ii = m_range.begin(), ee = m_range.end(); (ii != ee); ++ii)
+  // Start from the interval containing the start, if any.
+  container_type::iterator ii = m_range.upper_bound(ps);
+  if(m_range.begin() != ii)
   {
-    if((*ii) >= ps)
+    container_type::iterator prev = ii;
+    --prev;
+
+    if(prev->second >= ps)
     {
-      for(std::vector<unsigned>::iterator jj = ii; (jj != ee);)
-      {
-        std::vector<unsigned>::iterator kk = jj;
-        ++kk;
+      ii = prev;
+    }
+  }
+
+  while((m_range.end() != ii) && (ii->first <= pe))
+  {
+    unsigned interval_start = ii->first,
+             interval_end = ii->second;
 
-        if(pe < (*kk))
+    m_range.erase(ii++);
+
+    if(interval_start < ps)
+    {
+      m_range.insert(ii, container_type::value_type(interval_start, ps - 1));
+    }
+    if(interval_end > pe)
+    {
+      m_range.insert(ii, container_type::value_type(pe + 1, interval_end));
+      break;
+    }
+  }
+}
+
+void GlyphRange::remove(const GlyphRange &op)
+{
+  BOOST_FOREACH(const container_type::value_type &vv, op.m_range)
+  {
+    this->remove(vv.first, vv.second);
+  }
+}
+
+void GlyphRange::estimate(std::vector<GlyphEstimate> &dst, std::list<FtFaceSptr> &src) const
+{
+  if(!m_enabled)
+  {
+    return;
+  }
+
+  BOOST_FOREACH(const container_type::value_type &vv, m_range)
+  {
+    for(unsigned gidx = vv.first; ; ++gidx)
+    {
+      uint64_t cost = 0;
+
+      BOOST_FOREACH(FtFaceSptr &ii, src)
+      {
+        if(ii->hasGlyph(gidx))
         {
-          m_range.erase(ii, jj);
-          return;
+          cost = ii->estimateCost(gidx);
+          break;
         }
-        jj = kk;
       }
-      m_range.erase(ii, ee);
-      return;
+      dst.push_back(GlyphEstimate(cost, gidx));
+
+      if(gidx >= vv.second)
+      {
+        break;
+      }
     }
-  }    
+  }
 }
 
-unsigned GlyphRange::queue(GlyphStorage &storage, std::list<FtFaceSptr> &src, unsigned target_size) const
+void GlyphRange::measure(GlyphStorage &storage, std::list<FtFaceSptr> &src) const
 {
   if(!m_enabled)
   {
-    return false;
+    return;
   }
 
-  unsigned ret = 0;
-
-  BOOST_FOREACH(unsigned gidx, m_range)
+  BOOST_FOREACH(const container_type::value_type &vv, m_range)
   {
-    FtGlyph *gly = NULL;
-
-    if(storage.markGlyph(gidx))
+    for(unsigned gidx = vv.first; ; ++gidx)
     {
-      BOOST_FOREACH(FtFaceSptr &ii, src)
+      if(!storage.markGlyph(gidx))
+      {
+        // Already measured from another range.
+        prog::item_skipped();
+      }
+      else
       {
-        gly = ii->renderGlyph(gidx, target_size);
-        if(NULL != gly)
+        bool measured = false;
+
+        BOOST_FOREACH(FtFaceSptr &ii, src)
         {
-          storage.concurrencyIcrement();
-          thr::dispatch(crunch_glyph, boost::ref(storage), gly);
-          ++ret;
-          break;
+          unsigned rendered;
+
+          if(ii->findRendered(gidx, rendered))
+          {
+            storage.addAlias(rendered, gidx);
+            prog::item_skipped();
+            measured = true;
+            break;
+          }
+
+          // Aliases are decided here in order, only loading the glyph is spread over the workers.
+          if(ii->hasGlyph(gidx))
+          {
+            ii->markRendered(gidx);
+            thr::dispatch(measure_glyph, boost::ref(storage), boost::ref(*ii), gidx);
+            measured = true;
+            break;
+          }
+        }
+
+        if(!measured)
+        {
+          storage.missing(gidx);
         }
       }
+
+      if(gidx >= vv.second)
+      {
+        break;
+      }
+    }
+  }
+}
+
+unsigned GlyphRange::queue(GlyphStorage &storage, std::vector<GlyphEstimate> &glyphs, std::list<FtFaceSptr> &src,
+    const std::vector<unsigned> &target_sizes, const std::vector<float> &dropdowns)
+{
+  std::sort(glyphs.begin(), glyphs.end(), estimate_before);
+
+  {
+    uint64_t total = 0;
+    BOOST_FOREACH(const GlyphEstimate &vv, glyphs)
+    {
+      total += vv.first;
     }
+    prog::work_expected(total * target_sizes.size());
+  }
+
+  unsigned ret = 0;
 
-    if(NULL == gly)
+  BOOST_FOREACH(const GlyphEstimate &vv, glyphs)
+  {
+    if(queueGlyph(storage, src, target_sizes, dropdowns, vv.second, vv.first))
     {
-      storage.missing(gidx);
+      ++ret;
     }
+
+    // Refinements go first, they do not add to glyphs in flight.
+    refine(storage, target_sizes, dropdowns, false);
   }
 
   return ret;
 }
 
-void GlyphRange::sort()
+bool GlyphRange::queueGlyph(GlyphStorage &storage, std::list<FtFaceSptr> &src,
+    const std::vector<unsigned> &target_sizes, const std::vector<float> &dropdowns, unsigned op,
+    uint64_t cost)
 {
-  std::sort(m_range.begin(), m_range.end());
+  size_t variant_count = target_sizes.size() * dropdowns.size();
+
+  if(!storage.markGlyph(op))
+  {
+    prog::work_done(cost * target_sizes.size());
+    // Already rendered from another range.
+    for(size_t ii = 0; (ii < variant_count); ++ii)
+    {
+      prog::item_skipped();
+    }
+    return false;
+  }
+
+  BOOST_FOREACH(FtFaceSptr &ii, src)
+  {
+    unsigned rendered;
+
+    // Codepoints mapping to a glyph index already rendered from this face only add records for it.
+    if(ii->findRendered(op, rendered))
+    {
+      storage.addAlias(rendered, op);
+      prog::work_done(cost * target_sizes.size());
+      for(size_t jj = 0; (jj < variant_count); ++jj)
+      {
+        prog::item_skipped();
+      }
+      return true;
+    }
+
+    if(0.0f <= ii->getAdaptiveTolerance())
+    {
+      AdaptiveGlyph *adaptive = new AdaptiveGlyph(op, ii, get_adaptive_start_size(ii->getSize(), target_sizes),
+          cost);
+
+      {
+        boost::lock_guard<boost::mutex> lock(refine_mutex);
+        ++adaptive_active;
+      }
+      if(render_adaptive(storage, adaptive, target_sizes, dropdowns))
+      {
+        ii->markRendered(op);
+        return true;
+      }
+      finish_adaptive(adaptive);
+      continue;
+    }
+
+    FtGlyph *gly = ii->renderGlyph(op, target_sizes.front(), ii->getSize(), storage.getBitmapPool());
+    if(NULL != gly)
+    {
+      // All clones must be made before the first crunch releases the precalc bitmap.
+      std::vector<FtGlyph*> sized_glyphs(1, gly);
+      for(unsigned jj = 1; (jj < target_sizes.size()); ++jj)
+      {
+        sized_glyphs.push_back(gly->clone(target_sizes[jj]));
+      }
+
+      crunches_pending.fetch_add(1, boost::memory_order_relaxed);
+      thr::dispatch_ordered(cost, crunch_glyph, boost::ref(storage), sized_glyphs, boost::cref(dropdowns), cost);
+      ii->markRendered(op);
+      return true;
+    }
+  }
+
+  storage.missing(op);
+  prog::work_done(cost * target_sizes.size());
+  for(size_t ii = 1; (ii < variant_count); ++ii)
+  {
+    prog::item_skipped();
+  }
+  return false;
+}
+
+void GlyphRange::refine(GlyphStorage &storage, const std::vector<unsigned> &target_sizes,
+    const std::vector<float> &dropdowns, bool wait)
+{
+  for(;;)
+  {
+    AdaptiveGlyph *adaptive;
+    {
+      boost::unique_lock<boost::mutex> lock(refine_mutex);
+
+      while(refine_queue.empty())
+      {
+        if(!wait || (0 >= adaptive_active))
+        {
+          return;
+        }
+        refine_cond.wait(lock);
+      }
+
+      adaptive = refine_queue.front();
+      refine_queue.pop_front();
+    }
+
+    // Glyph was rendered fine at a smaller size, keep that if a larger one fails.
+    if(!render_adaptive(storage, adaptive, target_sizes, dropdowns))
+    {
+      prog::work_done(adaptive->m_cost * target_sizes.size());
+      adaptive->accept(storage, true);
+      finish_adaptive(adaptive);
+    }
+  }
 }
 
+unsigned GlyphRange::size() const
+{
+  if(!m_enabled)
+  {
+    return 0;
+  }
+
+  unsigned ret = 0;
+
+  BOOST_FOREACH(const container_type::value_type &vv, m_range)
+  {
+    ret += vv.second - vv.first + 1;
+  }
+
+  return ret;
+}
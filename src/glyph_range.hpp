@@ -4,17 +4,32 @@
 #include "ft_face.hpp"
 
 #include <list>
+#include <map>
+#include <vector>
 
 // Forward declaration.
 class GlyphStorage;
 
+/** Convenience typedef, estimated cost of crunching a glyph and its unicode number. */
+typedef std::pair<uint64_t, unsigned> GlyphEstimate;
+
 /** \brief Class representing glyph range.
+ *
+ * Stored as a sorted set of disjoint, non-adjacent closed intervals. Adding and removing are logarithmic in the
+ * number of intervals regardless of how many characters they cover.
  */
 class GlyphRange
 {
+  public:
+    /** Convenience typedef, maps interval start to interval end (inclusive). */
+    typedef std::map<unsigned, unsigned> container_type;
+
+    /** Iterator type. */
+    typedef container_type::const_iterator const_iterator;
+
   private:
-    /** Range. */
-    std::vector<unsigned> m_range;
+    /** Intervals. */
+    container_type m_range;
 
     /** Allowed to render? */
     bool m_enabled;
@@ -35,9 +50,22 @@ class GlyphRange
     GlyphRange(unsigned ps, unsigned pe);
 
   private:
-    /** \brief Sort the contents of range vector.
+    /** \brief Queue one glyph.
+     *
+     * Glyphs mapping to a glyph index already queued from the same face are not rendered, they are stored as
+     * aliases of the glyph queued.
+     *
+     * \param storage Glyph storage.
+     * \param src Font list.
+     * \param target_sizes Target sizes, glyph is rendered once and crunched to each.
+     * \param dropdowns Dropdowns, largest first, variants are quantized from the same distances.
+     * \param op Unicode number of glyph.
+     * \param cost Estimated cost of crunching the glyph to one target size.
+     * \return True if glyph was queued, false if not.
      */
-    void sort();
+    static bool queueGlyph(GlyphStorage &storage, std::list<FtFaceSptr> &src,
+        const std::vector<unsigned> &target_sizes, const std::vector<float> &dropdowns, unsigned op,
+        uint64_t cost);
 
   public:
     /** \brief Add a range.
@@ -47,11 +75,13 @@ class GlyphRange
      */
     void add(unsigned ps, unsigned pe);
 
-    /** \brief Remove a single character.
+    /** \brief Add all characters in another range (union).
      *
-     * \param op Character to remove.
+     * Enabled state of this range is not changed.
+     *
+     * \param op Range to add.
      */
-    void remove(unsigned op);
+    void add(const GlyphRange &op);
 
     /** \brief Remove a range.
      *
@@ -60,14 +90,67 @@ class GlyphRange
      */
     void remove(unsigned ps, unsigned pe);
 
-    /** \brief Render this range.
+    /** \brief Remove all characters in another range (difference).
+     *
+     * Enabled state of this range is not changed.
+     *
+     * \param op Range to remove.
+     */
+    void remove(const GlyphRange &op);
+
+    /** \brief Estimate the cost of crunching every glyph in this range.
+     *
+     * Cost of a glyph is estimated from the first face that has it.
+     *
+     * \param dst Estimates are appended here.
+     * \param src Font list.
+     */
+    void estimate(std::vector<GlyphEstimate> &dst, std::list<FtFaceSptr> &src) const;
+
+    /** \brief Measure the metrics of every glyph in this range without rendering.
+     *
+     * Glyphs mapping to a glyph index already measured from the same face are stored as aliases. Glyphs are
+     * measured by dispatched jobs, they are only in the storage once all jobs are done.
+     *
+     * \param storage Glyph storage.
+     * \param src Font list.
+     */
+    void measure(GlyphStorage &storage, std::list<FtFaceSptr> &src) const;
+
+    /** \brief Render estimated glyphs.
+     *
+     * Glyphs are queued most expensive first, so crunching does not end with a few large glyphs keeping only a
+     * few workers busy. Glyphs of equal cost are queued in unicode order.
      *
-     * \param dst Target glyph list.
+     * \param storage Glyph storage.
+     * \param glyphs Glyph estimates, will be sorted.
      * \param src Font list.
-     * \param target_size Target render size.
+     * \param target_sizes Target sizes, every glyph is rendered once and crunched to each.
+     * \param dropdowns Dropdowns, largest first, variants are quantized from the same distances.
      * \return Number of glyphs queued.
      */
-    unsigned queue(GlyphStorage &storage, std::list<FtFaceSptr> &src, unsigned target_size) const;
+    static unsigned queue(GlyphStorage &storage, std::vector<GlyphEstimate> &glyphs, std::list<FtFaceSptr> &src,
+        const std::vector<unsigned> &target_sizes, const std::vector<float> &dropdowns);
+
+    /** \brief Render glyphs waiting to be refined at a larger precalc size.
+     *
+     * Glyphs of faces with an adaptive precalc size start at a small precalc size. Whenever the crunched result
+     * still changes too much from the previous precalc size, the glyph is queued to be rendered at twice the
+     * size. Rendering always happens in the queueing thread, so only it ever blocks on the bitmap pool.
+     *
+     * \param storage Glyph storage.
+     * \param target_sizes Target sizes, every glyph is rendered once and crunched to each.
+     * \param dropdowns Dropdowns, largest first, variants are quantized from the same distances.
+     * \param wait Keep rendering until no glyph may need refining anymore.
+     */
+    static void refine(GlyphStorage &storage, const std::vector<unsigned> &target_sizes,
+        const std::vector<float> &dropdowns, bool wait);
+
+    /** \brief Get the number of characters this range would queue.
+     *
+     * \return Number of characters, 0 if disabled.
+     */
+    unsigned size() const;
 
   public:
     /** \brief Add a single character.
@@ -76,9 +159,34 @@ class GlyphRange
      */
     inline void add(unsigned op)
     {
-      m_range.push_back(op);
+      this->add(op, op);
+    }
+
+    /** \brief Remove a single character.
+     *
+     * \param op Character to remove.
+     */
+    inline void remove(unsigned op)
+    {
+      this->remove(op, op);
+    }
+
+    /** \brief Iterator to first interval.
+     *
+     * \return Iterator to begin.
+     */
+    inline const_iterator begin() const
+    {
+      return m_range.begin();
+    }
 
-      this->sort();
+    /** \brief Iterator to end of intervals.
+     *
+     * \return Iterator to end.
+     */
+    inline const_iterator end() const
+    {
+      return m_range.end();
     }
 
     /** \brief Allow this set.
@@ -106,4 +214,3 @@ class GlyphRange
 };
 
 #endif
-
@@ -0,0 +1,283 @@
+#include "glyph_runs.hpp"
+
+#include "ft_library.hpp"
+
+#include FT_OUTLINE_H
+
+/** \brief Collects spans at or above half coverage into runs on every row.
+ */
+class SpanCollector
+{
+  private:
+    /** Height in pixels. */
+    int m_rows;
+
+    /** Interleaved first and one past last X coordinates of runs of every row. */
+    std::vector<std::vector<int> > m_runs;
+
+  public:
+    /** \brief Constructor.
+     *
+     * \param prows Height in pixels.
+     */
+    SpanCollector(unsigned prows) :
+      m_rows(static_cast<int>(prows)),
+      m_runs(prows) { }
+
+  public:
+    /** \brief Add spans of one row.
+     *
+     * \param y Y coordinate from the bottom.
+     * \param count Number of spans.
+     * \param spans Spans.
+     */
+    void add(int y, int count, const FT_Span *spans)
+    {
+      int row = m_rows - 1 - y;
+
+      if((0 > row) || (m_rows <= row))
+      {
+        return;
+      }
+
+      std::vector<int> &runs = m_runs[static_cast<unsigned>(row)];
+
+      for(int ii = 0; (ii < count); ++ii)
+      {
+        const FT_Span &span = spans[ii];
+        int start = span.x;
+        int end = span.x + span.len;
+
+        if(127 >= span.coverage)
+        {
+          continue;
+        }
+
+        // Spans come in order, neighboring spans merge into one run.
+        if(!runs.empty() && (runs.back() == start))
+        {
+          runs.back() = end;
+        }
+        else
+        {
+          runs.push_back(start);
+          runs.push_back(end);
+        }
+      }
+    }
+
+    /** \brief Get runs of a row.
+     *
+     * \param op Row.
+     * \return Interleaved first and one past last X coordinates of runs.
+     */
+    std::vector<int>& getRuns(unsigned op)
+    {
+      return m_runs[op];
+    }
+};
+
+/** \brief Span callback for the rasterizer.
+ *
+ * \param y Y coordinate from the bottom.
+ * \param count Number of spans.
+ * \param spans Spans.
+ * \param user Span collector.
+ */
+static void collect_spans(int y, int count, const FT_Span *spans, void *user)
+{
+  static_cast<SpanCollector*>(user)->add(y, count, spans);
+}
+
+/** \brief Sort runs of a row if they did not come in order.
+ *
+ * \param runs Interleaved first and one past last X coordinates of runs.
+ */
+static void sort_runs(std::vector<int> &runs)
+{
+  bool sorted = true;
+
+  for(unsigned ii = 2; (ii < runs.size()); ii += 2)
+  {
+    if(runs[ii] <= runs[ii - 1])
+    {
+      sorted = false;
+      break;
+    }
+  }
+
+  if(sorted)
+  {
+    return;
+  }
+
+  std::vector<std::pair<int, int> > pairs;
+  for(unsigned ii = 0; (ii < runs.size()); ii += 2)
+  {
+    pairs.push_back(std::make_pair(runs[ii], runs[ii + 1]));
+  }
+  std::sort(pairs.begin(), pairs.end());
+
+  runs.clear();
+  for(unsigned ii = 0; (ii < pairs.size()); ++ii)
+  {
+    if(!runs.empty() && (runs.back() >= pairs[ii].first))
+    {
+      runs.back() = std::max(runs.back(), pairs[ii].second);
+    }
+    else
+    {
+      runs.push_back(pairs[ii].first);
+      runs.push_back(pairs[ii].second);
+    }
+  }
+}
+
+GlyphRuns::GlyphRuns(unsigned pwidth, unsigned prows) :
+  m_width(pwidth),
+  m_rows(prows),
+  m_first(prows + 1, 0) { }
+
+bool GlyphRuns::getBounds(int &x1, int &y1, int &x2, int &y2) const
+{
+  x1 = static_cast<int>(m_width);
+  y1 = static_cast<int>(m_rows);
+  x2 = -1;
+  y2 = -1;
+
+  for(unsigned ii = 0; (ii < m_rows); ++ii)
+  {
+    unsigned first = m_first[ii];
+    unsigned last = m_first[ii + 1];
+
+    if(first < last)
+    {
+      int row = static_cast<int>(ii);
+
+      x1 = std::min(x1, m_runs[first * 2]);
+      x2 = std::max(x2, m_runs[last * 2 - 1] - 1);
+      y1 = std::min(y1, row);
+      y2 = std::max(y2, row);
+    }
+  }
+
+  return (0 <= x2);
+}
+
+unsigned GlyphRuns::findRun(unsigned row, int px) const
+{
+  unsigned first = m_first[row];
+  unsigned last = m_first[row + 1];
+
+  // Binary search for the first run ending after the coordinate.
+  while(first < last)
+  {
+    unsigned mid = first + (last - first) / 2;
+
+    if(m_runs[mid * 2 + 1] <= px)
+    {
+      first = mid + 1;
+    }
+    else
+    {
+      last = mid;
+    }
+  }
+
+  return first;
+}
+
+int GlyphRuns::getRowDistance(int px, int py, int limit, bool inside) const
+{
+  if((0 > py) || (static_cast<int>(m_rows) <= py))
+  {
+    return inside ? 0 : limit;
+  }
+
+  unsigned row = static_cast<unsigned>(py);
+  unsigned idx = findRun(row, px);
+  bool in_run = (idx < m_first[row + 1]) && (m_runs[idx * 2] <= px);
+  int ret = limit;
+
+  if(inside)
+  {
+    // Closest empty pixels are just outside the run, everything outside is empty.
+    if(in_run)
+    {
+      ret = std::min(ret, std::min(m_runs[idx * 2 + 1] - px, px - m_runs[idx * 2] + 1));
+    }
+    else
+    {
+      ret = 0;
+    }
+  }
+  else
+  {
+    // Closest set pixels are at the ends of runs on either side.
+    if(in_run)
+    {
+      ret = 0;
+    }
+    else
+    {
+      if(idx < m_first[row + 1])
+      {
+        ret = std::min(ret, m_runs[idx * 2] - px);
+      }
+      if(idx > m_first[row])
+      {
+        ret = std::min(ret, px - (m_runs[idx * 2 - 1] - 1));
+      }
+    }
+  }
+
+  return ret;
+}
+
+bool GlyphRuns::isSet(int px, int py) const
+{
+  if((0 > py) || (static_cast<int>(m_rows) <= py))
+  {
+    return false;
+  }
+
+  unsigned row = static_cast<unsigned>(py);
+  unsigned idx = findRun(row, px);
+
+  return (idx < m_first[row + 1]) && (m_runs[idx * 2] <= px);
+}
+
+bool GlyphRuns::render(FT_Outline *outline)
+{
+  SpanCollector collector(m_rows);
+  FT_Raster_Params params;
+
+  memset(&params, 0, sizeof(params));
+  params.source = outline;
+  params.flags = FT_RASTER_FLAG_AA | FT_RASTER_FLAG_DIRECT | FT_RASTER_FLAG_CLIP;
+  params.gray_spans = collect_spans;
+  params.user = &collector;
+  params.clip_box.xMin = 0;
+  params.clip_box.yMin = 0;
+  params.clip_box.xMax = static_cast<FT_Pos>(m_width);
+  params.clip_box.yMax = static_cast<FT_Pos>(m_rows);
+
+  if(FT_Outline_Render(FtLibrary::get(), outline, &params))
+  {
+    return false;
+  }
+
+  m_runs.clear();
+  for(unsigned ii = 0; (ii < m_rows); ++ii)
+  {
+    std::vector<int> &runs = collector.getRuns(ii);
+
+    sort_runs(runs);
+
+    m_first[ii] = static_cast<unsigned>(m_runs.size() / 2);
+    m_runs.insert(m_runs.end(), runs.begin(), runs.end());
+  }
+  m_first[m_rows] = static_cast<unsigned>(m_runs.size() / 2);
+
+  return true;
+}
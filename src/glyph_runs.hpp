@@ -0,0 +1,114 @@
+#ifndef GLYPH_RUNS_HPP
+#define GLYPH_RUNS_HPP
+
+#include "defaults.hpp"
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+
+#include <vector>
+
+/** \brief Glyph rendered as runs of set pixels on every row.
+ *
+ * Pixels are set at or above half coverage, exactly like in a bitmap rendered from the same outline. Memory
+ * taken is proportional to the number of edges instead of area.
+ */
+class GlyphRuns : public boost::noncopyable
+{
+  private:
+    /** Width in pixels. */
+    unsigned m_width;
+
+    /** Height in pixels. */
+    unsigned m_rows;
+
+    /** Index of the first run of every row and one past the last row. */
+    std::vector<unsigned> m_first;
+
+    /** Interleaved first and one past last X coordinate of runs in row order, top row first. */
+    std::vector<int> m_runs;
+
+  public:
+    /** \brief Constructor.
+     *
+     * Nothing is set until an outline is rendered.
+     *
+     * \param pwidth Width in pixels.
+     * \param prows Height in pixels.
+     */
+    GlyphRuns(unsigned pwidth, unsigned prows);
+
+  private:
+    /** \brief Find the run ending after a coordinate.
+     *
+     * \param row Row.
+     * \param px X coordinate.
+     * \return Index of the first run on the row ending after the coordinate, end of row if none.
+     */
+    unsigned findRun(unsigned row, int px) const;
+
+  public:
+    /** \brief Find the bounds of set pixels.
+     *
+     * \param x1 Leftmost set column.
+     * \param y1 Topmost set row.
+     * \param x2 Rightmost set column.
+     * \param y2 Bottommost set row.
+     * \return True if any pixel was set, false otherwise.
+     */
+    bool getBounds(int &x1, int &y1, int &x2, int &y2) const;
+
+    /** \brief Find the horizontal distance to the closest pixel of opposite value on a row.
+     *
+     * Everything outside is empty.
+     *
+     * \param px X coordinate.
+     * \param py Y coordinate of the row.
+     * \param limit Horizontal distance to stop searching at.
+     * \param inside Value of the pixel searched from.
+     * \return Horizontal distance, limit if nothing closer was found.
+     */
+    int getRowDistance(int px, int py, int limit, bool inside) const;
+
+    /** \brief Tell if a pixel is set.
+     *
+     * \param px X coordinate.
+     * \param py Y coordinate.
+     * \return True if set, false if not or outside.
+     */
+    bool isSet(int px, int py) const;
+
+    /** \brief Render an outline.
+     *
+     * Coverage is collected as spans straight from the rasterizer, no bitmap is rendered. Parts of the outline
+     * outside the size are clipped.
+     *
+     * \param outline Outline to render, lower left corner of the size at origin.
+     * \return True on success, false on error.
+     */
+    bool render(FT_Outline *outline);
+
+  public:
+    /** \brief Get height.
+     *
+     * \return Height in pixels.
+     */
+    inline unsigned getRows() const
+    {
+      return m_rows;
+    }
+
+    /** \brief Get width.
+     *
+     * \return Width in pixels.
+     */
+    inline unsigned getWidth() const
+    {
+      return m_width;
+    }
+};
+
+/** Convenience typedef. */
+typedef boost::shared_ptr<GlyphRuns> GlyphRunsSptr;
+
+#endif
@@ -1,10 +1,13 @@
 #include "glyph_storage.hpp"
 
-#include "thr/generic.hpp"
+#include "prog/progress.hpp"
 
-extern bool g_verbose;
+#include <boost/functional/hash.hpp>
 
 /** \brief Compare two contained glyphs.
+ *
+ * Glyphs are added in the order they finish crunching, so ties are broken all the way down to the unicode
+ * number and variant. The order never depends on thread timing.
  *
  * \param lhs Left-hand-side operand.
  * \param rhs Right-hand-side operand.
@@ -26,109 +29,296 @@ static bool ft_glyph_sptr_less(const FtGlyphSptr &lhs, const FtGlyphSptr &rhs)
            rw = rhs->getCrunchedHeight();
 
   // Notice that even though this is 'less', we're actually sorting biggest-first.
-  if(lw > rw)
+  if(lw != rw)
   {
-    return true;
+    return (lw > rw);
   }
-  else if(lw == rw)
+
+  unsigned lwidth = lhs->getCrunchedWidth(),
+           rwidth = rhs->getCrunchedWidth();
+
+  if(lwidth != rwidth)
   {
-    if(lhs->getCrunchedWidth() > rhs->getCrunchedWidth())
-    {
-      return true;
-    }
+    return (lwidth > rwidth);
+  }
+  if(lhs->getUnicode() != rhs->getUnicode())
+  {
+    return (lhs->getUnicode() < rhs->getUnicode());
   }
-  return false;
+  if(lhs->getTargetSize() != rhs->getTargetSize())
+  {
+    return (lhs->getTargetSize() > rhs->getTargetSize());
+  }
+  return (lhs->getDropdown() > rhs->getDropdown());
+}
+
+/** \brief Shard cleanup function.
+ *
+ * Shards are owned by the storage, not the thread, so nothing is done when a thread exits.
+ *
+ * \param op Shard container.
+ */
+static void shard_cleanup(std::vector<FtGlyphSptr> *op)
+{
+  boost::ignore_unused_variable_warning(op);
+}
+
+/** \brief Hash a crunched bitmap.
+ *
+ * \param op Glyph with a crunched bitmap.
+ * \return Hash of dimensions and contents.
+ */
+static size_t hash_crunched(const FtGlyph &op)
+{
+  const uint8_t *data = op.getCrunched();
+  size_t ret = 0;
+
+  boost::hash_combine(ret, op.getCrunchedWidth());
+  boost::hash_combine(ret, op.getCrunchedHeight());
+  boost::hash_combine(ret, op.getChannels());
+  boost::hash_range(ret, data, data + op.getCrunchedWidth() * op.getCrunchedHeight() * op.getChannels());
+  return ret;
+}
+
+/** \brief Tell if two glyphs have identical crunched bitmaps.
+ *
+ * \param lhs Left-hand-side operand.
+ * \param rhs Right-hand-side operand.
+ * \return True if yes, false if no.
+ */
+static bool crunched_equal(const FtGlyph &lhs, const FtGlyph &rhs)
+{
+  return (lhs.getCrunchedWidth() == rhs.getCrunchedWidth()) &&
+    (lhs.getCrunchedHeight() == rhs.getCrunchedHeight()) &&
+    (lhs.getChannels() == rhs.getChannels()) &&
+    (0 == memcmp(lhs.getCrunched(), rhs.getCrunched(),
+                 lhs.getCrunchedWidth() * lhs.getCrunchedHeight() * lhs.getChannels()));
 }
 
 GlyphStorage::GlyphStorage() :
-  m_glyphs_in_flight(0),
-  m_failure_pending(false)
+  m_glyph_guard(new guard_word_type[CODEPOINT_COUNT / 32]),
+  m_shard(shard_cleanup),
+  m_pool(DEFAULT_MEMORY_LIMIT)
 {
-  // At least one glyph waiting for every thread at practically all times.
-  m_concurrency = thr::hardware_concurrency() * 2;
+  for(unsigned ii = 0; (ii < CODEPOINT_COUNT / 32); ++ii)
+  {
+    m_glyph_guard[ii].store(0, boost::memory_order_relaxed);
+  }
 }
 
 void GlyphStorage::add(FtGlyph *op)
 {
-  boost::mutex::scoped_lock scope(m_mutex);
-
-  std::map<unsigned, bool>::iterator iter = m_glyph_guard.find(op->getUnicode());
-  if(m_glyph_guard.end() == iter)
+  if(!this->isMarked(op->getUnicode()))
   {
     std::ostringstream sstr;
     sstr << "trying to add glyph " << op->getUnicode() << " that has not been marked for rendering";
     BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
   }
 
-  m_glyphs.push_back(boost::shared_ptr<FtGlyph>(op));
-
-  this->concurrencyDecrement();
-
-  if(g_verbose)
+  BOOST_FOREACH(const GlyphLayoutSptr &vv, m_layouts)
   {
-    if(m_failure_pending)
+    if(vv->accepts(*op))
     {
-      std::cerr << std::endl;
-      std::cerr.flush();
-
-      m_failure_pending = false;
+      vv->place(*op);
+      break;
     }
+  }
+
+  this->getShard().push_back(boost::shared_ptr<FtGlyph>(op));
 
-    std::cout << *op;
-    std::cout.flush();
+  if(prog::is_dumping_items())
+  {
+    std::ostringstream sstr;
+    sstr << *op;
+    prog::item_done(sstr.str());
+  }
+  else
+  {
+    prog::item_done();
   }
 }
 
-void GlyphStorage::concurrencyDecrement()
+void GlyphStorage::addLayout(const GlyphLayoutSptr &op)
 {
-  --m_glyphs_in_flight;
-  m_cond.notify_one();
+  m_layouts.push_back(op);
 }
 
-void GlyphStorage::concurrencyIcrement()
+void GlyphStorage::addAlias(unsigned rendered, unsigned op)
 {
   boost::mutex::scoped_lock scope(m_mutex);
 
-  while(m_glyphs_in_flight >= m_concurrency)
+  m_aliases[rendered].push_back(op);
+}
+
+void GlyphStorage::dedupe(GlyphLayout *layout)
+{
+  this->merge();
+
+  std::multimap<size_t, const FtGlyph*> hashes;
+  container_type ordered;
+  container_type remaining;
+
+  // Glyphs copied into pages are kept first, order is otherwise unchanged so the choice is always the same.
+  if(NULL != layout)
   {
-    m_cond.wait(scope);
+    BOOST_FOREACH(const FtGlyphSptr &vv, m_glyphs)
+    {
+      if(layout->isPlaced(*vv))
+      {
+        ordered.push_back(vv);
+      }
+    }
+    BOOST_FOREACH(const FtGlyphSptr &vv, m_glyphs)
+    {
+      if(!layout->isPlaced(*vv))
+      {
+        ordered.push_back(vv);
+      }
+    }
+  }
+  else
+  {
+    ordered.swap(m_glyphs);
   }
 
-  ++m_glyphs_in_flight;
+  BOOST_FOREACH(const FtGlyphSptr &vv, ordered)
+  {
+    if(NULL == vv->getCrunched())
+    {
+      remaining.push_back(vv);
+      continue;
+    }
+
+    size_t hash = hash_crunched(*vv);
+    std::pair<std::multimap<size_t, const FtGlyph*>::iterator, std::multimap<size_t, const FtGlyph*>::iterator>
+      range = hashes.equal_range(hash);
+    const FtGlyph *original = NULL;
+
+    for(; (range.first != range.second); ++range.first)
+    {
+      if(crunched_equal(*(range.first->second), *vv))
+      {
+        original = range.first->second;
+        break;
+      }
+    }
+
+    if(NULL != original)
+    {
+      if(NULL != layout)
+      {
+        layout->release(*vv);
+      }
+      m_duplicates.insert(std::make_pair(original, vv));
+    }
+    else
+    {
+      hashes.insert(std::make_pair(hash, vv.get()));
+      remaining.push_back(vv);
+    }
+  }
+
+  m_glyphs.swap(remaining);
 }
 
-bool GlyphStorage::markGlyph(unsigned op)
+void GlyphStorage::extract(GlyphStorage &dst, unsigned target_size, float dropdown)
 {
-  boost::mutex::scoped_lock scope(m_mutex);
+  this->merge();
+
+  dst.m_aliases = m_aliases;
+
+  container_type remaining;
 
-  if(m_glyph_guard.end() == m_glyph_guard.find(op))
+  BOOST_FOREACH(const FtGlyphSptr &vv, m_glyphs)
   {
-    m_glyph_guard[op] = true;
-    return true;
+    if((vv->getTargetSize() == target_size) && (vv->getDropdown() == dropdown))
+    {
+      dst.m_glyphs.push_back(vv);
+    }
+    else
+    {
+      remaining.push_back(vv);
+    }
   }
-  return false;
+
+  m_glyphs.swap(remaining);
 }
 
-void GlyphStorage::missing(unsigned op)
+GlyphLayout* GlyphStorage::findLayout(unsigned target_size, float dropdown) const
 {
-  if(g_verbose)
+  BOOST_FOREACH(const GlyphLayoutSptr &vv, m_layouts)
   {
-    boost::mutex::scoped_lock scope(m_mutex);
+    if((vv->getTargetSize() == target_size) && (vv->getDropdown() == dropdown))
+    {
+      return vv.get();
+    }
+  }
+  return NULL;
+}
+
+GlyphStorage::container_type& GlyphStorage::getShard()
+{
+  container_type *ret = m_shard.get();
+
+  if(NULL == ret)
+  {
+    container_sptr shard(new container_type());
 
-    if(!m_failure_pending)
     {
-      std::cerr << "Failed:";
+      boost::mutex::scoped_lock scope(m_mutex);
 
-      m_failure_pending = true;
+      m_shards.push_back(shard);
     }
 
-    std::cerr << ' ' << op;
-    std::cerr.flush();
+    ret = shard.get();
+    m_shard.reset(ret);
+  }
+
+  return *ret;
+}
+
+bool GlyphStorage::isMarked(unsigned op) const
+{
+  if(op >= CODEPOINT_COUNT)
+  {
+    return false;
+  }
+
+  return (0 != (m_glyph_guard[op >> 5].load(boost::memory_order_acquire) & (1u << (op & 31))));
+}
+
+bool GlyphStorage::markGlyph(unsigned op)
+{
+  if(op >= CODEPOINT_COUNT)
+  {
+    return false;
+  }
+
+  uint32_t bit = 1u << (op & 31);
+
+  return (0 == (m_glyph_guard[op >> 5].fetch_or(bit, boost::memory_order_acq_rel) & bit));
+}
+
+void GlyphStorage::merge()
+{
+  boost::mutex::scoped_lock scope(m_mutex);
+
+  BOOST_FOREACH(container_sptr &vv, m_shards)
+  {
+    m_glyphs.insert(m_glyphs.end(), vv->begin(), vv->end());
+    vv->clear();
   }
 }
 
+void GlyphStorage::missing(unsigned op)
+{
+  prog::item_failed(op);
+}
+
 void GlyphStorage::sort()
 {
+  this->merge();
+
   std::sort(m_glyphs.begin(), m_glyphs.end(), ft_glyph_sptr_less);
 }
 
@@ -150,3 +340,35 @@ void GlyphStorage::trim()
   m_glyphs.resize(glyphs_remaining);
 }
 
+
+void GlyphStorage::write(FtGlyph &op, FILE *fptr, bool glst)
+{
+  op.write(fptr, glst);
+  this->writeAliases(op, fptr, glst);
+
+  std::pair<std::multimap<const FtGlyph*, FtGlyphSptr>::iterator,
+    std::multimap<const FtGlyph*, FtGlyphSptr>::iterator> range = m_duplicates.equal_range(&op);
+
+  for(std::multimap<const FtGlyph*, FtGlyphSptr>::iterator ii = range.first; (ii != range.second); ++ii)
+  {
+    FtGlyph &duplicate = *(ii->second);
+
+    duplicate.setTexture(op);
+    duplicate.write(fptr, glst);
+    this->writeAliases(duplicate, fptr, glst);
+  }
+  m_duplicates.erase(range.first, range.second);
+}
+
+void GlyphStorage::writeAliases(FtGlyph &op, FILE *fptr, bool glst)
+{
+  std::map<unsigned, std::vector<unsigned> >::const_iterator iter = m_aliases.find(op.getUnicode());
+
+  if(m_aliases.end() != iter)
+  {
+    BOOST_FOREACH(unsigned vv, iter->second)
+    {
+      op.write(fptr, glst, vv);
+    }
+  }
+}
@@ -1,10 +1,15 @@
 #ifndef GLYPH_STORAGE_HPP
 #define GLYPH_STORAGE_HPP
 
+#include "bitmap_pool.hpp"
 #include "ft_glyph.hpp"
+#include "glyph_layout.hpp"
 
-#include <boost/thread/condition_variable.hpp>
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/tss.hpp>
 
+#include <map>
 #include <vector>
 
 /** \brief Storage for glyphs.
@@ -15,6 +20,12 @@ class GlyphStorage
     /** Convenience typedef. */
     typedef std::vector<FtGlyphSptr> container_type;
 
+    /** Convenience typedef. */
+    typedef boost::shared_ptr<container_type> container_sptr;
+
+    /** Convenience typedef. */
+    typedef boost::atomic<uint32_t> guard_word_type;
+
   public:
     /** Iterator type. */
     typedef container_type::iterator iterator;
@@ -22,27 +33,40 @@ class GlyphStorage
     /** Iterator type. */
     typedef container_type::const_iterator const_iterator;
 
+  public:
+    /** Default memory budget for precalc bitmaps in flight (in bytes). */
+    static const size_t DEFAULT_MEMORY_LIMIT = static_cast<size_t>(1024) * 1024 * 1024;
+
+    /** Size of the unicode codepoint space. */
+    static const unsigned CODEPOINT_COUNT = 0x110000;
+
   private:
     /** Glyph container. */
     container_type m_glyphs;
 
-    /** Glyph rendering guard. */
-    std::map<unsigned, bool> m_glyph_guard;
+    /** Glyph rendering guard, one bit per codepoint. */
+    boost::scoped_array<guard_word_type> m_glyph_guard;
 
-    /** Cond. */
-    boost::condition_variable m_cond;
+    /** Per-thread result shards, merged into the glyph container before sorting. */
+    std::vector<container_sptr> m_shards;
 
-    /** Guard. */
-    boost::mutex m_mutex;
+    /** Result shard of the current thread. */
+    boost::thread_specific_ptr<container_type> m_shard;
+
+    /** Precalc bitmap buffers, also limits the number of glyphs 'in flight'. */
+    BitmapPool m_pool;
 
-    /** Number of glyphs 'in flight'. */
-    unsigned m_glyphs_in_flight;
+    /** Unicode numbers written as aliases of a rendered glyph, by the unicode number of the rendered glyph. */
+    std::map<unsigned, std::vector<unsigned> > m_aliases;
 
-    /** Maximum number of glyphs 'in flight'. */
-    unsigned m_concurrency;
+    /** Glyphs with a crunched bitmap identical to a glyph still to be fitted, by that glyph. */
+    std::multimap<const FtGlyph*, FtGlyphSptr> m_duplicates;
 
-    /** Reported failures pending? */
-    bool m_failure_pending;
+    /** Layouts glyphs are copied into as they are added. */
+    std::vector<GlyphLayoutSptr> m_layouts;
+
+    /** Guard for shard registration and aliases. */
+    boost::mutex m_mutex;
 
   public:
     /** \brief Iterator to begin.
@@ -106,28 +130,101 @@ class GlyphStorage
     ~GlyphStorage() { }
 
   private:
-    /** \brief Decrement number of glyphs 'in flight'.
+    /** \brief Get the result shard of the current thread.
      *
-     * Must be called from a locked context.
+     * Registers a new shard on first call from a thread.
+     *
+     * \return Shard container.
      */
-    void concurrencyDecrement();
+    container_type& getShard();
+
+    /** \brief Tell if a glyph has been marked for rendering.
+     *
+     * \param op Unicode number of glyph.
+     * \return True if yes, false if no.
+     */
+    bool isMarked(unsigned op) const;
+
+    /** \brief Merge all per-thread shards into the glyph container.
+     */
+    void merge();
+
+  private:
+    /** \brief Write records of all aliases of a glyph.
+     *
+     * \param op Glyph written.
+     * \param fptr FILE pointer.
+     * \param glst Use OpenGL texture coordinates (as opposed to DirectX).
+     */
+    void writeAliases(FtGlyph &op, FILE *fptr, bool glst);
 
   public:
     /** \brief Add a glyph to the storage.
+     *
+     * May be called concurrently from any thread, glyphs are collected into per-thread shards. Glyphs of a target
+     * size and dropdown that has a layout are copied into their pages right away.
      *
      * \param op Glyph to add.
      */
     void add(FtGlyph *op);
 
-    /** \brief Increment number of glyphs 'in flight'.
+    /** \brief Add a layout.
+     *
+     * Must not be called while glyphs are being added.
+     *
+     * \param op Layout.
+     */
+    void addLayout(const GlyphLayoutSptr &op);
+
+    /** \brief Add an alias for a glyph.
+     *
+     * Alias is written as a record of its own sharing everything with the glyph but the unicode number. Aliases
+     * apply to all target sizes and dropdowns.
+     *
+     * \param rendered Unicode number of the glyph rendered.
+     * \param op Unicode number of the alias.
+     */
+    void addAlias(unsigned rendered, unsigned op);
+
+    /** \brief Move glyphs with crunched bitmaps identical to another glyph out of the storage.
+     *
+     * Glyphs moved out are not fitted, they are written with the texture rectangle of the glyph they are identical
+     * to. Glyphs without a crunched bitmap are kept.
+     *
+     * Glyphs already copied into pages of the layout are kept in preference to glyphs still to be fitted. Glyphs
+     * moved out release their locations in the layout.
+     *
+     * Merges results from all threads first. Must not be called while glyphs are still being added.
+     *
+     * \param layout Layout glyphs may have been copied into, NULL if none.
+     */
+    void dedupe(GlyphLayout *layout = NULL);
+
+    /** \brief Move glyphs of one target size and dropdown into another storage.
+     *
+     * Merges results from all threads first. Must not be called while glyphs are still being added.
+     *
+     * \param dst Storage to move glyphs into.
+     * \param target_size Target size of glyphs to move.
+     * \param dropdown Dropdown of glyphs to move.
      */
-    void concurrencyIcrement();
+    void extract(GlyphStorage &dst, unsigned target_size, float dropdown);
+
+    /** \brief Find the layout of a target size and dropdown.
+     *
+     * \param target_size Target size.
+     * \param dropdown Dropdown.
+     * \return Layout or NULL if none.
+     */
+    GlyphLayout* findLayout(unsigned target_size, float dropdown) const;
 
     /** \brief Mark a glyph for rendering.
      *
      * Glyphs may be only be marked for rendering one time, the point is to prevent rendering the same glyph
      * multiple times.
      *
+     * Lock-free, may be called concurrently from any thread.
+     *
      * \param op Unicode number of glyph.
      * \return True if glyph may be rendered, false otherwise.
      */
@@ -140,6 +237,8 @@ class GlyphStorage
     void missing(unsigned op);
 
     /** \brief Sort the storage.
+     *
+     * Merges results from all threads first. Must not be called while glyphs are still being added.
      */
     void sort();
 
@@ -149,6 +248,16 @@ class GlyphStorage
      */
     void trim();
 
+    /** \brief Write a glyph fitted into a page.
+     *
+     * Also writes all aliases of the glyph and the glyphs identical to it, with their aliases.
+     *
+     * \param op Glyph to write, texture coordinates and page must have been set.
+     * \param fptr FILE pointer.
+     * \param glst Use OpenGL texture coordinates (as opposed to DirectX).
+     */
+    void write(FtGlyph &op, FILE *fptr, bool glst);
+
   public:
     /** \brief Tell if storage is empty.
      *
@@ -159,6 +268,15 @@ class GlyphStorage
       return m_glyphs.empty();
     }
 
+    /** \brief Get the precalc bitmap pool.
+     *
+     * \return Bitmap pool.
+     */
+    inline BitmapPool& getBitmapPool()
+    {
+      return m_pool;
+    }
+
     /** \brief Accessor.
      *
      * \param op Index to access.
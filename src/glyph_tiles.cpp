@@ -0,0 +1,241 @@
+#include "glyph_tiles.hpp"
+
+#include "ft_library.hpp"
+
+#include FT_OUTLINE_H
+
+/** \brief Collects the bounds of spans above a coverage threshold.
+ */
+class SpanBounds
+{
+  private:
+    /** Height in pixels. */
+    int m_rows;
+
+    /** Coverage threshold. */
+    uint8_t m_threshold;
+
+  public:
+    /** Leftmost set column. */
+    int m_x1;
+
+    /** Topmost set row. */
+    int m_y1;
+
+    /** Rightmost set column. */
+    int m_x2;
+
+    /** Bottommost set row. */
+    int m_y2;
+
+  public:
+    /** \brief Constructor.
+     *
+     * \param pwidth Width in pixels.
+     * \param prows Height in pixels.
+     * \param pthreshold Coverage threshold.
+     */
+    SpanBounds(unsigned pwidth, unsigned prows, uint8_t pthreshold) :
+      m_rows(static_cast<int>(prows)),
+      m_threshold(pthreshold),
+      m_x1(static_cast<int>(pwidth)),
+      m_y1(static_cast<int>(prows)),
+      m_x2(-1),
+      m_y2(-1) { }
+
+  public:
+    /** \brief Add spans of one row.
+     *
+     * \param y Y coordinate from the bottom.
+     * \param count Number of spans.
+     * \param spans Spans.
+     */
+    void add(int y, int count, const FT_Span *spans)
+    {
+      int row = m_rows - 1 - y;
+
+      for(int ii = 0; (ii < count); ++ii)
+      {
+        const FT_Span &span = spans[ii];
+
+        if(m_threshold < span.coverage)
+        {
+          m_x1 = std::min(m_x1, static_cast<int>(span.x));
+          m_x2 = std::max(m_x2, span.x + span.len - 1);
+          m_y1 = std::min(m_y1, row);
+          m_y2 = std::max(m_y2, row);
+        }
+      }
+    }
+};
+
+/** \brief Writes spans into a tile bitmap.
+ */
+class SpanTile
+{
+  private:
+    /** Tile bitmap. */
+    FT_Bitmap *m_tile;
+
+    /** Bitmap X coordinate of the leftmost tile column. */
+    int m_x;
+
+    /** Bitmap Y coordinate of the bottommost tile row, counted from the bottom. */
+    int m_y;
+
+  public:
+    /** \brief Constructor.
+     *
+     * \param ptile Tile bitmap.
+     * \param px Bitmap X coordinate of the leftmost tile column.
+     * \param py Bitmap Y coordinate of the bottommost tile row, counted from the bottom.
+     */
+    SpanTile(FT_Bitmap *ptile, int px, int py) :
+      m_tile(ptile),
+      m_x(px),
+      m_y(py) { }
+
+  public:
+    /** \brief Add spans of one row.
+     *
+     * \param y Y coordinate from the bottom.
+     * \param count Number of spans.
+     * \param spans Spans.
+     */
+    void add(int y, int count, const FT_Span *spans)
+    {
+      int width = static_cast<int>(m_tile->width);
+      int row = static_cast<int>(m_tile->rows) - 1 - (y - m_y);
+
+      if((0 > row) || (static_cast<int>(m_tile->rows) <= row))
+      {
+        return;
+      }
+
+      uint8_t *dst = m_tile->buffer + row * width;
+
+      for(int ii = 0; (ii < count); ++ii)
+      {
+        const FT_Span &span = spans[ii];
+        int start = std::max(span.x - m_x, 0);
+        int end = std::min(span.x + span.len - m_x, width);
+
+        if(start < end)
+        {
+          memset(dst + start, span.coverage, static_cast<size_t>(end - start));
+        }
+      }
+    }
+};
+
+/** \brief Span callback for the rasterizer.
+ *
+ * \param y Y coordinate from the bottom.
+ * \param count Number of spans.
+ * \param spans Spans.
+ * \param user Span consumer.
+ */
+template <typename T> static void add_spans(int y, int count, const FT_Span *spans, void *user)
+{
+  static_cast<T*>(user)->add(y, count, spans);
+}
+
+/** \brief Render an outline as spans.
+ *
+ * \param outline Outline to render.
+ * \param x1 Left edge of the clip box.
+ * \param y1 Bottom edge of the clip box.
+ * \param x2 Right edge of the clip box.
+ * \param y2 Top edge of the clip box.
+ * \param user Span consumer.
+ * \return True on success, false on error.
+ */
+template <typename T> static bool render_spans(const FT_Outline *outline, int x1, int y1, int x2, int y2, T *user)
+{
+  FT_Raster_Params params;
+
+  // The rasterizer does not modify the outline.
+  FT_Outline *source = const_cast<FT_Outline*>(outline);
+
+  memset(&params, 0, sizeof(params));
+  params.source = source;
+  params.flags = FT_RASTER_FLAG_AA | FT_RASTER_FLAG_DIRECT | FT_RASTER_FLAG_CLIP;
+  params.gray_spans = add_spans<T>;
+  params.user = user;
+  params.clip_box.xMin = x1;
+  params.clip_box.yMin = y1;
+  params.clip_box.xMax = x2;
+  params.clip_box.yMax = y2;
+
+  return !FT_Outline_Render(FtLibrary::get(), source, &params);
+}
+
+GlyphTiles::GlyphTiles(unsigned pwidth, unsigned prows) :
+  m_width(pwidth),
+  m_rows(prows),
+  m_valid(false) { }
+
+GlyphTiles::~GlyphTiles()
+{
+  if(m_valid)
+  {
+    FT_Outline_Done(FtLibrary::get(), &m_outline);
+  }
+}
+
+bool GlyphTiles::getBounds(uint8_t threshold, int &x1, int &y1, int &x2, int &y2) const
+{
+  SpanBounds bounds(m_width, m_rows, threshold);
+
+  if(m_valid && !render_spans(&m_outline, 0, 0, static_cast<int>(m_width), static_cast<int>(m_rows), &bounds))
+  {
+    //std::cerr << "could not render outline" << std::endl;
+    return false;
+  }
+
+  x1 = bounds.m_x1;
+  y1 = bounds.m_y1;
+  x2 = bounds.m_x2;
+  y2 = bounds.m_y2;
+  return (0 <= x2);
+}
+
+bool GlyphTiles::render(FT_Bitmap *tile, int px, int py) const
+{
+  if(!m_valid)
+  {
+    return true;
+  }
+
+  // Clip to both the tile and the size, tiles entirely outside the size stay empty.
+  int y1 = static_cast<int>(m_rows) - py - static_cast<int>(tile->rows);
+  int clip_x1 = std::max(px, 0);
+  int clip_y1 = std::max(y1, 0);
+  int clip_x2 = std::min(px + static_cast<int>(tile->width), static_cast<int>(m_width));
+  int clip_y2 = std::min(static_cast<int>(m_rows) - py, static_cast<int>(m_rows));
+  SpanTile dst(tile, px, y1);
+
+  if((clip_x1 >= clip_x2) || (clip_y1 >= clip_y2))
+  {
+    return true;
+  }
+
+  return render_spans(&m_outline, clip_x1, clip_y1, clip_x2, clip_y2, &dst);
+}
+
+bool GlyphTiles::setOutline(const FT_Outline *outline)
+{
+  if(m_valid)
+  {
+    FT_Outline_Done(FtLibrary::get(), &m_outline);
+    m_valid = false;
+  }
+
+  if(FT_Outline_New(FtLibrary::get(), static_cast<FT_UInt>(outline->n_points), outline->n_contours, &m_outline))
+  {
+    return false;
+  }
+  m_valid = true;
+
+  return !FT_Outline_Copy(outline, &m_outline);
+}
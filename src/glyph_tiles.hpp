@@ -0,0 +1,106 @@
+#ifndef GLYPH_TILES_HPP
+#define GLYPH_TILES_HPP
+
+#include "defaults.hpp"
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+
+/** \brief Glyph outline rendered into the precalc bitmap one tile at a time.
+ *
+ * Precalc bitmaps of large sizes take hundreds of megabytes. Tiles are rendered only when sampled, memory taken
+ * is proportional to the size of a tile instead of the whole bitmap. Tiles are exactly the same pixels a bitmap
+ * rendered from the same outline would have.
+ */
+class GlyphTiles : public boost::noncopyable
+{
+  public:
+    /** Largest precalc bitmap side rendered in one piece. */
+    static const unsigned MAX_UNTILED_SIZE = 4096;
+
+    /** Side of the area sampled from one tile in pixels, tiles extend past it by the search radius. */
+    static const unsigned TILE_SIZE = 2048;
+
+  private:
+    /** Width in pixels. */
+    unsigned m_width;
+
+    /** Height in pixels. */
+    unsigned m_rows;
+
+    /** Copy of the outline, lower left corner of the size at origin. */
+    FT_Outline m_outline;
+
+    /** Has the outline been copied? */
+    bool m_valid;
+
+  public:
+    /** \brief Constructor.
+     *
+     * Nothing is set until an outline is copied.
+     *
+     * \param pwidth Width in pixels.
+     * \param prows Height in pixels.
+     */
+    GlyphTiles(unsigned pwidth, unsigned prows);
+
+    /** \brief Destructor.
+     */
+    ~GlyphTiles();
+
+  public:
+    /** \brief Find the bounds of pixels above a coverage threshold.
+     *
+     * Spans are collected from the whole outline without rendering a bitmap.
+     *
+     * \param threshold Coverage threshold.
+     * \param x1 Leftmost set column.
+     * \param y1 Topmost set row.
+     * \param x2 Rightmost set column.
+     * \param y2 Bottommost set row.
+     * \return True if any pixel was set, false otherwise.
+     */
+    bool getBounds(uint8_t threshold, int &x1, int &y1, int &x2, int &y2) const;
+
+    /** \brief Render a tile.
+     *
+     * Tile bitmap must be cleared beforehand. Parts of the tile outside the size stay empty.
+     *
+     * \param tile Tile bitmap, width and rows set to the tile size.
+     * \param px Bitmap X coordinate of the leftmost tile column.
+     * \param py Bitmap Y coordinate of the topmost tile row.
+     * \return True on success, false on error.
+     */
+    bool render(FT_Bitmap *tile, int px, int py) const;
+
+    /** \brief Copy an outline.
+     *
+     * \param outline Outline to copy, lower left corner of the size at origin.
+     * \return True on success, false on error.
+     */
+    bool setOutline(const FT_Outline *outline);
+
+  public:
+    /** \brief Get height.
+     *
+     * \return Height in pixels.
+     */
+    inline unsigned getRows() const
+    {
+      return m_rows;
+    }
+
+    /** \brief Get width.
+     *
+     * \return Width in pixels.
+     */
+    inline unsigned getWidth() const
+    {
+      return m_width;
+    }
+};
+
+/** Convenience typedef. */
+typedef boost::shared_ptr<GlyphTiles> GlyphTilesSptr;
+
+#endif
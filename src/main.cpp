@@ -1,15 +1,22 @@
+#include "corpus_scanner.hpp"
+#include "ft_face.hpp"
 #include "ft_glyph.hpp"
 #include "glyph_range.hpp"
 #include "glyph_storage.hpp"
 #include "sky_line.hpp"
 #include "sky_line_fitter.hpp"
 #include "gfx/image_png.hpp"
+#include "math/cpu.hpp"
+#include "prog/progress.hpp"
 #include "thr/dispatch.hpp"
+#include "thr/generic.hpp"
 
 #include <boost/filesystem.hpp>
 #include <boost/exception/diagnostic_information.hpp>
 #include <boost/program_options.hpp>
 
+#include <iomanip>
+
 namespace fs = boost::filesystem;
 namespace po = boost::program_options;
 
@@ -45,8 +52,14 @@ static const char *g_segments_enabled[] =
   NULL
 };
 
-/** Verbose or not. */
-bool g_verbose = false;
+/** Largest page side. */
+static const unsigned MAX_PAGE_SIZE = 2048;
+
+/** Samples added to predicted glyph sizes when laying out pages before crunching. */
+static const unsigned PIPELINE_SLACK = 1;
+
+/** Size steps between page widths attempted in the coarse pass when laying out pages from predicted sizes. */
+static const unsigned PLAN_WIDTH_STEPS = 16;
 
 /** Convenience typedef. */
 typedef std::list<FtFaceSptr> FaceList;
@@ -66,22 +79,595 @@ static void fit_glyphs(SkyLineFitter &slf, GlyphStorage &storage)
   thr::thr_quit();
 }
 
-/** \brief Perform rendering of all glyphs.
+/** \brief Scan text files for used codepoints.
  *
- * \param ranges ranges to render.
+ * \param scanner Corpus scanner.
+ */
+static void scan_text(CorpusScanner &scanner)
+{
+  scanner.queue();
+
+  thr::wait();
+  thr::thr_quit();
+}
+
+/** \brief Measure glyph metrics.
+ *
+ * \param ranges Ranges to measure.
+ * \param glyphs Glyph storage.
  * \param fonts List of fonts.
- * \param target_size Size to aim to.
  */
-static void queue_glyphs(RangeMap &ranges, GlyphStorage &storage, FaceList &fonts, unsigned target_size)
+static void measure_glyphs(const RangeMap &ranges, GlyphStorage &glyphs, FaceList &fonts)
 {
   BOOST_FOREACH(const RangeMap::value_type &vv, ranges)
   {
-    vv.second.queue(storage, fonts, target_size);
+    vv.second.measure(glyphs, fonts);
   }
+
+  thr::wait();
+  thr::thr_quit();
+}
+
+/** \brief Estimate the cost of crunching every glyph.
+ *
+ * \param ranges Ranges to estimate.
+ * \param fonts List of fonts.
+ * \param estimates Estimates are appended here.
+ */
+static void estimate_glyphs(const RangeMap &ranges, FaceList &fonts, std::vector<GlyphEstimate> &estimates)
+{
+  BOOST_FOREACH(const RangeMap::value_type &vv, ranges)
+  {
+    vv.second.estimate(estimates, fonts);
+  }
+}
+
+/** \brief Perform rendering of all glyphs.
+ *
+ * \param estimates Glyph estimates.
+ * \param fonts List of fonts.
+ * \param target_sizes Sizes to aim to.
+ * \param dropdowns Dropdowns, largest first.
+ */
+static void queue_glyphs(std::vector<GlyphEstimate> &estimates, GlyphStorage &storage, FaceList &fonts,
+    const std::vector<unsigned> &target_sizes, const std::vector<float> &dropdowns)
+{
+  GlyphRange::queue(storage, estimates, fonts, target_sizes, dropdowns);
+  GlyphRange::refine(storage, target_sizes, dropdowns, true);
   thr::wait();
   thr::thr_quit();
 }
 
+/** \brief Find the best page size for the glyphs left.
+ *
+ * \param slf Sky line fitter.
+ * \param glyphs Sorted glyphs left.
+ * \param image_index Index of the page.
+ */
+static void fit_page(SkyLineFitter &slf, GlyphStorage &glyphs, unsigned image_index)
+{
+  if(prog::is_enabled())
+  {
+    std::ostringstream sstr;
+    sstr << "Fitting page " << image_index << " (" << glyphs.size() << " glyphs left)";
+    prog::phase(sstr.str(), slf.getAttemptCount(), "attempts");
+  }
+
+  boost::thread fit_thread(boost::bind(fit_glyphs, boost::ref(slf), boost::ref(glyphs)));
+  thr::thr_main();
+}
+
+/** \brief Open the font description file and write the header.
+ *
+ * \param output_base Output file basename.
+ * \return Font description file.
+ */
+static FILE* open_font(const std::string &output_base)
+{
+  std::string xmlfilename(output_base + std::string(".xml"));
+  FILE *xmlfile = fopen(xmlfilename.c_str(), "wt");
+  if(!xmlfile)
+  {
+    std::stringstream err;
+    err << "could not open " << xmlfilename << "for writing";
+    BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
+  }
+  fputs("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+      "<font xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+      "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\">\n",
+      xmlfile);
+  return xmlfile;
+}
+
+/** \brief Write the footer and close the font description file.
+ *
+ * \param xmlfile Font description file.
+ */
+static void close_font(FILE *xmlfile)
+{
+  fputs("</font>", xmlfile);
+  fclose(xmlfile);
+}
+
+/** \brief Save a page image and write its texture record.
+ *
+ * \param sl Page.
+ * \param xmlfile Font description file.
+ * \param output_base Output file basename.
+ * \param image_index Index of the page.
+ */
+static void save_page(SkyLine &sl, FILE *xmlfile, const std::string &output_base, unsigned image_index)
+{
+  std::ostringstream sstr;
+  sstr << output_base << '_' << image_index << ".png";
+  fs::path pngfilepath(sstr.str());
+  std::string pngfilename(pngfilepath.generic_string());
+
+  fprintf(xmlfile, "\t<texture>%s</texture>\n", pngfilename.c_str());
+  sl.save(pngfilename);
+}
+
+/** \brief Fit glyphs into pages and write the font description and page images.
+ *
+ * \param glyphs Crunched and sorted glyphs, will be emptied.
+ * \param layout Pages laid out before crunching, NULL if none.
+ * \param output_base Output file basename.
+ * \param opengl_coordinates Use OpenGL texture coordinates (as opposed to DirectX).
+ */
+static void write_font(GlyphStorage &glyphs, GlyphLayout *layout, const std::string &output_base,
+    bool opengl_coordinates)
+{
+  FILE *xmlfile = open_font(output_base);
+
+  // Identical crunched bitmaps are fitted once.
+  glyphs.dedupe(layout);
+
+  unsigned image_index = 0;
+
+  // Pages laid out before crunching already have their glyphs copied in.
+  if(NULL != layout)
+  {
+    // Glyphs that did not fit their planned location may take a location released by a duplicate.
+    BOOST_FOREACH(FtGlyphSptr &vv, glyphs)
+    {
+      if(!layout->isPlaced(*vv))
+      {
+        layout->place(*vv);
+      }
+    }
+
+    for(; (image_index < layout->getPageCount()); ++image_index)
+    {
+      BOOST_FOREACH(FtGlyphSptr &vv, glyphs)
+      {
+        if(vv && layout->isPlaced(*vv) && (vv->getPage() == image_index))
+        {
+          glyphs.write(*vv, xmlfile, opengl_coordinates);
+          vv = FtGlyphSptr();
+        }
+      }
+
+      save_page(layout->getPage(image_index), xmlfile, output_base, image_index);
+    }
+
+    glyphs.trim();
+
+    if(!glyphs.empty() && prog::is_enabled())
+    {
+      std::ostringstream sstr;
+      sstr << glyphs.size() << " glyphs did not fit their planned location";
+      prog::message(sstr.str());
+    }
+  }
+
+  // Perform fitting along the skyline algorithm.
+  for(; (!glyphs.empty()); ++image_index)
+  {
+    SkyLineFitter slf(MAX_PAGE_SIZE);
+
+    fit_page(slf, glyphs, image_index);
+
+    SkyLine sl(slf.getBestWidth(), slf.getBestHeight());
+
+    sl.fitAll(glyphs, xmlfile, image_index, opengl_coordinates);
+
+    glyphs.trim(); // will also sort
+
+    save_page(sl, xmlfile, output_base, image_index);
+  }
+
+  close_font(xmlfile);
+}
+
+/** \brief Measure glyph metrics and write the font description without rendering any glyph.
+ *
+ * Glyphs are neither crunched nor fitted, there are no pages. Quads collapse to the top left corner of every glyph
+ * (left, top) and texture coordinates are zero.
+ *
+ * \param ranges Ranges to measure.
+ * \param glyphs Glyph storage, will be emptied.
+ * \param fonts List of fonts.
+ * \param output_base Output file basename.
+ * \param opengl_coordinates Use OpenGL texture coordinates (as opposed to DirectX).
+ */
+static void measure_font(const RangeMap &ranges, GlyphStorage &glyphs, FaceList &fonts,
+    const std::string &output_base, bool opengl_coordinates)
+{
+  {
+    unsigned glyph_count = 0;
+    BOOST_FOREACH(const RangeMap::value_type &vv, ranges)
+    {
+      glyph_count += vv.second.size();
+    }
+    prog::phase("Measuring", glyph_count, "glyphs");
+  }
+
+  {
+    boost::thread measure_thread(boost::bind(measure_glyphs, boost::cref(ranges), boost::ref(glyphs),
+          boost::ref(fonts)));
+    thr::thr_main();
+  }
+  glyphs.sort();
+
+  FILE *xmlfile = open_font(output_base);
+
+  BOOST_FOREACH(FtGlyphSptr &vv, glyphs)
+  {
+    glyphs.write(*vv, xmlfile, opengl_coordinates);
+  }
+  glyphs.clear();
+
+  close_font(xmlfile);
+}
+
+/** \brief Find a page size for planned glyphs without attempting every width.
+ *
+ * Widths are first attempted at coarse steps, then at size steps around the best coarse width. The best coarse
+ * width is attempted again, so the result is never worse than the coarse one.
+ *
+ * \param glyphs Sorted glyphs left.
+ * \param image_index Index of the page.
+ * \param pw Best width found.
+ * \param ph Best height found.
+ */
+static void plan_page(GlyphStorage &glyphs, unsigned image_index, unsigned &pw, unsigned &ph)
+{
+  const unsigned COARSE_STEP = SkyLine::SIZE_STEP * PLAN_WIDTH_STEPS;
+  SkyLineFitter coarse(MAX_PAGE_SIZE, COARSE_STEP, MAX_PAGE_SIZE, COARSE_STEP);
+
+  fit_page(coarse, glyphs, image_index);
+
+  unsigned best_width = coarse.getBestWidth();
+  if(0 >= best_width)
+  {
+    pw = 0;
+    ph = 0;
+    return;
+  }
+
+  unsigned narrowest = (best_width > COARSE_STEP) ? (best_width - COARSE_STEP + SkyLine::SIZE_STEP) : 0;
+  SkyLineFitter fine(MAX_PAGE_SIZE, narrowest, best_width + COARSE_STEP - SkyLine::SIZE_STEP, SkyLine::SIZE_STEP);
+
+  fit_page(fine, glyphs, image_index);
+
+  pw = fine.getBestWidth();
+  ph = fine.getBestHeight();
+}
+
+/** \brief Lay out pages for glyphs of one target size and dropdown from predicted sizes.
+ *
+ * \param estimates Glyph estimates.
+ * \param fonts List of fonts.
+ * \param target_size Target size.
+ * \param dropdown Dropdown.
+ * \param slack Samples added to predicted widths and heights.
+ * \param unfitted Number of glyphs too large for a page.
+ * \return Layout.
+ */
+static GlyphLayoutSptr layout_glyphs(const std::vector<GlyphEstimate> &estimates, FaceList &fonts,
+    unsigned target_size, float dropdown, unsigned slack, unsigned &unfitted)
+{
+  GlyphLayoutSptr ret(new GlyphLayout(target_size, dropdown));
+  GlyphStorage glyphs;
+
+  // Glyphs without an estimate are missing or share the rectangle of another glyph.
+  BOOST_FOREACH(const GlyphEstimate &vv, estimates)
+  {
+    if(0 >= vv.first)
+    {
+      continue;
+    }
+
+    BOOST_FOREACH(FtFaceSptr &ii, fonts)
+    {
+      if(ii->hasGlyph(vv.second))
+      {
+        FtGlyph *gly = ii->planGlyph(vv.second, target_size, dropdown, slack);
+
+        if(NULL != gly)
+        {
+          glyphs.markGlyph(vv.second);
+          glyphs.add(gly);
+        }
+        break;
+      }
+    }
+  }
+  glyphs.sort();
+
+  for(unsigned image_index = 0; (!glyphs.empty()); ++image_index)
+  {
+    unsigned page_width;
+    unsigned page_height;
+
+    plan_page(glyphs, image_index, page_width, page_height);
+
+    if(!ret->addPage(page_width, page_height, glyphs))
+    {
+      break;
+    }
+  }
+
+  unfitted = glyphs.size();
+  return ret;
+}
+
+/** \brief Predict pages and crunching work without rendering any glyph.
+ *
+ * Crunched sizes are predicted from unscaled glyph metrics and fitted into pages like crunched glyphs would be,
+ * once for every target size and dropdown.
+ *
+ * \param estimates Glyph estimates.
+ * \param fonts List of fonts.
+ * \param target_sizes Sizes to aim to.
+ * \param dropdowns Dropdowns, largest first.
+ */
+static void plan_font(const std::vector<GlyphEstimate> &estimates, FaceList &fonts,
+    const std::vector<unsigned> &target_sizes, const std::vector<float> &dropdowns)
+{
+  uint64_t work = 0;
+  BOOST_FOREACH(const GlyphEstimate &vv, estimates)
+  {
+    work += vv.first;
+  }
+  work *= target_sizes.size();
+
+  BOOST_FOREACH(unsigned ii, target_sizes)
+  {
+    BOOST_FOREACH(float jj, dropdowns)
+    {
+      unsigned unfitted;
+      GlyphLayoutSptr layout = layout_glyphs(estimates, fonts, ii, jj, 0, unfitted);
+      unsigned planned = unfitted;
+
+      for(unsigned kk = 0; (kk < layout->getPageCount()); ++kk)
+      {
+        planned += layout->getPageGlyphs(kk);
+      }
+
+      std::cout << "Size " << ii << ", dropdown " << jj << ": " << planned << " glyphs" << std::endl;
+
+      for(unsigned kk = 0; (kk < layout->getPageCount()); ++kk)
+      {
+        SkyLine &sl = layout->getPage(kk);
+
+        std::cout << "  page " << kk << ": " << sl.getWidth() << 'x' << sl.getMaxHeight() << ", " <<
+          layout->getPageGlyphs(kk) << " glyphs, " << std::fixed << std::setprecision(1) <<
+          (sl.getUsage() * 100.0f) << "% used" << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+      }
+      if(0 < unfitted)
+      {
+        std::cout << "  " << unfitted << " glyphs do not fit on a page" << std::endl;
+      }
+    }
+  }
+  prog::phase("");
+
+  std::cout << "Crunching work: " << work << " precalc pixels, " << (work / thr::hardware_concurrency()) <<
+    " per thread on " << thr::hardware_concurrency() << " threads" << std::endl;
+}
+
+/** \brief Get the command line name of a distance engine.
+ *
+ * \param op Distance engine.
+ * \return Name.
+ */
+static const char* get_engine_name(DistanceEngine op)
+{
+  switch(op)
+  {
+    case ENGINE_SCAN:
+      return "scan";
+
+    case ENGINE_GRID:
+      return "grid";
+
+    case ENGINE_RUNS:
+      return "runs";
+
+    case ENGINE_FREETYPE:
+      return "freetype";
+
+    case ENGINE_FREETYPE_BITMAP:
+      return "freetype-bitmap";
+
+    default:
+      return "unknown";
+  }
+}
+
+/** \brief Get a distance engine by its command line name.
+ *
+ * Throws an exception on error.
+ *
+ * \param op Name.
+ * \return Distance engine.
+ */
+static DistanceEngine get_engine(const std::string &op)
+{
+  for(int ii = ENGINE_SCAN; (ii <= ENGINE_FREETYPE_BITMAP); ++ii)
+  {
+    if(op == get_engine_name(static_cast<DistanceEngine>(ii)))
+    {
+      return static_cast<DistanceEngine>(ii);
+    }
+  }
+
+  std::stringstream err;
+  err << "invalid distance engine: " << op;
+  BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
+}
+
+/** \brief Crunch every glyph with two engines and report speed and mean and largest difference of output values.
+ *
+ * Glyphs are rendered and crunched one at a time on the calling thread, so times are comparable between engines.
+ *
+ * \param ranges Ranges to compare.
+ * \param font_names Font files.
+ * \param pool Pool to acquire precalc bitmaps from.
+ * \param precalc_size Precalc size.
+ * \param target_sizes Sizes to aim to.
+ * \param dropdowns Dropdowns, largest first.
+ * \param mode Distance measurement mode.
+ * \param reference Engine compared to.
+ * \param candidate Engine compared.
+ */
+static void compare_engines(const RangeMap &ranges, const std::vector<std::string> &font_names, BitmapPool &pool,
+    unsigned precalc_size, const std::vector<unsigned> &target_sizes, const std::vector<float> &dropdowns,
+    DistanceMode mode, DistanceEngine reference, DistanceEngine candidate)
+{
+  FaceList reference_fonts;
+  FaceList candidate_fonts;
+  BOOST_FOREACH(const std::string &vv, font_names)
+  {
+    reference_fonts.push_back(FtFaceSptr(new FtFace(vv, precalc_size, dropdowns.front(), mode, reference, -1.0f)));
+    candidate_fonts.push_back(FtFaceSptr(new FtFace(vv, precalc_size, dropdowns.front(), mode, candidate, -1.0f)));
+  }
+
+  // Glyphs in multiple ranges are compared once.
+  std::set<unsigned> glyphs;
+  BOOST_FOREACH(const RangeMap::value_type &vv, ranges)
+  {
+    if(vv.second.isEnabled())
+    {
+      BOOST_FOREACH(const GlyphRange::container_type::value_type &ii, vv.second)
+      {
+        for(unsigned jj = ii.first; (jj <= ii.second); ++jj)
+        {
+          glyphs.insert(jj);
+        }
+      }
+    }
+  }
+
+  uint64_t reference_time = 0;
+  uint64_t candidate_time = 0;
+  uint64_t difference_sum = 0;
+  uint64_t difference_count = 0;
+  unsigned compared = 0;
+  unsigned worst_difference = 0;
+  unsigned worst_unicode = 0;
+  unsigned worst_size = 0;
+
+  prog::phase("Comparing", static_cast<unsigned>(glyphs.size() * target_sizes.size()), "glyphs");
+  BOOST_FOREACH(unsigned vv, glyphs)
+  {
+    FaceList::iterator reference_face = reference_fonts.begin();
+    FaceList::iterator candidate_face = candidate_fonts.begin();
+    for(; (reference_fonts.end() != reference_face); ++reference_face, ++candidate_face)
+    {
+      if((*reference_face)->hasGlyph(vv))
+      {
+        break;
+      }
+    }
+
+    BOOST_FOREACH(unsigned ii, target_sizes)
+    {
+      if(reference_fonts.end() == reference_face)
+      {
+        prog::item_skipped();
+        continue;
+      }
+
+      // Both engines sample on a grid aligned to glyph origin so results are comparable sample by sample.
+      uint64_t stamp = thr::nsec_get_timestamp();
+      std::vector<FtGlyph*> reference_glyphs(1, (*reference_face)->renderGlyph(vv, ii, precalc_size, pool));
+      bool reference_crunched = (NULL != reference_glyphs.front());
+      if(reference_crunched)
+      {
+        reference_glyphs.front()->setOriginAligned();
+        reference_crunched = reference_glyphs.front()->crunch(reference_glyphs, dropdowns);
+      }
+      uint64_t reference_stamp = thr::nsec_get_timestamp();
+      std::vector<FtGlyph*> candidate_glyphs(1, (*candidate_face)->renderGlyph(vv, ii, precalc_size, pool));
+      bool candidate_crunched = (NULL != candidate_glyphs.front());
+      if(candidate_crunched)
+      {
+        candidate_glyphs.front()->setOriginAligned();
+        candidate_crunched = candidate_glyphs.front()->crunch(candidate_glyphs, dropdowns);
+      }
+      uint64_t candidate_stamp = thr::nsec_get_timestamp();
+
+      if(reference_crunched && candidate_crunched)
+      {
+        unsigned difference = 0;
+        for(unsigned jj = 0; (jj < reference_glyphs.size()); ++jj)
+        {
+          difference = std::max(difference, reference_glyphs[jj]->getMaxDifference(*(candidate_glyphs[jj]),
+                &difference_sum, &difference_count));
+        }
+
+        reference_time += reference_stamp - stamp;
+        candidate_time += candidate_stamp - reference_stamp;
+        ++compared;
+        if(difference > worst_difference)
+        {
+          worst_difference = difference;
+          worst_unicode = vv;
+          worst_size = ii;
+        }
+        prog::item_done();
+      }
+      else
+      {
+        prog::item_failed(vv);
+      }
+
+      BOOST_FOREACH(FtGlyph *jj, reference_glyphs)
+      {
+        delete jj;
+      }
+      BOOST_FOREACH(FtGlyph *jj, candidate_glyphs)
+      {
+        delete jj;
+      }
+    }
+  }
+  prog::phase("");
+
+  std::cout << "Compared " << compared << " glyphs" << std::endl;
+  std::cout << get_engine_name(reference) << ": " << (static_cast<double>(reference_time) / 1000000.0) << " ms" <<
+    std::endl;
+  std::cout << get_engine_name(candidate) << ": " << (static_cast<double>(candidate_time) / 1000000.0) << " ms" <<
+    std::endl;
+  if(0 < compared)
+  {
+    if(0 < difference_count)
+    {
+      std::cout << "Mean difference: " << (static_cast<double>(difference_sum) /
+          static_cast<double>(difference_count)) << std::endl;
+    }
+    std::cout << "Max difference: " << worst_difference;
+    if(0 < worst_difference)
+    {
+      std::cout << " (unicode " << worst_unicode << " at size " << worst_size << ')';
+    }
+    std::cout << std::endl;
+  }
+}
+
 /** \brief Main function.
  *
  * \param argc Argument count.
@@ -93,16 +679,32 @@ int main(int argc, char **argv)
   try
   {
     std::vector<std::string> font_names;
+    std::vector<std::string> text_names;
+    std::vector<unsigned> target_sizes;
+    std::vector<float> dropdowns;
     FaceList fonts;
     GlyphRange extra_range;
+    GlyphRange revoked_range;
     GlyphStorage glyphs;
     RangeMap ranges;
     fs::path output_path;
+    DistanceMode distance_mode = DISTANCE_BINARY;
+    DistanceEngine distance_engine = ENGINE_GRID;
+    DistanceEngine compare_engine = ENGINE_FREETYPE;
+    math::CpuLevel cpu_level = math::CPU_AVX512;
     float dropdown = 0.1f;
+    float adaptive_tolerance = -1.0f;
     unsigned precalc_size = 2048,
-             target_size = 48;
+             target_size = 48,
+             memory_limit = static_cast<unsigned>(GlyphStorage::DEFAULT_MEMORY_LIMIT / (1024 * 1024));
     bool can_execute = true,
+         compare = false,
+         dump_glyphs = false,
          opengl_coordinates = true,
+         metrics_only = false,
+         pipeline = false,
+         plan = false,
+         verbose = false,
          version_printed = false;
 
     ranges[std::string("default")] = GlyphRange();
@@ -142,10 +744,44 @@ int main(int argc, char **argv)
           (opengl_coordinates ? "opengl" : "directx") << ").";
         coordinate_string = sstr.str();
       }
+      std::string cpu_string;
+      {
+        std::ostringstream sstr;
+        sstr << "Highest instruction set to use in vectorized kernels, possible values:";
+        for(int ii = 0; (ii < math::CPU_LEVEL_COUNT); ++ii)
+        {
+          sstr << ((0 < ii) ? ", " : " ") << math::cpu_level_name(static_cast<math::CpuLevel>(ii));
+        }
+        sstr << " (default: best available, detected: " << math::cpu_level_name(math::cpu_detect()) << ").";
+        cpu_string = sstr.str();
+      }
+      std::string distance_engine_string;
+      {
+        std::ostringstream sstr;
+        sstr << "Closest edge search engine, possible values: scan, grid, runs, freetype, freetype-bitmap " <<
+          "(default: " << get_engine_name(distance_engine) << "). In binary distance mode, scan searches bitmap " <<
+          "rows outwards from every sample, grid searches only boundary pixels near it, runs renders glyphs as " <<
+          "runs of set pixels on every row without a precalc bitmap and searches those. Results of these are " <<
+          "identical. Freetype and freetype-bitmap interpolate a distance field rendered by FreeType 2.11 or " <<
+          "newer from the outline or from a coverage bitmap, at a precalc size small enough for its spread to " <<
+          "cover the dropdown, and fall back to grid where FreeType can not render one.";
+        distance_engine_string = sstr.str();
+      }
+      std::string distance_mode_string;
+      {
+        std::ostringstream sstr;
+        sstr << "Distance measurement mode, possible values: binary, coverage, msdf (default: " <<
+          ((DISTANCE_COVERAGE == distance_mode) ? "coverage" : "binary") << "). Coverage mode locates edges " <<
+          "within anti-aliased pixels and reaches the same quality with a much smaller precalc size. Msdf mode " <<
+          "measures distances from the outline on three channels and writes RGB pages, the median of the " <<
+          "channels keeps corners sharp.";
+        distance_mode_string = sstr.str();
+      }
       std::string dropdown_string;
       {
         std::ostringstream sstr;
-        sstr << "Relative distance (of whole glyph) of font edge it takes to reduce alpha-test to 0 " <<
+        sstr << "Relative distance (of whole glyph) of font edge it takes to reduce alpha-test to 0, " <<
+          "may be specified multiple times to derive every variant from the same distances " <<
           "(default: " << dropdown << ").";
         dropdown_string = sstr.str();
       }
@@ -162,6 +798,13 @@ int main(int argc, char **argv)
         }
         include_string = sstr.str();
       }
+      std::string memory_limit_string;
+      {
+        std::ostringstream sstr;
+        sstr << "Memory budget for precalc bitmaps in flight, in megabytes, tiles of precalc bitmaps rendered one "
+          "tile at a time are not counted (default: " << memory_limit << ").";
+        memory_limit_string = sstr.str();
+      }
       std::string precalc_size_string;
       {
         std::ostringstream sstr;
@@ -171,24 +814,35 @@ int main(int argc, char **argv)
       std::string target_size_string;
       {
         std::ostringstream sstr;
-        sstr << "Target resolution to crunch glyphs to (default: " << target_size << ").";
+        sstr << "Target resolution to crunch glyphs to, may be specified multiple times to render every glyph once, search distances at the largest size and interpolate them for the others (default: " << target_size << ").";
         target_size_string = sstr.str();       
       }
 
       po::options_description desc("Options");
       desc.add_options()
+        ("adaptive-tolerance", po::value<float>(), "Pick precalc size per glyph: start at the smallest halving of precalc size still at least four times the largest target size and double it until crunched output values change by at most this much (0-255), precalc size is the maximum (default: off).")
         ("all,a", "Enable all known named segments by default.")
+        ("compare-engine", po::value<std::string>(), "Crunch every glyph with the distance engine and with this engine instead of writing output, report time taken by both and mean and largest difference of output values over all samples (0-255).")
         ("coordinates,c", po::value<std::string>(), coordinate_string.c_str())
+        ("cpu", po::value<std::string>(), cpu_string.c_str())
         ("custom-range,a", po::value<std::string>(), "Add an additional custom glyph range (separate with a colon character) or an individual glyph.")
-        ("dropdown,d", po::value<float>(), dropdown_string.c_str())
+        ("distance-engine", po::value<std::string>(), distance_engine_string.c_str())
+        ("distance-mode", po::value<std::string>(), distance_mode_string.c_str())
+        ("dropdown,d", po::value<std::vector<float> >(), dropdown_string.c_str())
+        ("dump-glyphs", "Print an ASCII rendering of every crunched glyph, implies verbose.")
         ("empty,e", "Do not enable any segments by default")
         ("font,f", po::value< std::vector<std::string> >(), "Font input file.")
         ("help,h", "Print help text.")
         ("include,i", po::value<std::vector<std::string> >(), include_string.c_str())
+        ("include-from-text", po::value<std::vector<std::string> >(), "Include every character used in given UTF-8 text files, may be specified multiple times.")
+        ("memory-limit,m", po::value<unsigned>(), memory_limit_string.c_str())
+        ("metrics-only", "Write only glyph metrics without rendering, crunching or fitting any glyph, there are no pages, quads collapse to the top left corner of the glyph (left, top) and texture coordinates are zero.")
         ("outfile,o", po::value<std::string>(), "Output file basename.")
+        ("pipeline", "Lay out pages from glyph metrics before crunching and copy every glyph into its page as soon as it is crunched, glyphs crunched larger than predicted are fitted on additional pages afterwards.")
+        ("plan", "Predict pages, their usage and crunching work from glyph metrics instead of writing output, nothing is rendered.")
         ("precalc-size,p", po::value<unsigned>(), precalc_size_string.c_str())
         ("revoke,r", po::value<std::vector<std::string> >(), "Specifically deny a segment from being included, may be specified multiple times (default: none).")
-        ("target-size,t", po::value<unsigned>(), target_size_string.c_str())
+        ("target-size,t", po::value<std::vector<unsigned> >(), target_size_string.c_str())
         ("verbose,v", "Turn on verbose reporting.")
         ("version,V", "Print version string");
 
@@ -199,6 +853,16 @@ int main(int argc, char **argv)
       po::store(po::command_line_parser(argc, argv).options(desc).positional(pdesc).run(), vmap);
       po::notify(vmap);
 
+      if(vmap.count("adaptive-tolerance"))
+      {
+        adaptive_tolerance = vmap["adaptive-tolerance"].as<float>();
+        if(0.0f > adaptive_tolerance)
+        {
+          std::stringstream err;
+          err << "invalid adaptive tolerance: " << adaptive_tolerance;
+          BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
+        }
+      }
       if(vmap.count("coordinates"))
       {
         std::string coordinate_system = vmap["coordinates"].as<std::string>();
@@ -217,20 +881,85 @@ int main(int argc, char **argv)
           BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
         }
       }
-      if(vmap.count("dropdown"))
+      if(vmap.count("cpu"))
+      {
+        std::string level = vmap["cpu"].as<std::string>();
+        int ii = 0;
+        for(; (ii < math::CPU_LEVEL_COUNT); ++ii)
+        {
+          if(level == math::cpu_level_name(static_cast<math::CpuLevel>(ii)))
+          {
+            break;
+          }
+        }
+        if(ii >= math::CPU_LEVEL_COUNT)
+        {
+          std::stringstream err;
+          err << "invalid instruction set: " << level;
+          BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
+        }
+        cpu_level = static_cast<math::CpuLevel>(ii);
+      }
+      if(vmap.count("compare-engine"))
+      {
+        compare_engine = get_engine(vmap["compare-engine"].as<std::string>());
+        compare = true;
+      }
+      if(vmap.count("distance-engine"))
       {
-        dropdown = vmap["dropdown"].as<float>();
-        if((0.0f >= dropdown) || (1.0f <= dropdown))
+        distance_engine = get_engine(vmap["distance-engine"].as<std::string>());
+      }
+      if(vmap.count("distance-mode"))
+      {
+        std::string mode = vmap["distance-mode"].as<std::string>();
+        if(mode == "binary")
+        {
+          distance_mode = DISTANCE_BINARY;
+        }
+        else if(mode == "coverage")
+        {
+          distance_mode = DISTANCE_COVERAGE;
+        }
+        else if(mode == "msdf")
+        {
+          distance_mode = DISTANCE_MSDF;
+        }
+        else
         {
           std::stringstream err;
-          err << "invalid distance scale" << dropdown;
+          err << "invalid distance mode: " << mode;
           BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
         }
       }
+      if(vmap.count("dropdown"))
+      {
+        BOOST_FOREACH(float vv, vmap["dropdown"].as<std::vector<float> >())
+        {
+          if((0.0f >= vv) || (1.0f <= vv))
+          {
+            std::stringstream err;
+            err << "invalid distance scale" << vv;
+            BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
+          }
+          dropdowns.push_back(vv);
+        }
+
+        // Largest dropdown is the one distances are searched for.
+        std::sort(dropdowns.begin(), dropdowns.end(), std::greater<float>());
+        dropdowns.erase(std::unique(dropdowns.begin(), dropdowns.end()), dropdowns.end());
+      }
+      else
+      {
+        dropdowns.push_back(dropdown);
+      }
       if(vmap.count("font"))
       {
         font_names = vmap["font"].as< std::vector<std::string> >();
       }
+      if(vmap.count("include-from-text"))
+      {
+        text_names = vmap["include-from-text"].as< std::vector<std::string> >();
+      }
       if((1 >= argc) || vmap.count("help"))
       {
         std::cout << g_usage_front;
@@ -241,6 +970,21 @@ int main(int argc, char **argv)
         std::cout << g_usage_back << desc << std::endl;
         return 0;
       }
+      if(vmap.count("memory-limit"))
+      {
+        memory_limit = vmap["memory-limit"].as<unsigned>();
+        if(memory_limit <= 0)
+        {
+          std::stringstream err;
+          err << "invalid memory limit" << memory_limit;
+          BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
+        }
+        glyphs.getBitmapPool().setLimit(static_cast<size_t>(memory_limit) * 1024 * 1024);
+      }
+      if(vmap.count("metrics-only"))
+      {
+        metrics_only = true;
+      }
       if(vmap.count("outfile"))
       {
         if(output_path.generic_string().length() > 0)
@@ -257,6 +1001,14 @@ int main(int argc, char **argv)
           BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
         }
       }
+      if(vmap.count("pipeline"))
+      {
+        pipeline = true;
+      }
+      if(vmap.count("plan"))
+      {
+        plan = true;
+      }
       if(vmap.count("precalc-size"))
       {
         precalc_size = vmap["precalc-size"].as<unsigned>();
@@ -269,17 +1021,32 @@ int main(int argc, char **argv)
       }
       if(vmap.count("target-size"))
       {
-        target_size = vmap["target-size"].as<unsigned>();
-        if(target_size <= 0)
+        BOOST_FOREACH(unsigned vv, vmap["target-size"].as<std::vector<unsigned> >())
         {
-          std::stringstream err;
-          err << "invalid crunch size" << target_size;
-          BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
+          if(vv <= 0)
+          {
+            std::stringstream err;
+            err << "invalid crunch size" << vv;
+            BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
+          }
+          if(target_sizes.end() == std::find(target_sizes.begin(), target_sizes.end(), vv))
+          {
+            target_sizes.push_back(vv);
+          }
         }
       }
+      else
+      {
+        target_sizes.push_back(target_size);
+      }
       if(vmap.count("verbose"))
       {
-        g_verbose = true;
+        verbose = true;
+      }
+      if(vmap.count("dump-glyphs"))
+      {
+        dump_glyphs = true;
+        verbose = true;
       }
       if(vmap.count("version"))
       {
@@ -349,7 +1116,7 @@ int main(int argc, char **argv)
         BOOST_FOREACH(const std::string &ii, segments)
         {
           RangeMap::iterator iter = ranges.find(ii);
-          if(ranges.end() == iter)
+          if(ranges.end() != iter)
           {
             iter->second.disable();
           }
@@ -364,6 +1131,7 @@ int main(int argc, char **argv)
                 vv.second.remove(uu1, uu2);
               }
               extra_range.remove(uu1, uu2);
+              revoked_range.add(uu1, uu2);
             }
             else if(1 == sscanf(ii.c_str(), "%u", &uu1))
             {
@@ -372,6 +1140,7 @@ int main(int argc, char **argv)
                 vv.second.remove(uu1);
               }
               extra_range.remove(uu1);
+              revoked_range.add(uu1);
             }
             else
             {
@@ -385,7 +1154,7 @@ int main(int argc, char **argv)
     }
 
     // perform sanity checks
-    if(output_path.generic_string().length() <= 0)
+    if((output_path.generic_string().length() <= 0) && !compare && !plan)
     {
       can_execute = false;
 
@@ -396,10 +1165,6 @@ int main(int argc, char **argv)
         BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
       }
     }
-    else if(g_verbose)
-    {
-      std::cout << "Using output file base: " << output_path << std::endl;
-    }
 
     if(font_names.empty())
     {
@@ -421,85 +1186,154 @@ int main(int argc, char **argv)
       return 0;
     }
 
-    // load fonts
-    BOOST_FOREACH(std::string &vv, font_names)
-    {
-      fonts.push_back(boost::shared_ptr<FtFace>(new FtFace(vv, precalc_size, dropdown)));
-    }
+    cpu_level = math::cpu_init(cpu_level);
 
-    // Perform the actual generation of the glyphs.
-    if(g_verbose)
-    {
-      std::cout << "Rendering:";
-      std::cout.flush();
-    }
-    thr::thr_init();
+    if(verbose)
     {
-      boost::thread render_thread(boost::bind(queue_glyphs, boost::ref(ranges), boost::ref(glyphs), boost::ref(fonts), target_size));
-      thr::thr_main();
+      prog::prog_init(dump_glyphs);
+
+      std::ostringstream sstr;
+      sstr << "Using output file base: " << output_path;
+      prog::message(sstr.str());
+
+      sstr.str("");
+      sstr << "Using instruction set: " << math::cpu_level_name(cpu_level);
+      prog::message(sstr.str());
     }
-    glyphs.sort();
 
-    // Open the XML file and write the header.
-    std::string xmlfilename(output_path.generic_string() + std::string(".xml"));
-    FILE *xmlfile = fopen(xmlfilename.c_str(), "wt");
-    if(!xmlfile)
+    // load fonts
+    BOOST_FOREACH(std::string &vv, font_names)
     {
-      std::stringstream err;
-      err << "could not open " << xmlfilename << "for writing";
-      BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
+      fonts.push_back(boost::shared_ptr<FtFace>(new FtFace(vv, precalc_size, dropdowns.front(),
+              distance_mode, distance_engine, adaptive_tolerance)));
     }
-    fputs("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
-        "<font xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
-        "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\">\n",
-        xmlfile);
 
-    // Perform fitting along the skyline algorithm.
-    for(unsigned image_index = 0; (!glyphs.empty()); ++image_index)
+    thr::thr_init();
+
+    // Collect characters used in text files.
+    if(!text_names.empty())
     {
-      if(g_verbose)
+      CorpusScanner scanner;
+      BOOST_FOREACH(const std::string &vv, text_names)
       {
-        std::cout << std::endl << ((0 >= image_index) ? "Start" : "Continue") << " fitting process: " <<
-          glyphs.size() << " glyphs left\n";
+        scanner.addFile(vv);
       }
 
-      SkyLineFitter slf(2048);
+      prog::phase("Scanning text", scanner.getChunkCount(), "chunks");
       {
-        boost::thread fit_thread(boost::bind(fit_glyphs, boost::ref(slf), boost::ref(glyphs)));
+        boost::thread scan_thread(boost::bind(scan_text, boost::ref(scanner)));
         thr::thr_main();
       }
 
-      SkyLine sl(slf.getBestWidth(), slf.getBestHeight());
+      GlyphRange text_range = scanner.getRange();
+      text_range.remove(revoked_range);
+      text_range.enable();
+      ranges[std::string("text")] = text_range;
+    }
 
-      sl.fitAll(glyphs, xmlfile, image_index, opengl_coordinates);
+    // Comparing engines replaces the actual generation of the glyphs.
+    if(compare)
+    {
+      compare_engines(ranges, font_names, glyphs.getBitmapPool(), precalc_size, target_sizes, dropdowns,
+          distance_mode, distance_engine, compare_engine);
+      prog::prog_quit();
+      return 0;
+    }
 
-      glyphs.trim(); // will also sort
+    // Metrics need nothing rendered, estimated or fitted.
+    if(metrics_only)
+    {
+      measure_font(ranges, glyphs, fonts, output_path.generic_string(), opengl_coordinates);
+      prog::phase("");
+      prog::message("Done.");
+      prog::prog_quit();
+      return 0;
+    }
 
-      std::ostringstream sstr;
-      sstr << output_path.generic_string() << '_' << image_index << ".png";
-      fs::path pngfilepath(sstr.str());
-      std::string pngfilename(pngfilepath.generic_string());
+    // Estimates order crunching, planning and pipelined layout predict pages from the same glyphs.
+    std::vector<GlyphEstimate> estimates;
+    estimate_glyphs(ranges, fonts, estimates);
 
-      fprintf(xmlfile, "\t<texture>%s</texture>\n", pngfilename.c_str());
-      sl.save(pngfilename);
+    // Planning replaces the actual generation of the glyphs.
+    if(plan)
+    {
+      plan_font(estimates, fonts, target_sizes, dropdowns);
+      prog::prog_quit();
+      return 0;
     }
 
-    // Close the XML file.
-    fputs("</font>", xmlfile);
-    fclose(xmlfile);
+    // Pipelined pages are laid out before crunching starts.
+    if(pipeline)
+    {
+      BOOST_FOREACH(unsigned ii, target_sizes)
+      {
+        BOOST_FOREACH(float jj, dropdowns)
+        {
+          unsigned unfitted;
+          glyphs.addLayout(layout_glyphs(estimates, fonts, ii, jj, PIPELINE_SLACK, unfitted));
+        }
+      }
+      prog::phase("");
+    }
+
+    // Perform the actual generation of the glyphs.
+    {
+      unsigned glyph_count = 0;
+      BOOST_FOREACH(const RangeMap::value_type &vv, ranges)
+      {
+        glyph_count += vv.second.size();
+      }
+      prog::phase("Rendering", glyph_count * static_cast<unsigned>(target_sizes.size() * dropdowns.size()), "glyphs");
+    }
+    {
+      boost::thread render_thread(boost::bind(queue_glyphs, boost::ref(estimates), boost::ref(glyphs), boost::ref(fonts), boost::cref(target_sizes), boost::cref(dropdowns)));
+      thr::thr_main();
+    }
+    glyphs.sort();
 
-    if(g_verbose)
+    if((1 >= target_sizes.size()) && (1 >= dropdowns.size()))
     {
-      std::cout << "\nDone.\n";
+      write_font(glyphs, glyphs.findLayout(target_sizes.front(), dropdowns.front()), output_path.generic_string(),
+          opengl_coordinates);
     }
+    else
+    {
+      BOOST_FOREACH(unsigned ii, target_sizes)
+      {
+        BOOST_FOREACH(float jj, dropdowns)
+        {
+          GlyphStorage variant_glyphs;
+          glyphs.extract(variant_glyphs, ii, jj);
+          variant_glyphs.sort();
+
+          std::ostringstream sstr;
+          sstr << output_path.generic_string();
+          if(1 < target_sizes.size())
+          {
+            sstr << '_' << ii;
+          }
+          if(1 < dropdowns.size())
+          {
+            sstr << "_d" << jj;
+          }
+          write_font(variant_glyphs, glyphs.findLayout(ii, jj), sstr.str(), opengl_coordinates);
+        }
+      }
+    }
+
+    prog::phase("");
+    prog::message("Done.");
+    prog::prog_quit();
   }
   catch(const boost::exception &err)
   {
+    prog::prog_quit();
     std::cerr << boost::diagnostic_information(err);
     return 1;
   }
   catch(...)
   {
+    prog::prog_quit();
     std::cerr << "Unkown exception caught!" << std::endl;
     return -1;
   }
@@ -0,0 +1,149 @@
+#include "math/cpu.hpp"
+
+#include <vector>
+
+#if defined(MATH_CPU_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+using namespace math;
+
+/** \brief Get the kernel registry.
+ *
+ * \return Every constructed kernel.
+ */
+static std::vector<CpuKernelBase*>& get_kernels()
+{
+  static std::vector<CpuKernelBase*> kernels;
+
+  return kernels;
+}
+
+#if defined(MATH_CPU_X86)
+/** \brief Execute cpuid.
+ *
+ * \param leaf Leaf.
+ * \param subleaf Subleaf.
+ * \param regs Output eax, ebx, ecx, edx.
+ */
+static void cpuid(unsigned leaf, unsigned subleaf, unsigned *regs)
+{
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+  for(unsigned ii = 0; (ii < 4); ++ii)
+  {
+    regs[ii] = static_cast<unsigned>(info[ii]);
+  }
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+/** \brief Read the extended control register telling which register states the operating system saves.
+ *
+ * \return Low half of XCR0.
+ */
+static unsigned xgetbv()
+{
+#if defined(_MSC_VER)
+  return static_cast<unsigned>(_xgetbv(0));
+#else
+  unsigned eax, edx;
+  __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return eax;
+#endif
+}
+#endif
+
+CpuKernelBase::CpuKernelBase()
+{
+  get_kernels().push_back(this);
+}
+
+CpuLevel math::cpu_detect()
+{
+#if defined(MATH_CPU_X86)
+  unsigned regs[4];
+
+  cpuid(0, 0, regs);
+  unsigned max_leaf = regs[0];
+  if(1 > max_leaf)
+  {
+    return CPU_SCALAR;
+  }
+
+  cpuid(1, 0, regs);
+  if(0 == (regs[3] & (1u << 26)))
+  {
+    return CPU_SCALAR;
+  }
+  // SSE4.2 implies SSSE3 and SSE4.1.
+  if(0 == (regs[2] & (1u << 20)))
+  {
+    return CPU_SSE2;
+  }
+  // AVX requires the operating system to save YMM state.
+  if((0 == (regs[2] & (1u << 27))) || (0 == (regs[2] & (1u << 28))) || (7 > max_leaf))
+  {
+    return CPU_SSE42;
+  }
+  unsigned xcr0 = xgetbv();
+  if(0x6 != (xcr0 & 0x6))
+  {
+    return CPU_SSE42;
+  }
+
+  cpuid(7, 0, regs);
+  if(0 == (regs[1] & (1u << 5)))
+  {
+    return CPU_SSE42;
+  }
+  // AVX-512 foundation and byte/word instructions, and opmask and ZMM state saved.
+  if((0 == (regs[1] & (1u << 16))) || (0 == (regs[1] & (1u << 30))) || (0xE6 != (xcr0 & 0xE6)))
+  {
+    return CPU_AVX2;
+  }
+  return CPU_AVX512;
+#else
+  return CPU_SCALAR;
+#endif
+}
+
+CpuLevel math::cpu_init(CpuLevel op)
+{
+  CpuLevel ret = std::min(cpu_detect(), op);
+
+  BOOST_FOREACH(CpuKernelBase *vv, get_kernels())
+  {
+    vv->select(ret);
+  }
+
+  return ret;
+}
+
+const char* math::cpu_level_name(CpuLevel op)
+{
+  switch(op)
+  {
+    case CPU_SSE2:
+      return "sse2";
+
+    case CPU_SSE42:
+      return "sse4.2";
+
+    case CPU_AVX2:
+      return "avx2";
+
+    case CPU_AVX512:
+      return "avx512";
+
+    case CPU_SCALAR:
+    default:
+      return "scalar";
+  }
+}
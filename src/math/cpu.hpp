@@ -0,0 +1,152 @@
+#ifndef MATH_CPU_HPP
+#define MATH_CPU_HPP
+
+#include "defaults.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+/** Compiling for x86, CPU features may be detected and kernel variants compiled. */
+#define MATH_CPU_X86 1
+#endif
+
+#if defined(MATH_CPU_X86) && defined(__GNUC__)
+/** Compile a single function for a given instruction set regardless of the baseline target. */
+#define MATH_CPU_TARGET(op) __attribute__((target(op)))
+#else
+/** Compile a single function for a given instruction set regardless of the baseline target. */
+#define MATH_CPU_TARGET(op)
+#endif
+
+namespace math
+{
+  /** \brief Instruction set levels kernels may have variants for.
+   *
+   * Every level implies all levels below it.
+   */
+  enum CpuLevel
+  {
+    /** Plain C++. */
+    CPU_SCALAR = 0,
+
+    /** SSE2. */
+    CPU_SSE2,
+
+    /** SSE4.2 (and everything up to it). */
+    CPU_SSE42,
+
+    /** AVX2. */
+    CPU_AVX2,
+
+    /** AVX-512 foundation and byte/word instructions. */
+    CPU_AVX512,
+
+    /** Number of levels. */
+    CPU_LEVEL_COUNT
+  };
+
+  /** \brief Base class for dispatched kernels.
+   *
+   * Kernels register themselves on construction, so they must be constructed statically.
+   */
+  class CpuKernelBase
+  {
+    public:
+      /** \brief Constructor.
+       */
+      CpuKernelBase();
+
+      /** \brief Destructor.
+       */
+      virtual ~CpuKernelBase() { }
+
+    public:
+      /** \brief Select the variant to use.
+       *
+       * \param op Highest level that may be used.
+       */
+      virtual void select(CpuLevel op) = 0;
+  };
+
+  /** \brief Kernel with variants for different instruction set levels.
+   *
+   * Scalar variant is used until cpu_init() is called.
+   */
+  template<typename F> class CpuKernel : public CpuKernelBase
+  {
+    private:
+      /** Variants, NULL for none. */
+      F m_variants[CPU_LEVEL_COUNT];
+
+      /** Selected variant. */
+      F m_selected;
+
+    public:
+      /** \brief Constructor.
+       *
+       * \param pscalar Scalar variant, must exist.
+       * \param psse2 SSE2 variant or NULL.
+       * \param psse42 SSE4.2 variant or NULL.
+       * \param pavx2 AVX2 variant or NULL.
+       * \param pavx512 AVX-512 variant or NULL.
+       */
+      CpuKernel(F pscalar, F psse2, F psse42, F pavx2, F pavx512) :
+        m_selected(pscalar)
+      {
+        BOOST_ASSERT(NULL != pscalar);
+
+        m_variants[CPU_SCALAR] = pscalar;
+        m_variants[CPU_SSE2] = psse2;
+        m_variants[CPU_SSE42] = psse42;
+        m_variants[CPU_AVX2] = pavx2;
+        m_variants[CPU_AVX512] = pavx512;
+      }
+
+    public:
+      /** \cond */
+      virtual void select(CpuLevel op)
+      {
+        for(int ii = static_cast<int>(op); (ii >= 0); --ii)
+        {
+          if(NULL != m_variants[ii])
+          {
+            m_selected = m_variants[ii];
+            return;
+          }
+        }
+      }
+      /** \endcond */
+
+    public:
+      /** \brief Get the selected variant.
+       *
+       * \return Function pointer.
+       */
+      inline F get() const
+      {
+        return m_selected;
+      }
+  };
+
+  /** \brief Detect the highest level supported by the CPU and the operating system.
+   *
+   * \return Detected level.
+   */
+  CpuLevel cpu_detect();
+
+  /** \brief Select kernel variants.
+   *
+   * Must be called before any threads using kernels are started.
+   *
+   * \param op Highest level that may be used, capped to what is detected.
+   * \return Level selected.
+   */
+  CpuLevel cpu_init(CpuLevel op = CPU_AVX512);
+
+  /** \brief Get the name of a level.
+   *
+   * \param op Level.
+   * \return Name, as accepted on the command line.
+   */
+  const char* cpu_level_name(CpuLevel op);
+}
+
+#endif
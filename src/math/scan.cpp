@@ -0,0 +1,711 @@
+#include "math/scan.hpp"
+
+#include "math/cpu.hpp"
+
+#if defined(MATH_CPU_X86)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+using namespace math;
+
+/** Convenience typedef. */
+typedef unsigned (*FindMsbFunc)(const uint8_t*, unsigned, bool);
+
+/** Convenience typedef. */
+typedef unsigned (*FindValueFunc)(const unsigned*, unsigned, unsigned);
+
+/** Convenience typedef. */
+typedef void (*FindMinMaxFunc)(const unsigned*, unsigned, unsigned&, unsigned&);
+
+/** \brief Scalar variant of find_msb_forward().
+ *
+ * \param data Bytes to examine.
+ * \param count Number of bytes.
+ * \param set Top bit value to look for.
+ * \return Index of the first such byte, count if none.
+ */
+static unsigned find_msb_forward_scalar(const uint8_t *data, unsigned count, bool set)
+{
+  for(unsigned ii = 0; (ii < count); ++ii)
+  {
+    if((127 < data[ii]) == set)
+    {
+      return ii;
+    }
+  }
+  return count;
+}
+
+/** \brief Scalar variant of find_msb_backward().
+ *
+ * \param data Bytes to examine.
+ * \param count Number of bytes.
+ * \param set Top bit value to look for.
+ * \return Index of the last such byte, count if none.
+ */
+static unsigned find_msb_backward_scalar(const uint8_t *data, unsigned count, bool set)
+{
+  for(unsigned ii = count; (ii > 0); --ii)
+  {
+    if((127 < data[ii - 1]) == set)
+    {
+      return ii - 1;
+    }
+  }
+  return count;
+}
+
+/** \brief Scalar variant of find_equal().
+ *
+ * \param data Values to examine.
+ * \param count Number of values.
+ * \param value Value to look for.
+ * \return Index of the first such value, count if none.
+ */
+static unsigned find_equal_scalar(const unsigned *data, unsigned count, unsigned value)
+{
+  for(unsigned ii = 0; (ii < count); ++ii)
+  {
+    if(data[ii] == value)
+    {
+      return ii;
+    }
+  }
+  return count;
+}
+
+/** \brief Scalar variant of find_greater().
+ *
+ * \param data Values to examine.
+ * \param count Number of values.
+ * \param value Value to compare to.
+ * \return Index of the first such value, count if none.
+ */
+static unsigned find_greater_scalar(const unsigned *data, unsigned count, unsigned value)
+{
+  for(unsigned ii = 0; (ii < count); ++ii)
+  {
+    if(data[ii] > value)
+    {
+      return ii;
+    }
+  }
+  return count;
+}
+
+/** \brief Scalar variant of find_min_max().
+ *
+ * \param data Values to examine.
+ * \param count Number of values.
+ * \param minv Minimum.
+ * \param maxv Maximum.
+ */
+static void find_min_max_scalar(const unsigned *data, unsigned count, unsigned &minv, unsigned &maxv)
+{
+  unsigned lo = UINT_MAX,
+           hi = 0;
+
+  for(unsigned ii = 0; (ii < count); ++ii)
+  {
+    lo = std::min(lo, data[ii]);
+    hi = std::max(hi, data[ii]);
+  }
+
+  minv = lo;
+  maxv = hi;
+}
+
+#if defined(MATH_CPU_X86)
+
+/** \brief Count trailing zero bits.
+ *
+ * \param op Nonzero value.
+ * \return Number of trailing zero bits.
+ */
+static inline unsigned count_trailing_zeros(uint32_t op)
+{
+#if defined(_MSC_VER)
+  unsigned long ret;
+  _BitScanForward(&ret, op);
+  return static_cast<unsigned>(ret);
+#else
+  return static_cast<unsigned>(__builtin_ctz(op));
+#endif
+}
+
+/** \brief Count trailing zero bits of a 64-bit value.
+ *
+ * \param op Nonzero value.
+ * \return Number of trailing zero bits.
+ */
+static inline unsigned count_trailing_zeros(uint64_t op)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long ret;
+  _BitScanForward64(&ret, op);
+  return static_cast<unsigned>(ret);
+#elif defined(_MSC_VER)
+  uint32_t low = static_cast<uint32_t>(op);
+  return (0 != low) ? count_trailing_zeros(low) : (32 + count_trailing_zeros(static_cast<uint32_t>(op >> 32)));
+#else
+  return static_cast<unsigned>(__builtin_ctzll(op));
+#endif
+}
+
+/** \brief Find the highest set bit.
+ *
+ * \param op Nonzero value.
+ * \return Index of the highest set bit.
+ */
+static inline unsigned find_last_set(uint32_t op)
+{
+#if defined(_MSC_VER)
+  unsigned long ret;
+  _BitScanReverse(&ret, op);
+  return static_cast<unsigned>(ret);
+#else
+  return 31u - static_cast<unsigned>(__builtin_clz(op));
+#endif
+}
+
+/** \brief Find the highest set bit of a 64-bit value.
+ *
+ * \param op Nonzero value.
+ * \return Index of the highest set bit.
+ */
+static inline unsigned find_last_set(uint64_t op)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long ret;
+  _BitScanReverse64(&ret, op);
+  return static_cast<unsigned>(ret);
+#elif defined(_MSC_VER)
+  uint32_t high = static_cast<uint32_t>(op >> 32);
+  return (0 != high) ? (32 + find_last_set(high)) : find_last_set(static_cast<uint32_t>(op));
+#else
+  return 63u - static_cast<unsigned>(__builtin_clzll(op));
+#endif
+}
+
+/** \brief SSE2 variant of find_msb_forward().
+ *
+ * \param data Bytes to examine.
+ * \param count Number of bytes.
+ * \param set Top bit value to look for.
+ * \return Index of the first such byte, count if none.
+ */
+MATH_CPU_TARGET("sse2") static unsigned find_msb_forward_sse2(const uint8_t *data, unsigned count, bool set)
+{
+  uint32_t invert = set ? 0u : 0xFFFFu;
+  unsigned ii = 0;
+
+  for(; (ii + 16 <= count); ii += 16)
+  {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + ii));
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(block)) ^ invert;
+
+    if(0 != mask)
+    {
+      return ii + count_trailing_zeros(mask);
+    }
+  }
+
+  return ii + find_msb_forward_scalar(data + ii, count - ii, set);
+}
+
+/** \brief SSE2 variant of find_msb_backward().
+ *
+ * \param data Bytes to examine.
+ * \param count Number of bytes.
+ * \param set Top bit value to look for.
+ * \return Index of the last such byte, count if none.
+ */
+MATH_CPU_TARGET("sse2") static unsigned find_msb_backward_sse2(const uint8_t *data, unsigned count, bool set)
+{
+  uint32_t invert = set ? 0u : 0xFFFFu;
+  unsigned ii = count;
+
+  for(; (ii >= 16); ii -= 16)
+  {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + ii - 16));
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(block)) ^ invert;
+
+    if(0 != mask)
+    {
+      return ii - 16 + find_last_set(mask);
+    }
+  }
+
+  unsigned ret = find_msb_backward_scalar(data, ii, set);
+  return (ret < ii) ? ret : count;
+}
+
+/** \brief SSE2 variant of find_equal().
+ *
+ * \param data Values to examine.
+ * \param count Number of values.
+ * \param value Value to look for.
+ * \return Index of the first such value, count if none.
+ */
+MATH_CPU_TARGET("sse2") static unsigned find_equal_sse2(const unsigned *data, unsigned count, unsigned value)
+{
+  __m128i cmp = _mm_set1_epi32(static_cast<int>(value));
+  unsigned ii = 0;
+
+  for(; (ii + 4 <= count); ii += 4)
+  {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + ii));
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, cmp))));
+
+    if(0 != mask)
+    {
+      return ii + count_trailing_zeros(mask);
+    }
+  }
+
+  return ii + find_equal_scalar(data + ii, count - ii, value);
+}
+
+/** \brief SSE2 variant of find_greater().
+ *
+ * SSE2 only compares signed values, both sides are biased to compare unsigned.
+ *
+ * \param data Values to examine.
+ * \param count Number of values.
+ * \param value Value to compare to.
+ * \return Index of the first such value, count if none.
+ */
+MATH_CPU_TARGET("sse2") static unsigned find_greater_sse2(const unsigned *data, unsigned count, unsigned value)
+{
+  __m128i bias = _mm_set1_epi32(INT_MIN);
+  __m128i cmp = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(value)), bias);
+  unsigned ii = 0;
+
+  for(; (ii + 4 <= count); ii += 4)
+  {
+    __m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + ii)), bias);
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(block, cmp))));
+
+    if(0 != mask)
+    {
+      return ii + count_trailing_zeros(mask);
+    }
+  }
+
+  return ii + find_greater_scalar(data + ii, count - ii, value);
+}
+
+/** \brief SSE4.2 variant of find_min_max().
+ *
+ * Unsigned minimum and maximum are SSE4.1 instructions.
+ *
+ * \param data Values to examine.
+ * \param count Number of values.
+ * \param minv Minimum.
+ * \param maxv Maximum.
+ */
+MATH_CPU_TARGET("sse4.2") static void find_min_max_sse42(const unsigned *data, unsigned count, unsigned &minv,
+    unsigned &maxv)
+{
+  __m128i lo = _mm_set1_epi32(-1);
+  __m128i hi = _mm_setzero_si128();
+  unsigned ii = 0;
+
+  for(; (ii + 4 <= count); ii += 4)
+  {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + ii));
+
+    lo = _mm_min_epu32(lo, block);
+    hi = _mm_max_epu32(hi, block);
+  }
+
+  lo = _mm_min_epu32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+  lo = _mm_min_epu32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+  hi = _mm_max_epu32(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+  hi = _mm_max_epu32(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+
+  unsigned tail_lo, tail_hi;
+  find_min_max_scalar(data + ii, count - ii, tail_lo, tail_hi);
+
+  minv = std::min(static_cast<unsigned>(_mm_cvtsi128_si32(lo)), tail_lo);
+  maxv = std::max(static_cast<unsigned>(_mm_cvtsi128_si32(hi)), tail_hi);
+}
+
+/** \brief AVX2 variant of find_msb_forward().
+ *
+ * \param data Bytes to examine.
+ * \param count Number of bytes.
+ * \param set Top bit value to look for.
+ * \return Index of the first such byte, count if none.
+ */
+MATH_CPU_TARGET("avx2") static unsigned find_msb_forward_avx2(const uint8_t *data, unsigned count, bool set)
+{
+  uint32_t invert = set ? 0u : 0xFFFFFFFFu;
+  unsigned ii = 0;
+
+  for(; (ii + 32 <= count); ii += 32)
+  {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + ii));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(block)) ^ invert;
+
+    if(0 != mask)
+    {
+      return ii + count_trailing_zeros(mask);
+    }
+  }
+
+  return ii + find_msb_forward_sse2(data + ii, count - ii, set);
+}
+
+/** \brief AVX2 variant of find_msb_backward().
+ *
+ * \param data Bytes to examine.
+ * \param count Number of bytes.
+ * \param set Top bit value to look for.
+ * \return Index of the last such byte, count if none.
+ */
+MATH_CPU_TARGET("avx2") static unsigned find_msb_backward_avx2(const uint8_t *data, unsigned count, bool set)
+{
+  uint32_t invert = set ? 0u : 0xFFFFFFFFu;
+  unsigned ii = count;
+
+  for(; (ii >= 32); ii -= 32)
+  {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + ii - 32));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(block)) ^ invert;
+
+    if(0 != mask)
+    {
+      return ii - 32 + find_last_set(mask);
+    }
+  }
+
+  unsigned ret = find_msb_backward_sse2(data, ii, set);
+  return (ret < ii) ? ret : count;
+}
+
+/** \brief AVX2 variant of find_equal().
+ *
+ * \param data Values to examine.
+ * \param count Number of values.
+ * \param value Value to look for.
+ * \return Index of the first such value, count if none.
+ */
+MATH_CPU_TARGET("avx2") static unsigned find_equal_avx2(const unsigned *data, unsigned count, unsigned value)
+{
+  __m256i cmp = _mm256_set1_epi32(static_cast<int>(value));
+  unsigned ii = 0;
+
+  for(; (ii + 8 <= count); ii += 8)
+  {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + ii));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(block,
+              cmp))));
+
+    if(0 != mask)
+    {
+      return ii + count_trailing_zeros(mask);
+    }
+  }
+
+  return ii + find_equal_scalar(data + ii, count - ii, value);
+}
+
+/** \brief AVX2 variant of find_greater().
+ *
+ * A value is not greater exactly when its unsigned maximum with the compared value is the compared value.
+ *
+ * \param data Values to examine.
+ * \param count Number of values.
+ * \param value Value to compare to.
+ * \return Index of the first such value, count if none.
+ */
+MATH_CPU_TARGET("avx2") static unsigned find_greater_avx2(const unsigned *data, unsigned count, unsigned value)
+{
+  __m256i cmp = _mm256_set1_epi32(static_cast<int>(value));
+  unsigned ii = 0;
+
+  for(; (ii + 8 <= count); ii += 8)
+  {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + ii));
+    __m256i not_greater = _mm256_cmpeq_epi32(_mm256_max_epu32(block, cmp), cmp);
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(not_greater))) ^ 0xFFu;
+
+    if(0 != mask)
+    {
+      return ii + count_trailing_zeros(mask);
+    }
+  }
+
+  return ii + find_greater_scalar(data + ii, count - ii, value);
+}
+
+/** \brief AVX2 variant of find_min_max().
+ *
+ * \param data Values to examine.
+ * \param count Number of values.
+ * \param minv Minimum.
+ * \param maxv Maximum.
+ */
+MATH_CPU_TARGET("avx2") static void find_min_max_avx2(const unsigned *data, unsigned count, unsigned &minv,
+    unsigned &maxv)
+{
+  __m256i lo = _mm256_set1_epi32(-1);
+  __m256i hi = _mm256_setzero_si256();
+  unsigned ii = 0;
+
+  for(; (ii + 8 <= count); ii += 8)
+  {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + ii));
+
+    lo = _mm256_min_epu32(lo, block);
+    hi = _mm256_max_epu32(hi, block);
+  }
+
+  __m128i lo4 = _mm_min_epu32(_mm256_castsi256_si128(lo), _mm256_extracti128_si256(lo, 1));
+  __m128i hi4 = _mm_max_epu32(_mm256_castsi256_si128(hi), _mm256_extracti128_si256(hi, 1));
+  lo4 = _mm_min_epu32(lo4, _mm_shuffle_epi32(lo4, _MM_SHUFFLE(1, 0, 3, 2)));
+  lo4 = _mm_min_epu32(lo4, _mm_shuffle_epi32(lo4, _MM_SHUFFLE(2, 3, 0, 1)));
+  hi4 = _mm_max_epu32(hi4, _mm_shuffle_epi32(hi4, _MM_SHUFFLE(1, 0, 3, 2)));
+  hi4 = _mm_max_epu32(hi4, _mm_shuffle_epi32(hi4, _MM_SHUFFLE(2, 3, 0, 1)));
+
+  unsigned tail_lo, tail_hi;
+  find_min_max_scalar(data + ii, count - ii, tail_lo, tail_hi);
+
+  minv = std::min(static_cast<unsigned>(_mm_cvtsi128_si32(lo4)), tail_lo);
+  maxv = std::max(static_cast<unsigned>(_mm_cvtsi128_si32(hi4)), tail_hi);
+}
+
+/** \brief Get a mask for the first elements of an AVX-512 register.
+ *
+ * \param count Number of elements, less than 64.
+ * \return Mask.
+ */
+static inline uint64_t get_avx512_tail_mask(unsigned count)
+{
+  return (static_cast<uint64_t>(1) << count) - 1;
+}
+
+/** \brief AVX-512 variant of find_msb_forward().
+ *
+ * The partial block at the end is read with a masked load that does not touch bytes past the end.
+ *
+ * \param data Bytes to examine.
+ * \param count Number of bytes.
+ * \param set Top bit value to look for.
+ * \return Index of the first such byte, count if none.
+ */
+MATH_CPU_TARGET("avx512f,avx512bw") static unsigned find_msb_forward_avx512(const uint8_t *data,
+    unsigned count, bool set)
+{
+  uint64_t invert = set ? static_cast<uint64_t>(0) : ~static_cast<uint64_t>(0);
+  unsigned ii = 0;
+
+  for(; (ii + 64 <= count); ii += 64)
+  {
+    __m512i block = _mm512_loadu_si512(data + ii);
+    uint64_t mask = static_cast<uint64_t>(_mm512_movepi8_mask(block)) ^ invert;
+
+    if(0 != mask)
+    {
+      return ii + count_trailing_zeros(mask);
+    }
+  }
+
+  if(ii < count)
+  {
+    uint64_t load_mask = get_avx512_tail_mask(count - ii);
+    __m512i block = _mm512_maskz_loadu_epi8(load_mask, data + ii);
+    uint64_t mask = (static_cast<uint64_t>(_mm512_movepi8_mask(block)) ^ invert) & load_mask;
+
+    if(0 != mask)
+    {
+      return ii + count_trailing_zeros(mask);
+    }
+  }
+
+  return count;
+}
+
+/** \brief AVX-512 variant of find_msb_backward().
+ *
+ * \param data Bytes to examine.
+ * \param count Number of bytes.
+ * \param set Top bit value to look for.
+ * \return Index of the last such byte, count if none.
+ */
+MATH_CPU_TARGET("avx512f,avx512bw") static unsigned find_msb_backward_avx512(const uint8_t *data,
+    unsigned count, bool set)
+{
+  uint64_t invert = set ? static_cast<uint64_t>(0) : ~static_cast<uint64_t>(0);
+  unsigned ii = count;
+
+  for(; (ii >= 64); ii -= 64)
+  {
+    __m512i block = _mm512_loadu_si512(data + ii - 64);
+    uint64_t mask = static_cast<uint64_t>(_mm512_movepi8_mask(block)) ^ invert;
+
+    if(0 != mask)
+    {
+      return ii - 64 + find_last_set(mask);
+    }
+  }
+
+  if(0 < ii)
+  {
+    uint64_t load_mask = get_avx512_tail_mask(ii);
+    __m512i block = _mm512_maskz_loadu_epi8(load_mask, data);
+    uint64_t mask = (static_cast<uint64_t>(_mm512_movepi8_mask(block)) ^ invert) & load_mask;
+
+    if(0 != mask)
+    {
+      return find_last_set(mask);
+    }
+  }
+
+  return count;
+}
+
+/** \brief AVX-512 variant of find_equal().
+ *
+ * \param data Values to examine.
+ * \param count Number of values.
+ * \param value Value to look for.
+ * \return Index of the first such value, count if none.
+ */
+MATH_CPU_TARGET("avx512f,avx512bw") static unsigned find_equal_avx512(const unsigned *data, unsigned count,
+    unsigned value)
+{
+  __m512i cmp = _mm512_set1_epi32(static_cast<int>(value));
+
+  for(unsigned ii = 0; (ii < count); ii += 16)
+  {
+    __mmask16 load_mask = static_cast<__mmask16>(get_avx512_tail_mask(std::min(count - ii, 16u)));
+    __m512i block = _mm512_maskz_loadu_epi32(load_mask, data + ii);
+    uint32_t mask = static_cast<uint32_t>(_mm512_mask_cmpeq_epu32_mask(load_mask, block, cmp));
+
+    if(0 != mask)
+    {
+      return ii + count_trailing_zeros(mask);
+    }
+  }
+
+  return count;
+}
+
+/** \brief AVX-512 variant of find_greater().
+ *
+ * \param data Values to examine.
+ * \param count Number of values.
+ * \param value Value to compare to.
+ * \return Index of the first such value, count if none.
+ */
+MATH_CPU_TARGET("avx512f,avx512bw") static unsigned find_greater_avx512(const unsigned *data, unsigned count,
+    unsigned value)
+{
+  __m512i cmp = _mm512_set1_epi32(static_cast<int>(value));
+
+  for(unsigned ii = 0; (ii < count); ii += 16)
+  {
+    __mmask16 load_mask = static_cast<__mmask16>(get_avx512_tail_mask(std::min(count - ii, 16u)));
+    __m512i block = _mm512_maskz_loadu_epi32(load_mask, data + ii);
+    uint32_t mask = static_cast<uint32_t>(_mm512_mask_cmpgt_epu32_mask(load_mask, block, cmp));
+
+    if(0 != mask)
+    {
+      return ii + count_trailing_zeros(mask);
+    }
+  }
+
+  return count;
+}
+
+/** \brief AVX-512 variant of find_min_max().
+ *
+ * \param data Values to examine.
+ * \param count Number of values.
+ * \param minv Minimum.
+ * \param maxv Maximum.
+ */
+MATH_CPU_TARGET("avx512f,avx512bw") static void find_min_max_avx512(const unsigned *data, unsigned count,
+    unsigned &minv, unsigned &maxv)
+{
+  __m512i lo = _mm512_set1_epi32(-1);
+  __m512i hi = _mm512_setzero_si512();
+
+  // Only defined lanes are written to avoid the undefined sources of unmasked intrinsics.
+  for(unsigned ii = 0; (ii < count); ii += 16)
+  {
+    __mmask16 load_mask = static_cast<__mmask16>(get_avx512_tail_mask(std::min(count - ii, 16u)));
+    __m512i block = _mm512_maskz_loadu_epi32(load_mask, data + ii);
+
+    lo = _mm512_mask_min_epu32(lo, load_mask, lo, block);
+    hi = _mm512_mask_max_epu32(hi, load_mask, hi, block);
+  }
+
+  unsigned lanes_lo[16], lanes_hi[16];
+  _mm512_storeu_si512(lanes_lo, lo);
+  _mm512_storeu_si512(lanes_hi, hi);
+
+  find_min_max_scalar(lanes_lo, 16, minv, maxv);
+  unsigned ignored;
+  find_min_max_scalar(lanes_hi, 16, ignored, maxv);
+}
+
+/** Variant list helper. */
+#define MATH_SCAN_VARIANTS(scalar, sse2, sse42, avx2, avx512) scalar, sse2, sse42, avx2, avx512
+
+#else
+
+/** Variant list helper. */
+#define MATH_SCAN_VARIANTS(scalar, sse2, sse42, avx2, avx512) scalar, NULL, NULL, NULL, NULL
+
+#endif
+
+/** Kernel for find_msb_forward(). */
+static CpuKernel<FindMsbFunc> g_find_msb_forward(MATH_SCAN_VARIANTS(find_msb_forward_scalar,
+      find_msb_forward_sse2, NULL, find_msb_forward_avx2, find_msb_forward_avx512));
+
+/** Kernel for find_msb_backward(). */
+static CpuKernel<FindMsbFunc> g_find_msb_backward(MATH_SCAN_VARIANTS(find_msb_backward_scalar,
+      find_msb_backward_sse2, NULL, find_msb_backward_avx2, find_msb_backward_avx512));
+
+/** Kernel for find_equal(). */
+static CpuKernel<FindValueFunc> g_find_equal(MATH_SCAN_VARIANTS(find_equal_scalar, find_equal_sse2, NULL,
+      find_equal_avx2, find_equal_avx512));
+
+/** Kernel for find_greater(). */
+static CpuKernel<FindValueFunc> g_find_greater(MATH_SCAN_VARIANTS(find_greater_scalar, find_greater_sse2,
+      NULL, find_greater_avx2, find_greater_avx512));
+
+/** Kernel for find_min_max(). */
+static CpuKernel<FindMinMaxFunc> g_find_min_max(MATH_SCAN_VARIANTS(find_min_max_scalar, NULL,
+      find_min_max_sse42, find_min_max_avx2, find_min_max_avx512));
+
+unsigned math::find_msb_forward(const uint8_t *data, unsigned count, bool set)
+{
+  return g_find_msb_forward.get()(data, count, set);
+}
+
+unsigned math::find_msb_backward(const uint8_t *data, unsigned count, bool set)
+{
+  return g_find_msb_backward.get()(data, count, set);
+}
+
+unsigned math::find_equal(const unsigned *data, unsigned count, unsigned value)
+{
+  return g_find_equal.get()(data, count, value);
+}
+
+unsigned math::find_greater(const unsigned *data, unsigned count, unsigned value)
+{
+  return g_find_greater.get()(data, count, value);
+}
+
+void math::find_min_max(const unsigned *data, unsigned count, unsigned &minv, unsigned &maxv)
+{
+  g_find_min_max.get()(data, count, minv, maxv);
+}
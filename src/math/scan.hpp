@@ -0,0 +1,56 @@
+#ifndef MATH_SCAN_HPP
+#define MATH_SCAN_HPP
+
+#include "defaults.hpp"
+
+namespace math
+{
+  /** \brief Find the first byte with the top bit set, or clear.
+   *
+   * For 8-bit coverage values, the top bit is set exactly at or above half coverage.
+   *
+   * \param data Bytes to examine.
+   * \param count Number of bytes.
+   * \param set True to look for a byte with the top bit set, false to look for one with it clear.
+   * \return Index of the first such byte, count if none.
+   */
+  unsigned find_msb_forward(const uint8_t *data, unsigned count, bool set);
+
+  /** \brief Find the last byte with the top bit set, or clear.
+   *
+   * \param data Bytes to examine.
+   * \param count Number of bytes.
+   * \param set True to look for a byte with the top bit set, false to look for one with it clear.
+   * \return Index of the last such byte, count if none.
+   */
+  unsigned find_msb_backward(const uint8_t *data, unsigned count, bool set);
+
+  /** \brief Find the first value equal to a given value.
+   *
+   * \param data Values to examine.
+   * \param count Number of values.
+   * \param value Value to look for.
+   * \return Index of the first such value, count if none.
+   */
+  unsigned find_equal(const unsigned *data, unsigned count, unsigned value);
+
+  /** \brief Find the first value greater than a given value.
+   *
+   * \param data Values to examine.
+   * \param count Number of values.
+   * \param value Value to compare to.
+   * \return Index of the first such value, count if none.
+   */
+  unsigned find_greater(const unsigned *data, unsigned count, unsigned value);
+
+  /** \brief Find the minimum and maximum of values.
+   *
+   * \param data Values to examine.
+   * \param count Number of values.
+   * \param minv Minimum, UINT_MAX if no values.
+   * \param maxv Maximum, 0 if no values.
+   */
+  void find_min_max(const unsigned *data, unsigned count, unsigned &minv, unsigned &maxv);
+}
+
+#endif
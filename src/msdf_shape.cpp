@@ -0,0 +1,936 @@
+#include "msdf_shape.hpp"
+
+#include "math/generic.hpp"
+
+#include <float.h>
+
+#include FT_OUTLINE_H
+
+/** Corners are where edge directions turn more than this (in radians). */
+static const double CORNER_ANGLE = 3.0;
+
+/** Number of quadratic edges approximating one cubic edge. */
+static const unsigned CUBIC_SPLIT = 4;
+
+/** \brief Return the sign of a number, zero counting as positive.
+ *
+ * \param op Number.
+ * \return 1 or -1.
+ */
+static double nonzero_sign(double op)
+{
+  return (0.0 > op) ? -1.0 : 1.0;
+}
+
+/** \brief Solve a quadratic equation.
+ *
+ * \param dst Roots.
+ * \param a Second degree coefficient.
+ * \param b First degree coefficient.
+ * \param c Constant.
+ * \return Number of roots.
+ */
+static int solve_quadratic(double *dst, double a, double b, double c)
+{
+  if((0.0 == a) || (fabs(b) > 1e12 * fabs(a)))
+  {
+    if(0.0 == b)
+    {
+      return 0;
+    }
+    dst[0] = -c / b;
+    return 1;
+  }
+
+  double discriminant = b * b - 4.0 * a * c;
+
+  if(0.0 < discriminant)
+  {
+    discriminant = sqrt(discriminant);
+    dst[0] = (-b + discriminant) / (2.0 * a);
+    dst[1] = (-b - discriminant) / (2.0 * a);
+    return 2;
+  }
+  if(0.0 == discriminant)
+  {
+    dst[0] = -b / (2.0 * a);
+    return 1;
+  }
+  return 0;
+}
+
+/** \brief Solve a cubic equation.
+ *
+ * \param dst Roots.
+ * \param a Third degree coefficient.
+ * \param b Second degree coefficient.
+ * \param c First degree coefficient.
+ * \param d Constant.
+ * \return Number of roots.
+ */
+static int solve_cubic(double *dst, double a, double b, double c, double d)
+{
+  // Above this ratio, numerical error is larger than if the equation was quadratic.
+  if((0.0 == a) || (1e6 <= fabs(b / a)))
+  {
+    return solve_quadratic(dst, b, c, d);
+  }
+
+  double na = b / a;
+  double nb = c / a;
+  double nc = d / a;
+  double a2 = na * na;
+  double q = (a2 - 3.0 * nb) / 9.0;
+  double r = (na * (2.0 * a2 - 9.0 * nb) + 27.0 * nc) / 54.0;
+  double r2 = r * r;
+  double q3 = q * q * q;
+  double offset = na / 3.0;
+
+  if(r2 < q3)
+  {
+    double angle = acos(std::min(std::max(r / sqrt(q3), -1.0), 1.0));
+    double scale = -2.0 * sqrt(q);
+
+    dst[0] = scale * cos(angle / 3.0) - offset;
+    dst[1] = scale * cos((angle + 2.0 * M_PI) / 3.0) - offset;
+    dst[2] = scale * cos((angle - 2.0 * M_PI) / 3.0) - offset;
+    return 3;
+  }
+
+  double u = ((0.0 > r) ? 1.0 : -1.0) * pow(fabs(r) + sqrt(r2 - q3), 1.0 / 3.0);
+  double v = (0.0 == u) ? 0.0 : (q / u);
+
+  dst[0] = (u + v) - offset;
+  if((u == v) || (fabs(u - v) < 1e-12 * fabs(u + v)))
+  {
+    dst[1] = -0.5 * (u + v) - offset;
+    return 2;
+  }
+  return 1;
+}
+
+/** \brief Tell if the direction turns enough between two edges to make a corner.
+ *
+ * \param ax First direction X component.
+ * \param ay First direction Y component.
+ * \param bx Second direction X component.
+ * \param by Second direction Y component.
+ * \return True if corner, false if not.
+ */
+static bool is_corner(double ax, double ay, double bx, double by)
+{
+  double alen = sqrt(ax * ax + ay * ay);
+  double blen = sqrt(bx * bx + by * by);
+
+  if((0.0 >= alen) || (0.0 >= blen))
+  {
+    return true;
+  }
+
+  double dot = (ax * bx + ay * by) / (alen * blen);
+  double cross = (ax * by - ay * bx) / (alen * blen);
+
+  return (0.0 >= dot) || (fabs(cross) > sin(CORNER_ANGLE));
+}
+
+/** \brief Switch to the next edge color.
+ *
+ * Colors cycle through the two-channel colors. The banned color is avoided when there is a choice, so that
+ * the last edge of a contour differs from the first.
+ *
+ * \param color Color to switch.
+ * \param banned Color to avoid.
+ */
+static void switch_color(unsigned &color, unsigned banned)
+{
+  unsigned combined = color & banned;
+
+  if((MSDF_RED == combined) || (MSDF_GREEN == combined) || (MSDF_BLUE == combined))
+  {
+    color = combined ^ MSDF_WHITE;
+    return;
+  }
+  if((MSDF_BLACK == color) || (MSDF_WHITE == color))
+  {
+    color = MSDF_CYAN;
+    return;
+  }
+
+  unsigned shifted = color << 1;
+  color = (shifted | (shifted >> 3)) & MSDF_WHITE;
+}
+
+/** \brief Detect if a sample clashes with its neighbor.
+ *
+ * \param aa Sample.
+ * \param bb Neighbor.
+ * \param threshold Largest change of distance between neighboring samples.
+ * \return True if the sample clashes and is farther from the edge of the two.
+ */
+static bool detect_clash(const float *aa, const float *bb, float threshold)
+{
+  float a0 = aa[0];
+  float a1 = aa[1];
+  float a2 = aa[2];
+  float b0 = bb[0];
+  float b1 = bb[1];
+  float b2 = bb[2];
+
+  // Sort channel pairs from largest to smallest difference.
+  if(fabsf(b0 - a0) < fabsf(b1 - a1))
+  {
+    std::swap(a0, a1);
+    std::swap(b0, b1);
+  }
+  if(fabsf(b1 - a1) < fabsf(b2 - a2))
+  {
+    std::swap(a1, a2);
+    std::swap(b1, b2);
+    if(fabsf(b0 - a0) < fabsf(b1 - a1))
+    {
+      std::swap(a0, a1);
+      std::swap(b0, b1);
+    }
+  }
+
+  // Neighbors already equalized are not clashes.
+  return (fabsf(b1 - a1) >= threshold) && !((b0 == b1) && (b0 == b2)) && (fabsf(a2) >= fabsf(b2));
+}
+
+/** \brief Outline decomposition state.
+ */
+class MsdfDecomposer
+{
+  private:
+    /** Shape to add edges to. */
+    MsdfShape *m_shape;
+
+    /** Height for flipping rows. */
+    double m_rows;
+
+    /** Current X coordinate. */
+    double m_x;
+
+    /** Current Y coordinate. */
+    double m_y;
+
+  public:
+    /** \brief Constructor.
+     *
+     * \param pshape Shape to add edges to.
+     */
+    MsdfDecomposer(MsdfShape *pshape) :
+      m_shape(pshape),
+      m_rows(static_cast<double>(pshape->getRows())),
+      m_x(0.0),
+      m_y(0.0) { }
+
+  private:
+    /** \brief Convert an outline X coordinate.
+     *
+     * \param op Point.
+     * \return X coordinate in pixels.
+     */
+    static double getX(const FT_Vector *op)
+    {
+      return static_cast<double>(op->x) / 64.0;
+    }
+
+    /** \brief Convert an outline Y coordinate.
+     *
+     * \param op Point.
+     * \return Y coordinate in pixels, in row order.
+     */
+    double getY(const FT_Vector *op) const
+    {
+      return m_rows - static_cast<double>(op->y) / 64.0;
+    }
+
+  public:
+    /** \brief Start a contour.
+     *
+     * \param to Point to start at.
+     */
+    void moveTo(const FT_Vector *to)
+    {
+      m_shape->addContour();
+      m_x = getX(to);
+      m_y = this->getY(to);
+    }
+
+    /** \brief Add a linear edge.
+     *
+     * \param to End point.
+     */
+    void lineTo(const FT_Vector *to)
+    {
+      double x2 = getX(to);
+      double y2 = this->getY(to);
+
+      m_shape->addEdge(MsdfEdge(m_x, m_y, x2, y2));
+      m_x = x2;
+      m_y = y2;
+    }
+
+    /** \brief Add a quadratic edge.
+     *
+     * \param control Control point.
+     * \param to End point.
+     */
+    void conicTo(const FT_Vector *control, const FT_Vector *to)
+    {
+      double x2 = getX(to);
+      double y2 = this->getY(to);
+
+      m_shape->addEdge(MsdfEdge(m_x, m_y, getX(control), this->getY(control), x2, y2));
+      m_x = x2;
+      m_y = y2;
+    }
+
+    /** \brief Add a cubic edge as quadratic edges.
+     *
+     * \param control1 First control point.
+     * \param control2 Second control point.
+     * \param to End point.
+     */
+    void cubicTo(const FT_Vector *control1, const FT_Vector *control2, const FT_Vector *to)
+    {
+      double px[4] = { m_x, getX(control1), getX(control2), getX(to) };
+      double py[4] = { m_y, this->getY(control1), this->getY(control2), this->getY(to) };
+
+      for(unsigned ii = 0; (ii < CUBIC_SPLIT); ++ii)
+      {
+        double t1 = static_cast<double>(ii) / static_cast<double>(CUBIC_SPLIT);
+        double t2 = static_cast<double>(ii + 1) / static_cast<double>(CUBIC_SPLIT);
+        double ax, ay, bx, by, adx, ady, bdx, bdy;
+
+        evaluateCubic(px, py, t1, ax, ay, adx, ady);
+        evaluateCubic(px, py, t2, bx, by, bdx, bdy);
+
+        // Control point of the quadratic is averaged from the tangents at both ends of the piece.
+        double half = 0.5 * (t2 - t1);
+        double cx = 0.5 * ((ax + adx * half) + (bx - bdx * half));
+        double cy = 0.5 * ((ay + ady * half) + (by - bdy * half));
+
+        m_shape->addEdge(MsdfEdge(ax, ay, cx, cy, bx, by));
+      }
+
+      m_x = px[3];
+      m_y = py[3];
+    }
+
+  private:
+    /** \brief Evaluate a cubic curve.
+     *
+     * \param px Control point X coordinates.
+     * \param py Control point Y coordinates.
+     * \param op Curve parameter.
+     * \param rx Point X coordinate.
+     * \param ry Point Y coordinate.
+     * \param dx Derivative X component.
+     * \param dy Derivative Y component.
+     */
+    static void evaluateCubic(const double *px, const double *py, double op, double &rx, double &ry,
+        double &dx, double &dy)
+    {
+      double it = 1.0 - op;
+
+      rx = it * it * it * px[0] + 3.0 * it * it * op * px[1] + 3.0 * it * op * op * px[2] + op * op * op * px[3];
+      ry = it * it * it * py[0] + 3.0 * it * it * op * py[1] + 3.0 * it * op * op * py[2] + op * op * op * py[3];
+      dx = 3.0 * (it * it * (px[1] - px[0]) + 2.0 * it * op * (px[2] - px[1]) + op * op * (px[3] - px[2]));
+      dy = 3.0 * (it * it * (py[1] - py[0]) + 2.0 * it * op * (py[2] - py[1]) + op * op * (py[3] - py[2]));
+    }
+};
+
+/** \brief Outline decomposition callback.
+ *
+ * \param to Point to start at.
+ * \param user Decomposer.
+ * \return Zero.
+ */
+static int msdf_move_to(const FT_Vector *to, void *user)
+{
+  static_cast<MsdfDecomposer*>(user)->moveTo(to);
+  return 0;
+}
+
+/** \brief Outline decomposition callback.
+ *
+ * \param to End point.
+ * \param user Decomposer.
+ * \return Zero.
+ */
+static int msdf_line_to(const FT_Vector *to, void *user)
+{
+  static_cast<MsdfDecomposer*>(user)->lineTo(to);
+  return 0;
+}
+
+/** \brief Outline decomposition callback.
+ *
+ * \param control Control point.
+ * \param to End point.
+ * \param user Decomposer.
+ * \return Zero.
+ */
+static int msdf_conic_to(const FT_Vector *control, const FT_Vector *to, void *user)
+{
+  static_cast<MsdfDecomposer*>(user)->conicTo(control, to);
+  return 0;
+}
+
+/** \brief Outline decomposition callback.
+ *
+ * \param control1 First control point.
+ * \param control2 Second control point.
+ * \param to End point.
+ * \param user Decomposer.
+ * \return Zero.
+ */
+static int msdf_cubic_to(const FT_Vector *control1, const FT_Vector *control2, const FT_Vector *to, void *user)
+{
+  static_cast<MsdfDecomposer*>(user)->cubicTo(control1, control2, to);
+  return 0;
+}
+
+MsdfEdge::MsdfEdge(double x1, double y1, double x2, double y2) :
+  m_quadratic(false),
+  m_color(MSDF_WHITE)
+{
+  m_x[0] = x1;
+  m_y[0] = y1;
+  m_x[1] = 0.5 * (x1 + x2);
+  m_y[1] = 0.5 * (y1 + y2);
+  m_x[2] = x2;
+  m_y[2] = y2;
+}
+
+MsdfEdge::MsdfEdge(double x1, double y1, double cx, double cy, double x2, double y2) :
+  m_quadratic(true),
+  m_color(MSDF_WHITE)
+{
+  m_x[0] = x1;
+  m_y[0] = y1;
+  m_x[1] = cx;
+  m_y[1] = cy;
+  m_x[2] = x2;
+  m_y[2] = y2;
+}
+
+void MsdfEdge::expandBounds(double &x1, double &y1, double &x2, double &y2) const
+{
+  for(unsigned ii = 0; (ii < 3); ++ii)
+  {
+    x1 = std::min(x1, m_x[ii]);
+    y1 = std::min(y1, m_y[ii]);
+    x2 = std::max(x2, m_x[ii]);
+    y2 = std::max(y2, m_y[ii]);
+  }
+}
+
+void MsdfEdge::getDirection(double op, double &dx, double &dy) const
+{
+  if(m_quadratic)
+  {
+    dx = (1.0 - op) * (m_x[1] - m_x[0]) + op * (m_x[2] - m_x[1]);
+    dy = (1.0 - op) * (m_y[1] - m_y[0]) + op * (m_y[2] - m_y[1]);
+
+    // Control point coinciding with an end point.
+    if((0.0 != dx) || (0.0 != dy))
+    {
+      return;
+    }
+  }
+
+  dx = m_x[2] - m_x[0];
+  dy = m_y[2] - m_y[0];
+}
+
+double MsdfEdge::getSignedDistance(double px, double py, double &distance, double &dot) const
+{
+  if(!m_quadratic)
+  {
+    double aqx = px - m_x[0];
+    double aqy = py - m_y[0];
+    double abx = m_x[2] - m_x[0];
+    double aby = m_y[2] - m_y[0];
+    double ablen = sqrt(abx * abx + aby * aby);
+    double param = (aqx * abx + aqy * aby) / (ablen * ablen);
+    unsigned end = (0.5 < param) ? 2 : 0;
+    double eqx = m_x[end] - px;
+    double eqy = m_y[end] - py;
+    double end_distance = sqrt(eqx * eqx + eqy * eqy);
+
+    if((0.0 < param) && (1.0 > param))
+    {
+      double ortho_distance = (aby * aqx - abx * aqy) / ablen;
+
+      if(fabs(ortho_distance) < end_distance)
+      {
+        distance = ortho_distance;
+        dot = 0.0;
+        return param;
+      }
+    }
+
+    distance = nonzero_sign(aqx * aby - aqy * abx) * end_distance;
+    dot = (0.0 < end_distance) ? fabs((abx * eqx + aby * eqy) / (ablen * end_distance)) : 0.0;
+    return param;
+  }
+
+  double qax = m_x[0] - px;
+  double qay = m_y[0] - py;
+  double abx = m_x[1] - m_x[0];
+  double aby = m_y[1] - m_y[0];
+  double brx = m_x[2] - m_x[1] - abx;
+  double bry = m_y[2] - m_y[1] - aby;
+  double roots[3];
+  int root_count = solve_cubic(roots, brx * brx + bry * bry, 3.0 * (abx * brx + aby * bry),
+      2.0 * (abx * abx + aby * aby) + (qax * brx + qay * bry), qax * abx + qay * aby);
+  double dx, dy;
+
+  // Distances to end points.
+  this->getDirection(0.0, dx, dy);
+  double min_distance = nonzero_sign(dx * qay - dy * qax) * sqrt(qax * qax + qay * qay);
+  double param = -(qax * dx + qay * dy) / (dx * dx + dy * dy);
+  {
+    double qbx = m_x[2] - px;
+    double qby = m_y[2] - py;
+    double end_distance = sqrt(qbx * qbx + qby * qby);
+
+    if(end_distance < fabs(min_distance))
+    {
+      this->getDirection(1.0, dx, dy);
+      min_distance = nonzero_sign(dx * qby - dy * qbx) * end_distance;
+      param = ((px - m_x[1]) * dx + (py - m_y[1]) * dy) / (dx * dx + dy * dy);
+    }
+  }
+
+  // Distances to points on the curve where the direction is perpendicular to the point.
+  for(int ii = 0; (ii < root_count); ++ii)
+  {
+    double tt = roots[ii];
+
+    if((0.0 < tt) && (1.0 > tt))
+    {
+      double qex = qax + 2.0 * tt * abx + tt * tt * brx;
+      double qey = qay + 2.0 * tt * aby + tt * tt * bry;
+      double curve_distance = sqrt(qex * qex + qey * qey);
+
+      if(curve_distance <= fabs(min_distance))
+      {
+        double tx = abx + tt * brx;
+        double ty = aby + tt * bry;
+
+        min_distance = nonzero_sign(tx * qey - ty * qex) * curve_distance;
+        param = tt;
+      }
+    }
+  }
+
+  distance = min_distance;
+  if((0.0 <= param) && (1.0 >= param))
+  {
+    dot = 0.0;
+    return param;
+  }
+
+  unsigned end = (0.5 > param) ? 0 : 2;
+  double ex = m_x[end] - px;
+  double ey = m_y[end] - py;
+  double elen = sqrt(ex * ex + ey * ey);
+
+  this->getDirection((0 == end) ? 0.0 : 1.0, dx, dy);
+  double dlen = sqrt(dx * dx + dy * dy);
+  dot = ((0.0 < elen) && (0.0 < dlen)) ? fabs((dx * ex + dy * ey) / (dlen * elen)) : 0.0;
+  return param;
+}
+
+void MsdfEdge::toPseudoDistance(double px, double py, double param, double &distance) const
+{
+  double dx, dy;
+
+  if(0.0 > param)
+  {
+    this->getDirection(0.0, dx, dy);
+
+    double len = sqrt(dx * dx + dy * dy);
+    double aqx = px - m_x[0];
+    double aqy = py - m_y[0];
+
+    if(0.0 > (aqx * dx + aqy * dy))
+    {
+      double pseudo_distance = (aqx * dy - aqy * dx) / len;
+
+      if(fabs(pseudo_distance) <= fabs(distance))
+      {
+        distance = pseudo_distance;
+      }
+    }
+  }
+  else if(1.0 < param)
+  {
+    this->getDirection(1.0, dx, dy);
+
+    double len = sqrt(dx * dx + dy * dy);
+    double bqx = px - m_x[2];
+    double bqy = py - m_y[2];
+
+    if(0.0 < (bqx * dx + bqy * dy))
+    {
+      double pseudo_distance = (bqx * dy - bqy * dx) / len;
+
+      if(fabs(pseudo_distance) <= fabs(distance))
+      {
+        distance = pseudo_distance;
+      }
+    }
+  }
+}
+
+void MsdfEdge::splitInThirds(std::vector<MsdfEdge> &dst) const
+{
+  for(unsigned ii = 0; (ii < 3); ++ii)
+  {
+    double t1 = static_cast<double>(ii) / 3.0;
+    double t2 = static_cast<double>(ii + 1) / 3.0;
+    double xx[2];
+    double yy[2];
+
+    for(unsigned jj = 0; (jj < 2); ++jj)
+    {
+      double tt = (0 == jj) ? t1 : t2;
+      double it = 1.0 - tt;
+
+      xx[jj] = it * it * m_x[0] + 2.0 * it * tt * m_x[1] + tt * tt * m_x[2];
+      yy[jj] = it * it * m_y[0] + 2.0 * it * tt * m_y[1] + tt * tt * m_y[2];
+    }
+
+    if(m_quadratic)
+    {
+      // Control point of the piece is on the tangent lines at both of its ends.
+      double cx = (1.0 - t1) * ((1.0 - t2) * m_x[0] + t2 * m_x[1]) + t1 * ((1.0 - t2) * m_x[1] + t2 * m_x[2]);
+      double cy = (1.0 - t1) * ((1.0 - t2) * m_y[0] + t2 * m_y[1]) + t1 * ((1.0 - t2) * m_y[1] + t2 * m_y[2]);
+
+      dst.push_back(MsdfEdge(xx[0], yy[0], cx, cy, xx[1], yy[1]));
+    }
+    else
+    {
+      dst.push_back(MsdfEdge(xx[0], yy[0], xx[1], yy[1]));
+    }
+    dst.back().setColor(m_color);
+  }
+}
+
+MsdfShape::MsdfShape(unsigned pwidth, unsigned prows) :
+  m_width(pwidth),
+  m_rows(prows),
+  m_sign(1.0) { }
+
+void MsdfShape::addContour()
+{
+  // Empty contours are reused.
+  if(m_contours.empty() || (m_contours.back() < m_edges.size()))
+  {
+    m_contours.push_back(static_cast<unsigned>(m_edges.size()));
+  }
+}
+
+void MsdfShape::addEdge(const MsdfEdge &op)
+{
+  double x1 = DBL_MAX;
+  double y1 = DBL_MAX;
+  double x2 = -DBL_MAX;
+  double y2 = -DBL_MAX;
+
+  op.expandBounds(x1, y1, x2, y2);
+  if((x1 >= x2) && (y1 >= y2))
+  {
+    return;
+  }
+
+  if(m_contours.empty())
+  {
+    m_contours.push_back(0);
+  }
+  m_edges.push_back(op);
+}
+
+void MsdfShape::colorEdges()
+{
+  std::vector<MsdfEdge> edges;
+  std::vector<unsigned> contours;
+
+  for(unsigned ii = 0; (ii < m_contours.size()); ++ii)
+  {
+    unsigned first = m_contours[ii];
+    unsigned last = (ii + 1 < m_contours.size()) ? m_contours[ii + 1] : static_cast<unsigned>(m_edges.size());
+    unsigned count = last - first;
+    std::vector<unsigned> corners;
+
+    if(0 >= count)
+    {
+      continue;
+    }
+    contours.push_back(static_cast<unsigned>(edges.size()));
+
+    {
+      double px, py;
+
+      m_edges[last - 1].getDirection(1.0, px, py);
+      for(unsigned jj = 0; (jj < count); ++jj)
+      {
+        double dx, dy;
+
+        m_edges[first + jj].getDirection(0.0, dx, dy);
+        if(is_corner(px, py, dx, dy))
+        {
+          corners.push_back(jj);
+        }
+        m_edges[first + jj].getDirection(1.0, px, py);
+      }
+    }
+
+    // Smooth contour, every channel sees all of it.
+    if(corners.empty())
+    {
+      for(unsigned jj = first; (jj < last); ++jj)
+      {
+        m_edges[jj].setColor(MSDF_WHITE);
+        edges.push_back(m_edges[jj]);
+      }
+      continue;
+    }
+
+    // Teardrop, the single corner is made by splitting the contour in three colors.
+    if(1 == corners.size())
+    {
+      unsigned colors[3] = { MSDF_WHITE, MSDF_WHITE, MSDF_WHITE };
+      unsigned corner = corners[0];
+
+      switch_color(colors[0], MSDF_BLACK);
+      colors[2] = colors[0];
+      switch_color(colors[2], MSDF_BLACK);
+
+      if(3 <= count)
+      {
+        for(unsigned jj = 0; (jj < count); ++jj)
+        {
+          MsdfEdge edge = m_edges[first + (corner + jj) % count];
+          int idx = static_cast<int>(3.0 + 2.875 * static_cast<double>(jj) / static_cast<double>(count - 1) -
+              1.4375 + 0.5) - 3;
+
+          edge.setColor(colors[idx + 1]);
+          edges.push_back(edge);
+        }
+        continue;
+      }
+
+      // Too few edges for three colors, split them.
+      std::vector<MsdfEdge> parts;
+      for(unsigned jj = 0; (jj < count); ++jj)
+      {
+        m_edges[first + (corner + jj) % count].splitInThirds(parts);
+      }
+      for(unsigned jj = 0; (jj < parts.size()); ++jj)
+      {
+        parts[jj].setColor(colors[jj * 3 / parts.size()]);
+        edges.push_back(parts[jj]);
+      }
+      continue;
+    }
+
+    // Colors switch at every corner, the last one avoiding the color of the first.
+    {
+      unsigned corner_count = static_cast<unsigned>(corners.size());
+      unsigned spline = 0;
+      unsigned start = corners[0];
+      unsigned color = MSDF_WHITE;
+
+      switch_color(color, MSDF_BLACK);
+
+      unsigned initial_color = color;
+      for(unsigned jj = 0; (jj < count); ++jj)
+      {
+        unsigned idx = (start + jj) % count;
+        MsdfEdge edge = m_edges[first + idx];
+
+        if((spline + 1 < corner_count) && (corners[spline + 1] == idx))
+        {
+          ++spline;
+          switch_color(color, (spline == corner_count - 1) ? initial_color : static_cast<unsigned>(MSDF_BLACK));
+        }
+        edge.setColor(color);
+        edges.push_back(edge);
+      }
+    }
+  }
+
+  m_edges.swap(edges);
+  m_contours.swap(contours);
+}
+
+bool MsdfShape::decompose(FT_Outline *outline)
+{
+  FT_Outline_Funcs funcs;
+  MsdfDecomposer decomposer(this);
+
+  funcs.move_to = msdf_move_to;
+  funcs.line_to = msdf_line_to;
+  funcs.conic_to = msdf_conic_to;
+  funcs.cubic_to = msdf_cubic_to;
+  funcs.shift = 0;
+  funcs.delta = 0;
+
+  if(FT_Outline_Decompose(outline, &funcs, &decomposer))
+  {
+    return false;
+  }
+
+  this->colorEdges();
+
+  m_bounds.clear();
+  BOOST_FOREACH(const MsdfEdge &vv, m_edges)
+  {
+    double x1 = DBL_MAX;
+    double y1 = DBL_MAX;
+    double x2 = -DBL_MAX;
+    double y2 = -DBL_MAX;
+
+    vv.expandBounds(x1, y1, x2, y2);
+    m_bounds.push_back(x1);
+    m_bounds.push_back(y1);
+    m_bounds.push_back(x2);
+    m_bounds.push_back(y2);
+  }
+
+  // Outer contours of TrueType outlines wind clockwise, PostScript outlines counterclockwise. Flipping the Y axis
+  // reverses both.
+  m_sign = (FT_ORIENTATION_POSTSCRIPT == FT_Outline_Get_Orientation(outline)) ? 1.0 : -1.0;
+
+  return true;
+}
+
+bool MsdfShape::getBounds(int &x1, int &y1, int &x2, int &y2) const
+{
+  if(m_edges.empty())
+  {
+    return false;
+  }
+
+  double fx1 = DBL_MAX;
+  double fy1 = DBL_MAX;
+  double fx2 = -DBL_MAX;
+  double fy2 = -DBL_MAX;
+
+  BOOST_FOREACH(const MsdfEdge &vv, m_edges)
+  {
+    vv.expandBounds(fx1, fy1, fx2, fy2);
+  }
+
+  x1 = math::floor(fx1);
+  y1 = math::floor(fy1);
+  x2 = math::ceil(fx2) - 1;
+  y2 = math::ceil(fy2) - 1;
+  return true;
+}
+
+void MsdfShape::getDistance(float px, float py, float *dst) const
+{
+  double dpx = static_cast<double>(px);
+  double dpy = static_cast<double>(py);
+  double distance[CHANNELS];
+  double dot[CHANNELS];
+  double param[CHANNELS];
+  const MsdfEdge *nearest[CHANNELS];
+
+  for(unsigned ii = 0; (ii < CHANNELS); ++ii)
+  {
+    distance[ii] = -DBL_MAX;
+    dot[ii] = 1.0;
+    param[ii] = 0.0;
+    nearest[ii] = NULL;
+  }
+
+  for(unsigned ii = 0; (ii < m_edges.size()); ++ii)
+  {
+    const MsdfEdge &edge = m_edges[ii];
+    unsigned color = edge.getColor();
+    const double *bounds = &(m_bounds[ii * 4]);
+
+    // Edges farther than the closest edge on every channel they contribute to can be skipped.
+    {
+      double bx = std::max(std::max(bounds[0] - dpx, dpx - bounds[2]), 0.0);
+      double by = std::max(std::max(bounds[1] - dpy, dpy - bounds[3]), 0.0);
+      double bound = sqrt(bx * bx + by * by);
+      bool skip = true;
+
+      for(unsigned jj = 0; (jj < CHANNELS); ++jj)
+      {
+        if((color & (1u << jj)) && (bound <= fabs(distance[jj])))
+        {
+          skip = false;
+          break;
+        }
+      }
+      if(skip)
+      {
+        continue;
+      }
+    }
+
+    double edge_distance;
+    double edge_dot;
+    double edge_param = edge.getSignedDistance(dpx, dpy, edge_distance, edge_dot);
+
+    for(unsigned jj = 0; (jj < CHANNELS); ++jj)
+    {
+      if((color & (1u << jj)) && ((fabs(edge_distance) < fabs(distance[jj])) ||
+            ((fabs(edge_distance) == fabs(distance[jj])) && (edge_dot < dot[jj]))))
+      {
+        distance[jj] = edge_distance;
+        dot[jj] = edge_dot;
+        param[jj] = edge_param;
+        nearest[jj] = &edge;
+      }
+    }
+  }
+
+  for(unsigned ii = 0; (ii < CHANNELS); ++ii)
+  {
+    if(NULL != nearest[ii])
+    {
+      nearest[ii]->toPseudoDistance(dpx, dpy, param[ii], distance[ii]);
+    }
+    dst[ii] = static_cast<float>(m_sign * distance[ii]);
+  }
+}
+
+void msdf_correct_clashes(float *data, unsigned width, unsigned height, float threshold)
+{
+  std::vector<unsigned> clashes;
+
+  for(unsigned jj = 0; (jj < height); ++jj)
+  {
+    for(unsigned ii = 0; (ii < width); ++ii)
+    {
+      const float *sample = data + (jj * width + ii) * MsdfShape::CHANNELS;
+
+      if(((0 < ii) && detect_clash(sample, sample - MsdfShape::CHANNELS, threshold)) ||
+          ((width - 1 > ii) && detect_clash(sample, sample + MsdfShape::CHANNELS, threshold)) ||
+          ((0 < jj) && detect_clash(sample, sample - width * MsdfShape::CHANNELS, threshold)) ||
+          ((height - 1 > jj) && detect_clash(sample, sample + width * MsdfShape::CHANNELS, threshold)))
+      {
+        clashes.push_back(jj * width + ii);
+      }
+    }
+  }
+
+  BOOST_FOREACH(unsigned vv, clashes)
+  {
+    float *sample = data + vv * MsdfShape::CHANNELS;
+    float median = std::max(std::min(sample[0], sample[1]), std::min(std::max(sample[0], sample[1]), sample[2]));
+
+    sample[0] = sample[1] = sample[2] = median;
+  }
+}
@@ -0,0 +1,263 @@
+#ifndef MSDF_SHAPE_HPP
+#define MSDF_SHAPE_HPP
+
+#include "defaults.hpp"
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+
+#include <vector>
+
+/** \brief Edge colors, one bit per channel.
+ */
+enum MsdfColor
+{
+  /** No channels. */
+  MSDF_BLACK = 0,
+
+  /** Red channel. */
+  MSDF_RED = 1,
+
+  /** Green channel. */
+  MSDF_GREEN = 2,
+
+  /** Red and green channels. */
+  MSDF_YELLOW = 3,
+
+  /** Blue channel. */
+  MSDF_BLUE = 4,
+
+  /** Red and blue channels. */
+  MSDF_MAGENTA = 5,
+
+  /** Green and blue channels. */
+  MSDF_CYAN = 6,
+
+  /** All channels. */
+  MSDF_WHITE = 7
+};
+
+/** \brief One linear or quadratic edge segment of a glyph outline.
+ */
+class MsdfEdge
+{
+  private:
+    /** Control point X coordinates, middle one unused for linear edges. */
+    double m_x[3];
+
+    /** Control point Y coordinates, middle one unused for linear edges. */
+    double m_y[3];
+
+    /** Is this a quadratic edge? */
+    bool m_quadratic;
+
+    /** Channels this edge contributes to. */
+    unsigned m_color;
+
+  public:
+    /** \brief Linear edge constructor.
+     *
+     * \param x1 Start X coordinate.
+     * \param y1 Start Y coordinate.
+     * \param x2 End X coordinate.
+     * \param y2 End Y coordinate.
+     */
+    MsdfEdge(double x1, double y1, double x2, double y2);
+
+    /** \brief Quadratic edge constructor.
+     *
+     * \param x1 Start X coordinate.
+     * \param y1 Start Y coordinate.
+     * \param cx Control point X coordinate.
+     * \param cy Control point Y coordinate.
+     * \param x2 End X coordinate.
+     * \param y2 End Y coordinate.
+     */
+    MsdfEdge(double x1, double y1, double cx, double cy, double x2, double y2);
+
+  public:
+    /** \brief Get the bounding box of the control points.
+     *
+     * \param x1 Minimum X, only decreased.
+     * \param y1 Minimum Y, only decreased.
+     * \param x2 Maximum X, only increased.
+     * \param y2 Maximum Y, only increased.
+     */
+    void expandBounds(double &x1, double &y1, double &x2, double &y2) const;
+
+    /** \brief Get the direction of the edge.
+     *
+     * \param op Edge parameter [0, 1].
+     * \param dx Direction X component.
+     * \param dy Direction Y component.
+     */
+    void getDirection(double op, double &dx, double &dy) const;
+
+    /** \brief Get the signed distance from a point to this edge.
+     *
+     * \param px X coordinate.
+     * \param py Y coordinate.
+     * \param distance Signed distance.
+     * \param dot Orthogonality of the edge at the closest end point, 0 if the closest point is not an end point.
+     * \return Edge parameter of the closest point, outside [0, 1] beyond the ends.
+     */
+    double getSignedDistance(double px, double py, double &distance, double &dot) const;
+
+    /** \brief Convert a signed distance to a pseudo-distance.
+     *
+     * Beyond the ends of the edge, the distance is measured to the tangent line at the end instead.
+     *
+     * \param px X coordinate.
+     * \param py Y coordinate.
+     * \param param Edge parameter of the closest point.
+     * \param distance Signed distance, replaced with the pseudo-distance.
+     */
+    void toPseudoDistance(double px, double py, double param, double &distance) const;
+
+    /** \brief Split this edge in thirds.
+     *
+     * \param dst Vector to append the three parts to, in order.
+     */
+    void splitInThirds(std::vector<MsdfEdge> &dst) const;
+
+  public:
+    /** \brief Get channels this edge contributes to.
+     *
+     * \return Color.
+     */
+    inline unsigned getColor() const
+    {
+      return m_color;
+    }
+
+    /** \brief Set channels this edge contributes to.
+     *
+     * \param op Color.
+     */
+    inline void setColor(unsigned op)
+    {
+      m_color = op;
+    }
+};
+
+/** \brief Glyph outline as colored edges for multi-channel distance fields.
+ *
+ * Edges are colored so that both edges meeting at a corner share at most one channel. The median of the
+ * per-channel distances reconstructs the sharp corner.
+ */
+class MsdfShape : public boost::noncopyable
+{
+  public:
+    /** Number of channels. */
+    static const unsigned CHANNELS = 3;
+
+  private:
+    /** Width in pixels. */
+    unsigned m_width;
+
+    /** Height in pixels. */
+    unsigned m_rows;
+
+    /** Edges of all contours. */
+    std::vector<MsdfEdge> m_edges;
+
+    /** Index of the first edge of every contour and one past the last contour. */
+    std::vector<unsigned> m_contours;
+
+    /** Bounding box of every edge, four values per edge. */
+    std::vector<double> m_bounds;
+
+    /** Sign of distances inside the outline, depends on contour orientation. */
+    double m_sign;
+
+  public:
+    /** \brief Constructor.
+     *
+     * Nothing is set until an outline is decomposed.
+     *
+     * \param pwidth Width in pixels.
+     * \param prows Height in pixels.
+     */
+    MsdfShape(unsigned pwidth, unsigned prows);
+
+  private:
+    /** \brief Color the edges of all contours.
+     */
+    void colorEdges();
+
+  public:
+    /** \brief Add an edge to the current contour.
+     *
+     * Degenerate edges are skipped.
+     *
+     * \param op Edge.
+     */
+    void addEdge(const MsdfEdge &op);
+
+    /** \brief Start a new contour.
+     */
+    void addContour();
+
+    /** \brief Decompose an outline into colored edges.
+     *
+     * Coordinates are flipped to bitmap row order, lower left corner of the size at origin.
+     *
+     * \param outline Outline to decompose.
+     * \return True on success, false on error.
+     */
+    bool decompose(FT_Outline *outline);
+
+    /** \brief Find the bounds of the outline in pixels.
+     *
+     * \param x1 Leftmost column.
+     * \param y1 Topmost row.
+     * \param x2 Rightmost column.
+     * \param y2 Bottommost row.
+     * \return True if there were any edges, false otherwise.
+     */
+    bool getBounds(int &x1, int &y1, int &x2, int &y2) const;
+
+    /** \brief Get the distance from a point to the outline on every channel.
+     *
+     * \param px X coordinate, pixel edges are at integer coordinates.
+     * \param py Y coordinate, pixel edges are at integer coordinates.
+     * \param dst Distance output for every channel, positive inside.
+     */
+    void getDistance(float px, float py, float *dst) const;
+
+  public:
+    /** \brief Get height.
+     *
+     * \return Height in pixels.
+     */
+    inline unsigned getRows() const
+    {
+      return m_rows;
+    }
+
+    /** \brief Get width.
+     *
+     * \return Width in pixels.
+     */
+    inline unsigned getWidth() const
+    {
+      return m_width;
+    }
+};
+
+/** Convenience typedef. */
+typedef boost::shared_ptr<MsdfShape> MsdfShapeSptr;
+
+/** \brief Replace distances clashing with their neighbors with their median.
+ *
+ * Samples between edges of different colors may interpolate into a false edge. Those are found as neighbors
+ * differing on two channels more than distances may change from sample to sample.
+ *
+ * \param data Distances, MsdfShape::CHANNELS per sample.
+ * \param width Number of columns.
+ * \param height Number of rows.
+ * \param threshold Largest change of distance between neighboring samples.
+ */
+void msdf_correct_clashes(float *data, unsigned width, unsigned height, float threshold);
+
+#endif
@@ -0,0 +1,518 @@
+#include "prog/progress.hpp"
+
+#include "data/ring_buffer.hpp"
+#include "thr/generic.hpp"
+
+#include <boost/scoped_ptr.hpp>
+
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+using namespace prog;
+
+/** \brief Event type.
+ */
+enum EventType
+{
+  /** No event. */
+  EVENT_NONE,
+
+  /** Item completed. */
+  EVENT_ITEM_DONE,
+
+  /** Item failed. */
+  EVENT_ITEM_FAILED,
+
+  /** Item skipped. */
+  EVENT_ITEM_SKIPPED,
+
+  /** Free-form message. */
+  EVENT_MESSAGE,
+
+  /** Phase change. */
+  EVENT_PHASE,
+
+  /** Status text change. */
+  EVENT_STATUS,
+
+  /** Work expected in current phase. */
+  EVENT_WORK_EXPECTED,
+
+  /** Work completed. */
+  EVENT_WORK_DONE
+};
+
+/** \brief Event passed from reporting threads to the printer thread.
+ */
+class Event
+{
+  private:
+    /** Event type. */
+    EventType m_type;
+
+    /** Numeric payload. */
+    uint64_t m_value;
+
+    /** Textual payload. */
+    std::string m_text;
+
+    /** Secondary textual payload. */
+    std::string m_unit;
+
+    /** Timestamp of the event, if relevant. */
+    uint64_t m_timestamp;
+
+  public:
+    /** \brief Empty constructor.
+     */
+    Event() :
+      m_type(EVENT_NONE),
+      m_value(0),
+      m_timestamp(0) { }
+
+    /** \brief Constructor.
+     *
+     * \param ptype Event type.
+     * \param pvalue Numeric payload.
+     * \param ptext Textual payload.
+     * \param punit Secondary textual payload.
+     * \param ptimestamp Timestamp.
+     */
+    Event(EventType ptype, uint64_t pvalue = 0, const std::string &ptext = std::string(),
+        const std::string &punit = std::string(), uint64_t ptimestamp = 0) :
+      m_type(ptype),
+      m_value(pvalue),
+      m_text(ptext),
+      m_unit(punit),
+      m_timestamp(ptimestamp) { }
+
+  public:
+    /** \brief Get event type.
+     *
+     * \return Event type.
+     */
+    EventType getType() const
+    {
+      return m_type;
+    }
+
+    /** \brief Get numeric payload.
+     *
+     * \return Numeric payload.
+     */
+    uint64_t getValue() const
+    {
+      return m_value;
+    }
+
+    /** \brief Get textual payload.
+     *
+     * \return Textual payload.
+     */
+    const std::string& getText() const
+    {
+      return m_text;
+    }
+
+    /** \brief Get timestamp.
+     *
+     * \return Timestamp in nanoseconds.
+     */
+    uint64_t getTimestamp() const
+    {
+      return m_timestamp;
+    }
+
+    /** \brief Get secondary textual payload.
+     *
+     * \return Unit name.
+     */
+    const std::string& getUnit() const
+    {
+      return m_unit;
+    }
+};
+
+/** Capacity of the event queue. */
+static const unsigned QUEUE_SIZE = 4096;
+
+/** Interval at which the printer thread polls for events (nanoseconds). */
+static const uint64_t POLL_INTERVAL = 10000000;
+
+/** Minimum interval between progress line refreshes (nanoseconds). */
+static const uint64_t REFRESH_INTERVAL = 200000000;
+
+/** Event queue. */
+static data::RingBuffer<Event> events(QUEUE_SIZE);
+
+/** Printer thread. */
+static boost::scoped_ptr<boost::thread> printer_thread;
+
+/** True if reporting is enabled. */
+static boost::atomic<bool> enabled(false);
+
+/** True if quitting the printer thread. */
+static boost::atomic<bool> quitting(false);
+
+/** True if per-item dumps are printed. */
+static bool dump_items = false;
+
+/** Current phase name (printer thread only). */
+static std::string phase_name;
+
+/** Current phase status (printer thread only). */
+static std::string phase_status;
+
+/** Unit of items in current phase (printer thread only). */
+static std::string phase_unit;
+
+/** Failures not yet printed (printer thread only). */
+static std::vector<unsigned> failures_pending;
+
+/** Items expected in current phase (printer thread only). */
+static unsigned phase_total = 0;
+
+/** Items processed in current phase (printer thread only). */
+static unsigned phase_done = 0;
+
+/** Work expected in current phase, 0 if items are the only measure (printer thread only). */
+static uint64_t phase_work_total = 0;
+
+/** Work completed in current phase (printer thread only). */
+static uint64_t phase_work_done = 0;
+
+/** Start timestamp of current phase (printer thread only). */
+static uint64_t phase_start = 0;
+
+/** Timestamp of last refresh (printer thread only). */
+static uint64_t last_refresh = 0;
+
+/** Width of the progress line currently on screen (printer thread only). */
+static unsigned last_line_width = 0;
+
+/** \brief Post an event.
+ *
+ * Never blocks on a lock, but will yield until there is room in the queue. Events posted after shutdown has
+ * been flagged are dropped, the printer thread will not drain the queue anymore.
+ *
+ * \param op Event to post.
+ */
+static void post(const Event &op)
+{
+  if(!enabled.load(boost::memory_order_acquire) || quitting.load(boost::memory_order_acquire))
+  {
+    return;
+  }
+
+  while(!events.put(op))
+  {
+    if(quitting.load(boost::memory_order_acquire))
+    {
+      return;
+    }
+    boost::this_thread::yield();
+  }
+}
+
+/** \brief Format a duration.
+ *
+ * \param op Duration in seconds.
+ * \return Duration as h:mm:ss or m:ss.
+ */
+static std::string format_duration(unsigned op)
+{
+  std::ostringstream sstr;
+  unsigned hours = op / 3600,
+           minutes = (op / 60) % 60,
+           seconds = op % 60;
+
+  if(0 < hours)
+  {
+    sstr << hours << ':' << std::setw(2) << std::setfill('0') << minutes;
+  }
+  else
+  {
+    sstr << minutes;
+  }
+  sstr << ':' << std::setw(2) << std::setfill('0') << seconds;
+
+  return sstr.str();
+}
+
+/** \brief Clear the progress line, if any.
+ */
+static void clear_line()
+{
+  if(0 < last_line_width)
+  {
+    std::cout << '\r' << std::string(last_line_width, ' ') << '\r';
+    last_line_width = 0;
+  }
+}
+
+/** \brief Print all pending failures.
+ */
+static void flush_failures()
+{
+  if(failures_pending.empty())
+  {
+    return;
+  }
+
+  clear_line();
+  std::cout.flush();
+
+  std::cerr << "Failed:";
+  BOOST_FOREACH(unsigned vv, failures_pending)
+  {
+    std::cerr << ' ' << vv;
+  }
+  std::cerr << std::endl;
+
+  failures_pending.clear();
+}
+
+/** \brief Print the progress line.
+ *
+ * \param now Current timestamp.
+ */
+static void refresh(uint64_t now)
+{
+  last_refresh = now;
+
+  flush_failures();
+
+  if(phase_name.empty())
+  {
+    return;
+  }
+
+  std::ostringstream sstr;
+  double elapsed = static_cast<double>(now - phase_start) / 1000000000.0;
+  double rate = (0.0 < elapsed) ? (static_cast<double>(phase_done) / elapsed) : 0.0;
+
+  sstr << phase_name << ": " << phase_done;
+  if(0 < phase_total)
+  {
+    sstr << " / " << phase_total << " (" << (phase_done * 100 / phase_total) << "%)";
+  }
+  sstr << ", " << std::fixed << std::setprecision(1) << rate << ' ' << phase_unit << "/s";
+  if((0 < phase_work_total) && (0 < phase_work_done) && (phase_work_done < phase_work_total))
+  {
+    // Items of different size take different time, estimate from the work instead.
+    double remaining = static_cast<double>(phase_work_total - phase_work_done) / static_cast<double>(phase_work_done);
+    sstr << ", ETA " << format_duration(static_cast<unsigned>(elapsed * remaining));
+  }
+  else if((0 < phase_total) && (phase_done < phase_total) && (0.0 < rate))
+  {
+    sstr << ", ETA " << format_duration(static_cast<unsigned>(static_cast<double>(phase_total - phase_done) / rate));
+  }
+  else
+  {
+    sstr << ", " << format_duration(static_cast<unsigned>(elapsed));
+  }
+  if(!phase_status.empty())
+  {
+    sstr << " | " << phase_status;
+  }
+
+  std::string line = sstr.str();
+  unsigned width = static_cast<unsigned>(line.length());
+
+  std::cout << '\r' << line;
+  for(unsigned ii = width; (ii < last_line_width); ++ii)
+  {
+    std::cout << ' ';
+  }
+  std::cout.flush();
+
+  last_line_width = width;
+}
+
+/** \brief End the current phase, leaving its final progress line on screen.
+ */
+static void finish_phase()
+{
+  refresh(thr::nsec_get_timestamp());
+
+  if(0 < last_line_width)
+  {
+    std::cout << std::endl;
+    last_line_width = 0;
+  }
+  phase_name.clear();
+}
+
+/** \brief Process one event.
+ *
+ * \param op Event.
+ */
+static void process(const Event &op)
+{
+  switch(op.getType())
+  {
+    case EVENT_ITEM_DONE:
+      ++phase_done;
+      if(!op.getText().empty())
+      {
+        clear_line();
+        std::cout << op.getText();
+      }
+      break;
+
+    case EVENT_ITEM_FAILED:
+      ++phase_done;
+      failures_pending.push_back(static_cast<unsigned>(op.getValue()));
+      break;
+
+    case EVENT_ITEM_SKIPPED:
+      ++phase_done;
+      break;
+
+    case EVENT_MESSAGE:
+      flush_failures();
+      clear_line();
+      std::cout << op.getText() << std::endl;
+      break;
+
+    case EVENT_PHASE:
+      finish_phase();
+      phase_name = op.getText();
+      phase_unit = op.getUnit();
+      phase_status.clear();
+      phase_total = static_cast<unsigned>(op.getValue());
+      phase_done = 0;
+      phase_work_total = 0;
+      phase_work_done = 0;
+      phase_start = op.getTimestamp();
+      break;
+
+    case EVENT_STATUS:
+      phase_status = op.getText();
+      break;
+
+    case EVENT_WORK_EXPECTED:
+      phase_work_total += op.getValue();
+      break;
+
+    case EVENT_WORK_DONE:
+      phase_work_done += op.getValue();
+      break;
+
+    case EVENT_NONE:
+    default:
+      break;
+  }
+}
+
+/** \brief Printer thread function.
+ */
+static void run_printer()
+{
+  Event ev;
+
+  for(;;)
+  {
+    bool quit = quitting.load(boost::memory_order_acquire);
+
+    while(events.get(ev))
+    {
+      process(ev);
+    }
+
+    if(quit)
+    {
+      break;
+    }
+
+    uint64_t now = thr::nsec_get_timestamp();
+    if(now - last_refresh >= REFRESH_INTERVAL)
+    {
+      refresh(now);
+    }
+
+    thr::nsec_sleep(POLL_INTERVAL);
+  }
+
+  finish_phase();
+  std::cout.flush();
+}
+
+void prog::prog_init(bool pdump_items)
+{
+  if(enabled.load())
+  {
+    std::ostringstream sstr;
+    sstr << "progress reporting already initialized";
+    BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+  }
+
+  dump_items = pdump_items;
+  quitting.store(false);
+  enabled.store(true, boost::memory_order_release);
+  printer_thread.reset(new boost::thread(run_printer));
+}
+
+void prog::prog_quit()
+{
+  if(!printer_thread)
+  {
+    return;
+  }
+
+  quitting.store(true, boost::memory_order_release);
+  printer_thread->join();
+  printer_thread.reset();
+  enabled.store(false);
+}
+
+bool prog::is_enabled()
+{
+  return enabled.load(boost::memory_order_relaxed);
+}
+
+bool prog::is_dumping_items()
+{
+  return dump_items && enabled.load(boost::memory_order_relaxed);
+}
+
+void prog::item_done(const std::string &op)
+{
+  post(Event(EVENT_ITEM_DONE, 0, dump_items ? op : std::string()));
+}
+
+void prog::item_failed(unsigned op)
+{
+  post(Event(EVENT_ITEM_FAILED, op));
+}
+
+void prog::item_skipped()
+{
+  post(Event(EVENT_ITEM_SKIPPED));
+}
+
+void prog::message(const std::string &op)
+{
+  post(Event(EVENT_MESSAGE, 0, op));
+}
+
+void prog::phase(const std::string &name, unsigned total, const std::string &unit)
+{
+  post(Event(EVENT_PHASE, total, name, unit, thr::nsec_get_timestamp()));
+}
+
+void prog::status(const std::string &op)
+{
+  post(Event(EVENT_STATUS, 0, op));
+}
+
+void prog::work_expected(uint64_t op)
+{
+  post(Event(EVENT_WORK_EXPECTED, op));
+}
+
+void prog::work_done(uint64_t op)
+{
+  post(Event(EVENT_WORK_DONE, op));
+}
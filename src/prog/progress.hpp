@@ -0,0 +1,99 @@
+#ifndef PROG_PROGRESS_HPP
+#define PROG_PROGRESS_HPP
+
+#include "defaults.hpp"
+
+#include <string>
+
+namespace prog
+{
+  /** \brief Initialize progress reporting.
+   *
+   * Starts the background thread that prints all reported events. Until this is called, all reporting calls
+   * are no-ops.
+   *
+   * \param dump_items Print per-item dumps passed to item_done().
+   */
+  extern void prog_init(bool dump_items = false);
+
+  /** \brief Stop progress reporting.
+   *
+   * Prints all outstanding events, then joins the background thread.
+   */
+  extern void prog_quit();
+
+  /** \brief Tell if progress reporting is enabled.
+   *
+   * \return True if yes, false if no.
+   */
+  extern bool is_enabled();
+
+  /** \brief Tell if per-item dumps are wanted.
+   *
+   * Callers should only build dumps if this returns true.
+   *
+   * \return True if yes, false if no.
+   */
+  extern bool is_dumping_items();
+
+  /** \brief Report an item has been completed.
+   *
+   * \param op Dump of the item, printed only if dumping is enabled. May be empty.
+   */
+  extern void item_done(const std::string &op = std::string());
+
+  /** \brief Report an item failed.
+   *
+   * Failures are collected and printed together.
+   *
+   * \param op Identifier of the failed item.
+   */
+  extern void item_failed(unsigned op);
+
+  /** \brief Report an item was skipped.
+   *
+   * Skipped items count towards progress, but are not reported otherwise.
+   */
+  extern void item_skipped();
+
+  /** \brief Print a message.
+   *
+   * \param op Message.
+   */
+  extern void message(const std::string &op);
+
+  /** \brief Start a new phase.
+   *
+   * Resets progress counters. The final progress line of the previous phase is left on screen.
+   *
+   * \param name Phase name.
+   * \param total Number of items expected in this phase, 0 if not known.
+   * \param unit Name of the items, used when displaying rate.
+   */
+  extern void phase(const std::string &name, unsigned total = 0, const std::string &unit = std::string("items"));
+
+  /** \brief Set the status text of the current phase.
+   *
+   * Status is displayed as a part of the progress line. Only the latest status is ever printed.
+   *
+   * \param op Status text.
+   */
+  extern void status(const std::string &op);
+
+  /** \brief Add to the work expected in the current phase.
+   *
+   * Once any work is expected, remaining time is estimated from the work done instead of the items done. Work
+   * is in whatever unit the phase chooses.
+   *
+   * \param op Amount of work.
+   */
+  extern void work_expected(uint64_t op);
+
+  /** \brief Report work has been completed.
+   *
+   * \param op Amount of work.
+   */
+  extern void work_done(uint64_t op);
+}
+
+#endif
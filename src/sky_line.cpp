@@ -3,10 +3,11 @@
 #include "gfx/image_png.hpp"
 #include "glyph_storage.hpp"
 
-#include "math/generic.hpp"
+#include "math/scan.hpp"
 
 SkyLine::SkyLine(unsigned pw, unsigned pmaxh) :
   m_bitmap(NULL),
+  m_channels(1),
   m_width(pw),
   m_max_height(pmaxh),
   m_wasted(0)
@@ -46,17 +47,10 @@ SkyLineLocation SkyLine::fit(const FtGlyph &op)
     return SkyLineLocation(0, 0, 0, 0);
   }
 
-  unsigned minh = UINT_MAX,
-           maxh = 0;
+  unsigned minh, maxh;
 
   // Find out minimum and maximum heights.
-  for(unsigned ii = 0; (ii < m_width); ++ii)
-  {
-    unsigned current_height = m_line[ii];
-
-    minh = std::min(minh, current_height);
-    maxh = std::max(maxh, current_height);
-  }
+  math::find_min_max(m_line, m_width, minh, maxh);
 
   // No need to try to insert beyond limits.
   maxh = std::min(maxh, m_max_height - bitmap_h);
@@ -66,36 +60,34 @@ SkyLineLocation SkyLine::fit(const FtGlyph &op)
   {
     for(unsigned jj = 0; (jj < m_width); ++jj)
     {
-      unsigned current_height = m_line[jj];
-
-      if(current_height == ii)
+      jj += math::find_equal(m_line + jj, m_width - jj, ii);
+      if(jj >= m_width)
       {
-        int width_i = static_cast<int>(bitmap_w);
-        int iter_i = static_cast<int>(jj);
-        int kk = std::max(iter_i - width_i + 1, 0);
-        int ee = std::min(iter_i, static_cast<int>(m_width) - width_i);
-
-        while(kk <= ee)
-        {
-          unsigned fitting_pixels = 0;
+        break;
+      }
 
-          while(m_line[kk + static_cast<int>(fitting_pixels)] <= current_height)
-          {
-            ++fitting_pixels;
+      unsigned current_height = ii;
+      int width_i = static_cast<int>(bitmap_w);
+      int iter_i = static_cast<int>(jj);
+      int kk = std::max(iter_i - width_i + 1, 0);
+      int ee = std::min(iter_i, static_cast<int>(m_width) - width_i);
 
-            // location found
-            if(fitting_pixels >= bitmap_w)
-            {
-              SkyLineLocation ret(static_cast<unsigned>(kk), current_height, bitmap_w, bitmap_h);
+      while(kk <= ee)
+      {
+        unsigned fitting_pixels = math::find_greater(m_line + kk, bitmap_w, current_height);
 
-              ret.setWasted(this->getWastedSpace(ret));
+        // location found
+        if(fitting_pixels >= bitmap_w)
+        {
+          SkyLineLocation ret(static_cast<unsigned>(kk), current_height, bitmap_w, bitmap_h);
 
-              return ret;
-            }
-          }
+          ret.setWasted(this->getWastedSpace(ret));
 
-          ++kk;
+          return ret;
         }
+
+        // Every location up to the blocking column would overlap it.
+        kk += static_cast<int>(fitting_pixels) + 1;
       }
     }
   }
@@ -125,7 +117,7 @@ unsigned SkyLine::fitAll(GlyphStorage &glyphs, FILE *xmlfile, unsigned pidx, boo
       this->insert(loc, *gly);
 
       gly->setPage(pidx);
-      gly->write(xmlfile, glst);
+      glyphs.write(*gly, xmlfile, glst);
 
       *ii = FtGlyphSptr();
     }
@@ -136,6 +128,27 @@ unsigned SkyLine::fitAll(GlyphStorage &glyphs, FILE *xmlfile, unsigned pidx, boo
   return ret;
 }
 
+unsigned SkyLine::reserveAll(GlyphStorage &glyphs, std::vector<SkyLineLocation> &locations)
+{
+  unsigned ret = 0;
+
+  BOOST_FOREACH(const FtGlyphSptr &vv, glyphs)
+  {
+    SkyLineLocation loc = this->fit(*vv);
+
+    if(!loc.isValid())
+    {
+      break;
+    }
+
+    this->allocate(loc);
+    locations.push_back(loc);
+    ++ret;
+  }
+
+  return ret;
+}
+
 float SkyLine::getUsage() const
 {
   unsigned used_height = this->getUsedHeight();
@@ -156,12 +169,9 @@ float SkyLine::getUsage() const
 
 unsigned SkyLine::getUsedHeight() const
 {
-  unsigned ret = 0;
+  unsigned minh, ret;
 
-  for(unsigned ii = 0; (ii < m_width); ++ii)
-  {
-    ret = math::max(m_line[ii], ret);
-  }
+  math::find_min_max(m_line, m_width, minh, ret);
 
   unsigned remainder = ret % SIZE_STEP;
 
@@ -196,7 +206,9 @@ void SkyLine::insert(const SkyLineLocation &loc, FtGlyph &op)
 
   if(NULL == m_bitmap)
   {
-    unsigned bitmap_size = m_width * m_max_height;
+    m_channels = op.getChannels();
+
+    unsigned bitmap_size = m_width * m_max_height * m_channels;
 
     m_bitmap = new uint8_t[bitmap_size];
 
@@ -205,18 +217,19 @@ void SkyLine::insert(const SkyLineLocation &loc, FtGlyph &op)
 
   // The final image is arranged scanlines from bottom to top, since it written to disk. On the other hand,
   // crunched images are arranged like their FreeType -rendered counterparts, from top to bottom.
-  unsigned scanline_width = loc.getWidth();
-  uint8_t *dst = m_bitmap + (loc.getY() * m_width) + loc.getX();
+  unsigned scanline_width = loc.getWidth() * m_channels;
+  uint8_t *dst = m_bitmap + ((loc.getY() * m_width) + loc.getX()) * m_channels;
   uint8_t *src = op.getCrunched() + ((loc.getHeight() - 1) * scanline_width);
 
-  BOOST_ASSERT((op.getCrunchedWidth() == scanline_width) &&
-      (op.getCrunchedHeight() == loc.getHeight()));
+  BOOST_ASSERT((op.getCrunchedWidth() == loc.getWidth()) &&
+      (op.getCrunchedHeight() == loc.getHeight()) &&
+      (op.getChannels() == m_channels));
 
   for(unsigned ii = 0; (ii < loc.getHeight()); ++ii)
   {
     memcpy(dst, src, scanline_width);
 
-    dst += m_width;
+    dst += m_width * m_channels;
     src -= scanline_width;
   }
 
@@ -230,8 +243,36 @@ void SkyLine::insert(const SkyLineLocation &loc, FtGlyph &op)
   op.setST(s1, t1, s2, t2);
 }
 
+void SkyLine::erase(const SkyLineLocation &loc)
+{
+  if((NULL == m_bitmap) || (0 == loc.getWidth()) || (0 == loc.getHeight()))
+  {
+    return;
+  }
+
+  unsigned scanline_width = loc.getWidth() * m_channels;
+  uint8_t *dst = m_bitmap + ((loc.getY() * m_width) + loc.getX()) * m_channels;
+
+  for(unsigned ii = 0; (ii < loc.getHeight()); ++ii)
+  {
+    memset(dst, 0, scanline_width);
+
+    dst += m_width * m_channels;
+  }
+}
+
 void SkyLine::save(const boost::filesystem::path &op)
 {
-  gfx::image_png_save(op.generic_string(), m_width, m_max_height, 8, m_bitmap);
+  // Pages nothing was inserted into are saved blank.
+  if(NULL == m_bitmap)
+  {
+    unsigned bitmap_size = m_width * m_max_height * m_channels;
+
+    m_bitmap = new uint8_t[bitmap_size];
+
+    memset(m_bitmap, 0, bitmap_size);
+  }
+
+  gfx::image_png_save(op.generic_string(), m_width, m_max_height, 8 * m_channels, m_bitmap);
 }
 
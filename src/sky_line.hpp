@@ -24,6 +24,9 @@ class SkyLine
     /** Skyline data. */
     unsigned *m_line;
 
+    /** Channels per pixel, taken from the first glyph inserted. */
+    unsigned m_channels;
+
     /** Width. */
     unsigned m_width;
 
@@ -76,6 +79,16 @@ class SkyLine
      */
     unsigned fitAll(GlyphStorage &glyph, FILE *xmlfile = NULL, unsigned pidx = 0, bool glst = true);
 
+    /** \brief Reserve locations for all glyphs in a storage.
+     *
+     * Glyphs are fitted like fitAll() would fit them, but nothing is inserted.
+     *
+     * \param glyphs Glyph storage to use.
+     * \param locations Locations of glyphs fit are appended here, in storage order.
+     * \return Glyphs fit.
+     */
+    unsigned reserveAll(GlyphStorage &glyphs, std::vector<SkyLineLocation> &locations);
+
     /** \brief Report largest used height.
      *
      * \return Used height.
@@ -98,12 +111,42 @@ class SkyLine
      */
     void insert(const SkyLineLocation &loc, FtGlyph &gly);
 
+    /** \brief Clear a location a glyph was inserted into.
+     *
+     * Location stays allocated, only the bitmap data is cleared.
+     *
+     * \param loc Location.
+     */
+    void erase(const SkyLineLocation &loc);
+
     /** \brief Write a generated bitmap into a file.
      *
      * \param op Filename to write to.
      */
     void save(const boost::filesystem::path &op);
+
+  public:
+    /** \brief Get maximum height.
+     *
+     * \return Maximum height.
+     */
+    inline unsigned getMaxHeight() const
+    {
+      return m_max_height;
+    }
+
+    /** \brief Get width.
+     *
+     * \return Width.
+     */
+    inline unsigned getWidth() const
+    {
+      return m_width;
+    }
 };
 
+/** Convenience typedef. */
+typedef boost::shared_ptr<SkyLine> SkyLineSptr;
+
 #endif
 
@@ -3,26 +3,58 @@
 #include "glyph_storage.hpp"
 #include "sky_line.hpp"
 
+#include "prog/progress.hpp"
 #include "thr/dispatch.hpp"
 
-extern bool g_verbose;
+/** \brief Round up to skyline size step.
+ *
+ * \param op Size.
+ * \return Size rounded up, at least one step.
+ */
+static unsigned round_up_size(unsigned op)
+{
+  if(SkyLine::SIZE_STEP >= op)
+  {
+    return SkyLine::SIZE_STEP;
+  }
+  unsigned remainder = op % SkyLine::SIZE_STEP;
+
+  return (0 < remainder) ? (op - remainder + SkyLine::SIZE_STEP) : op;
+}
 
 SkyLineFitter::SkyLineFitter(unsigned pmax) :
-  m_max_size(pmax),
+  m_max_size(pmax - pmax % SkyLine::SIZE_STEP),
+  m_min_width(SkyLine::SIZE_STEP),
+  m_max_width(m_max_size),
+  m_width_step(SkyLine::SIZE_STEP),
+  m_best_count(0),
+  m_best_usage(0.0f),
+  m_best_width(0),
+  m_best_height(0) { }
+
+SkyLineFitter::SkyLineFitter(unsigned pmax, unsigned pwmin, unsigned pwmax, unsigned pstep) :
+  m_max_size(pmax - pmax % SkyLine::SIZE_STEP),
+  m_min_width(round_up_size(pwmin)),
+  m_max_width((pwmax < m_max_size) ? (pwmax - pwmax % SkyLine::SIZE_STEP) : m_max_size),
+  m_width_step(round_up_size(pstep)),
   m_best_count(0),
   m_best_usage(0.0f),
   m_best_width(0),
-  m_best_height(0),
-  m_last_print_width(0) { }
+  m_best_height(0) { }
+
+unsigned SkyLineFitter::getAttemptCount() const
+{
+  return (m_max_width >= m_min_width) ? ((m_max_width - m_min_width) / m_width_step + 1) : 0;
+}
 
 void SkyLineFitter::queue(GlyphStorage &glyphs)
 {
-  // round down to the next step
-  m_max_size -= m_max_size % SkyLine::SIZE_STEP;
+  unsigned count = this->getAttemptCount();
 
-  for(unsigned ii = m_max_size; (0 < ii); ii -= SkyLine::SIZE_STEP)
+  for(unsigned ii = 0; (ii < count); ++ii)
   {
-    thr::dispatch(attempt_thread, boost::ref(*this), boost::ref(glyphs), ii, m_max_size);
+    thr::dispatch(attempt_thread, boost::ref(*this), boost::ref(glyphs), m_max_width - ii * m_width_step,
+        m_max_size);
   }
 }
 
@@ -30,27 +62,28 @@ void SkyLineFitter::storeAttempt(unsigned pcount, float pusage, unsigned pw, uns
 {
   boost::mutex::scoped_lock scope(m_mutex);
 
-  if((pcount >= m_best_count) && (pusage > m_best_usage))
+  // Attempts finish in any order, the best one must not depend on which finished first. More glyphs fitted wins,
+  // then better usage, then the wider attempt.
+  bool better = (pcount != m_best_count) ? (pcount > m_best_count) :
+    (pusage != m_best_usage) ? (pusage > m_best_usage) : (pw > m_best_width);
+
+  if(better)
   {
     m_best_count = pcount;
     m_best_usage = pusage;
     m_best_width = pw;
     m_best_height = ph;
 
-    if(g_verbose)
+    if(prog::is_enabled())
     {
       std::ostringstream sstr;
-      sstr << "\rBest: " << m_best_count << " / " << m_best_usage << " (" <<
-        m_best_width << 'x' << m_best_height << ')';
-      unsigned current_width = static_cast<unsigned>(sstr.str().length());
-      for(unsigned ii = current_width; (ii < m_last_print_width); ++ii)
-      {
-        sstr << ' ';
-      }
-      m_last_print_width = current_width;
-      std::cout << sstr.str() << std::flush;
+      sstr << "best: " << m_best_count << " / " << m_best_usage << " (" << m_best_width << 'x' <<
+        m_best_height << ')';
+      prog::status(sstr.str());
     }
   }
+
+  prog::item_done();
 }
 
 void SkyLineFitter::attempt_thread(SkyLineFitter &slf, GlyphStorage &glyphs, unsigned pw, unsigned pmaxh)
@@ -14,6 +14,15 @@ class SkyLineFitter
     /** Maximum size to fit. */
     unsigned m_max_size;
 
+    /** Narrowest width attempted. */
+    unsigned m_min_width;
+
+    /** Widest width attempted. */
+    unsigned m_max_width;
+
+    /** Step between widths attempted. */
+    unsigned m_width_step;
+
     /** Best fit count. */
     unsigned m_best_count;
 
@@ -26,17 +35,27 @@ class SkyLineFitter
     /** Best height (for given best fit and usage). */
     unsigned m_best_height;
 
-    /** Width of last line output. */
-    unsigned m_last_print_width;
-
     /** Concurrency guard. */
     boost::mutex m_mutex;
 
   public:
     /** \brief Constructor.
+     *
+     * \param pmax Maximum size to fit, rounded down to size step.
      */
     SkyLineFitter(unsigned pmax);
 
+    /** \brief Constructor.
+     *
+     * Only attempts widths from the widest down to the narrowest at given steps.
+     *
+     * \param pmax Maximum size to fit, rounded down to size step.
+     * \param pwmin Narrowest width to attempt, rounded up to size step.
+     * \param pwmax Widest width to attempt, rounded down to size step, at most maximum size.
+     * \param pstep Step between widths, rounded up to size step.
+     */
+    SkyLineFitter(unsigned pmax, unsigned pwmin, unsigned pwmax, unsigned pstep);
+
     /** \brief Destructor. */
     ~SkyLineFitter() { }
 
@@ -51,6 +70,12 @@ class SkyLineFitter
     void storeAttempt(unsigned pcount, float pusage, unsigned pw, unsigned ph);
 
   public:
+    /** \brief Get the number of attempts queue() will dispatch.
+     *
+     * \return Number of attempts.
+     */
+    unsigned getAttemptCount() const;
+
     /** \brief Queue all attempts.
      *
      * \param glyphs Glyph storage to use.
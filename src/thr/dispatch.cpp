@@ -7,8 +7,62 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread/condition_variable.hpp>
 
+#include <queue>
+
 using namespace thr;
 
+/** \brief Job ordered by cost.
+ */
+class OrderedTask
+{
+  private:
+    /** Functor to execute. */
+    Task m_task;
+
+    /** Estimated cost. */
+    uint64_t m_cost;
+
+    /** Sequence number, keeps jobs of equal cost in the order they were added. */
+    uint64_t m_sequence;
+
+  public:
+    /** \brief Constructor.
+     *
+     * \param ptask Functor to execute.
+     * \param pcost Estimated cost.
+     * \param psequence Sequence number.
+     */
+    OrderedTask(const Task &ptask, uint64_t pcost, uint64_t psequence) :
+      m_task(ptask),
+      m_cost(pcost),
+      m_sequence(psequence) { }
+
+  public:
+    /** \brief Get the functor.
+     *
+     * \return Functor to execute.
+     */
+    const Task& getTask() const
+    {
+      return m_task;
+    }
+
+  public:
+    /** \brief Less than operator.
+     *
+     * \param rhs Right-hand-side operand.
+     * \return True if this job should be executed after the other one.
+     */
+    bool operator<(const OrderedTask &rhs) const
+    {
+      if(m_cost != rhs.m_cost)
+      {
+        return (m_cost < rhs.m_cost);
+      }
+      return (m_sequence > rhs.m_sequence);
+    }
+};
+
 /** Convenience typedef. */
 typedef boost::shared_ptr<ThreadStorage> ThreadStorageSptr;
 
@@ -42,6 +96,12 @@ static ThreadMap threads;
 /** Task list. */
 static data::CircularBuffer<Task> tasks_normal;
 
+/** Task list ordered by cost. */
+static std::priority_queue<OrderedTask> tasks_ordered;
+
+/** Number of ordered tasks ever added. */
+static uint64_t tasks_ordered_added = 0;
+
 /** High-priority task list. */
 static data::CircularBuffer<Promise*> tasks_important;
 
@@ -195,6 +255,25 @@ static bool inner_run_normal(boost::mutex::scoped_lock &pscope)
   return true;
 }
 
+/** \brief Inner task running, ordered tasks.
+ *
+ * \param pscope Previously created scoped lock.
+ * \return True if executed something, false if not.
+ */
+static bool inner_run_ordered(boost::mutex::scoped_lock &pscope)
+{
+  if(tasks_ordered.empty())
+  {
+    return false;
+  }
+  Task functor = tasks_ordered.top().getTask();
+  tasks_ordered.pop();
+  pscope.unlock();
+  functor();
+  pscope.lock();
+  return true;
+}
+
 /** \brief Inner task running, privileged tasks.
  *
  * \param tlist Task list.
@@ -324,6 +403,10 @@ static void run_normal()
     {
       continue;
     }
+    if(inner_run_ordered(scope))
+    {
+      continue;
+    }
     if(inner_run_normal(scope))
     {
       continue;
@@ -347,6 +430,15 @@ void thr::dispatch_ext(const Task &pfunctor)
   inner_dispatch();
 }
 
+void thr::dispatch_ordered_ext(const Task &pfunctor, uint64_t cost)
+{
+  boost::mutex::scoped_lock scope(mut);
+
+  tasks_ordered.push(OrderedTask(pfunctor, cost, tasks_ordered_added++));
+
+  inner_dispatch();
+}
+
 void thr::dispatch_privileged_ext(const Task &pfunctor)
 {
   boost::thread::id tid = boost::this_thread::get_id();
@@ -422,6 +514,11 @@ void thr::thr_main(unsigned nthreads)
         continue;
       }
 
+      if(inner_run_ordered(scope))
+      {
+        continue;
+      }
+
       if(inner_run_normal(scope))
       {
         continue;
@@ -461,6 +558,7 @@ void thr::thr_quit()
 
   // Clear all tasks, they will not be done.
   tasks_normal.clear();
+  tasks_ordered = std::priority_queue<OrderedTask>();
   tasks_important.clear();
   tasks_privileged.clear();
 }
@@ -485,6 +583,11 @@ void thr::wait()
         continue;
       }
 
+      if(inner_run_ordered(scope))
+      {
+        continue;
+      }
+
       if(inner_run_normal(scope))
       {
         continue;
@@ -518,6 +621,11 @@ void thr::wait()
         continue;
       }
 
+      if(inner_run_ordered(scope))
+      {
+        continue;
+      }
+
       if(inner_run_normal(scope))
       {
         continue;
@@ -538,7 +646,7 @@ void thr::wait()
     return;
   }
 
-  if(tasks_normal.empty() && workers_active.empty())
+  if(tasks_normal.empty() && tasks_ordered.empty() && workers_active.empty())
   {
     return;
   }
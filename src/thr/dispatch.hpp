@@ -16,6 +16,16 @@ namespace thr
    */
   extern void dispatch_ext(const Task &pfunctor);
 
+  /** \brief Add a job ordered by cost.
+   *
+   * Anyone may execute this job. Ordered jobs are executed before normal jobs, highest cost first. Jobs of equal
+   * cost are executed in the order they were added.
+   *
+   * \param pfunctor Functor to store.
+   * \param cost Estimated cost of the job.
+   */
+  extern void dispatch_ordered_ext(const Task &pfunctor, uint64_t cost);
+
   /** \brief Add a privileged job.
    *
    * Add a primary, privileged job for execution. Only the privileged main executor may execute this job. A
@@ -144,6 +154,63 @@ namespace thr
   }
   /** \endcond */
 
+  /** \brief Wrapper for dispatch_ordered_ext.
+   *
+   * \param cost Estimated cost of the job.
+   * \param op Any binding.
+   */
+  template <typename Type> inline void dispatch_ordered(uint64_t cost, Type op)
+  {
+    dispatch_ordered_ext(op, cost);
+  }
+  /** \cond */
+  template <typename T0, typename T1>
+  inline void dispatch_ordered(uint64_t cost, T0 op0, T1 op1)
+  {
+    dispatch_ordered_ext(boost::bind(op0, op1), cost);
+  }
+  template <typename T0, typename T1, typename T2>
+  inline void dispatch_ordered(uint64_t cost, T0 op0, T1 op1, T2 op2)
+  {
+    dispatch_ordered_ext(boost::bind(op0, op1, op2), cost);
+  }
+  template <typename T0, typename T1, typename T2, typename T3>
+  inline void dispatch_ordered(uint64_t cost, T0 op0, T1 op1, T2 op2, T3 op3)
+  {
+    dispatch_ordered_ext(boost::bind(op0, op1, op2, op3), cost);
+  }
+  template <typename T0, typename T1, typename T2, typename T3, typename T4>
+  inline void dispatch_ordered(uint64_t cost, T0 op0, T1 op1, T2 op2, T3 op3, T4 op4)
+  {
+    dispatch_ordered_ext(boost::bind(op0, op1, op2, op3, op4), cost);
+  }
+  template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5>
+  inline void dispatch_ordered(uint64_t cost, T0 op0, T1 op1, T2 op2, T3 op3, T4 op4, T5 op5)
+  {
+    dispatch_ordered_ext(boost::bind(op0, op1, op2, op3, op4, op5), cost);
+  }
+  template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6>
+  inline void dispatch_ordered(uint64_t cost, T0 op0, T1 op1, T2 op2, T3 op3, T4 op4, T5 op5, T6 op6)
+  {
+    dispatch_ordered_ext(boost::bind(op0, op1, op2, op3, op4, op5, op6), cost);
+  }
+  template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7>
+  inline void dispatch_ordered(uint64_t cost, T0 op0, T1 op1, T2 op2, T3 op3, T4 op4, T5 op5, T6 op6, T7 op7)
+  {
+    dispatch_ordered_ext(boost::bind(op0, op1, op2, op3, op4, op5, op6, op7), cost);
+  }
+  template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7, typename T8>
+  inline void dispatch_ordered(uint64_t cost, T0 op0, T1 op1, T2 op2, T3 op3, T4 op4, T5 op5, T6 op6, T7 op7, T8 op8)
+  {
+    dispatch_ordered_ext(boost::bind(op0, op1, op2, op3, op4, op5, op6, op7, op8), cost);
+  }
+  template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7, typename T8, typename T9>
+  inline void dispatch_ordered(uint64_t cost, T0 op0, T1 op1, T2 op2, T3 op3, T4 op4, T5 op5, T6 op6, T7 op7, T8 op8, T9 op9)
+  {
+    dispatch_ordered_ext(boost::bind(op0, op1, op2, op3, op4, op5, op6, op7, op8, op9), cost);
+  }
+  /** \endcond */
+
   /** \brief Wrapper for dispatch_privileged_ext.
    *
    * \param op Any binding.
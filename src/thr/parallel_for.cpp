@@ -0,0 +1,118 @@
+#include "thr/parallel_for.hpp"
+
+#include "thr/dispatch.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+using namespace thr;
+
+/** \brief Shared state of one parallel_for() call.
+ *
+ * Helper jobs may start only after all indices have already been processed, so the state is reference counted
+ * and outlives the call.
+ */
+class ParallelFor : public boost::noncopyable
+{
+  private:
+    /** Task to call for each index. */
+    IndexedTask m_task;
+
+    /** Number of indices. */
+    unsigned m_count;
+
+    /** Next index to claim. */
+    boost::atomic<unsigned> m_next;
+
+    /** Number of indices processed. */
+    boost::atomic<unsigned> m_done;
+
+    /** Guard for completion. */
+    boost::mutex m_mutex;
+
+    /** Signaled on completion. */
+    boost::condition_variable m_cond;
+
+  public:
+    /** \brief Constructor.
+     *
+     * \param ptask Task to call for each index.
+     * \param pcount Number of indices.
+     */
+    ParallelFor(const IndexedTask &ptask, unsigned pcount) :
+      m_task(ptask),
+      m_count(pcount),
+      m_next(0),
+      m_done(0) { }
+
+  public:
+    /** \brief Process indices until all have been claimed.
+     */
+    void run()
+    {
+      for(;;)
+      {
+        unsigned idx = m_next.fetch_add(1, boost::memory_order_relaxed);
+
+        if(idx >= m_count)
+        {
+          return;
+        }
+
+        m_task(idx);
+
+        if(m_done.fetch_add(1, boost::memory_order_acq_rel) + 1 >= m_count)
+        {
+          boost::mutex::scoped_lock scope(m_mutex);
+          m_cond.notify_all();
+        }
+      }
+    }
+
+    /** \brief Wait until all indices have been processed.
+     */
+    void wait()
+    {
+      boost::mutex::scoped_lock scope(m_mutex);
+
+      while(m_done.load(boost::memory_order_acquire) < m_count)
+      {
+        m_cond.wait(scope);
+      }
+    }
+};
+
+/** Convenience typedef. */
+typedef boost::shared_ptr<ParallelFor> ParallelForSptr;
+
+/** \brief Helper job.
+ *
+ * \param op Shared state.
+ */
+static void parallel_for_helper(ParallelForSptr op)
+{
+  op->run();
+}
+
+void thr::parallel_for(unsigned count, const IndexedTask &pfunctor)
+{
+  if(1 >= count)
+  {
+    for(unsigned ii = 0; (ii < count); ++ii)
+    {
+      pfunctor(ii);
+    }
+    return;
+  }
+
+  ParallelForSptr state(new ParallelFor(pfunctor, count));
+  unsigned helpers = std::min(count, hardware_concurrency()) - 1;
+
+  for(unsigned ii = 0; (ii < helpers); ++ii)
+  {
+    dispatch(parallel_for_helper, state);
+  }
+
+  state->run();
+  state->wait();
+}
@@ -0,0 +1,25 @@
+#ifndef THR_PARALLEL_FOR_HPP
+#define THR_PARALLEL_FOR_HPP
+
+#include "thr/generic.hpp"
+
+namespace thr
+{
+  /** Convenience typedef. */
+  typedef boost::function<void(unsigned)> IndexedTask;
+
+  /** \brief Run a task for every index in a range, spreading the work over the worker threads.
+   *
+   * Helper jobs are dispatched and the calling thread works on the range itself, indices are claimed one at a
+   * time by whoever is free. Returns once every index has been processed.
+   *
+   * May be called from within a job. Since the caller keeps working until all indices have been claimed, it
+   * never waits on jobs that have not started.
+   *
+   * \param count Number of indices, task is called for [0, count[.
+   * \param pfunctor Task to call for each index.
+   */
+  extern void parallel_for(unsigned count, const IndexedTask &pfunctor);
+}
+
+#endif